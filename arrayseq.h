@@ -65,7 +65,7 @@ public:
   virtual bool contains(const T& elem) const;
 
   // Sorts the elements in the sequence using less than equal (<=)
-  // operator. (Not implemented in HW-3)
+  // operator. Uses merge sort, so equal elements keep their order.
   virtual void sort(); 
   
 private:
@@ -81,6 +81,9 @@ private:
 
   // helper to double the capacity of the array
   void resize();
+
+  // merge sort helper, sorts array[start..end] using tmp as scratch
+  void merge_sort(T* tmp, int start, int end);
   
   // helper to delete the array list (called by destructor and copy
   // constructor)
@@ -116,7 +119,11 @@ ArraySeq<T>::ArraySeq()
 template<typename T>
 void ArraySeq<T>::sort()
 {
-  // TODO: saved for future assignment
+  if (count < 2)
+    return;
+  T* tmp = new T[count];
+  merge_sort(tmp, 0, count - 1);
+  delete[] tmp;
 }
 
 
@@ -172,10 +179,17 @@ ArraySeq<T>& ArraySeq<T>::operator=(const ArraySeq& rhs)
 template<typename T>
 ArraySeq<T>& ArraySeq<T>::operator=(ArraySeq&& rhs)
 {
+  if (this == &rhs)
+    return *this;
+
+  delete[] array;
   array = rhs.array;
   count = rhs.count;
   capacity = rhs.capacity;
   rhs.array = nullptr;
+  rhs.count = 0;
+  rhs.capacity = 0;
+  return *this;
 }
   
 // Destructor
@@ -312,6 +326,40 @@ void ArraySeq<T>::resize()
   array = array2;
   array2 = nullptr;
 }
+
+// merge sort helper, sorts array[start..end] using tmp as scratch
+template<typename T>
+void ArraySeq<T>::merge_sort(T* tmp, int start, int end)
+{
+  if (start >= end)
+    return;
+
+  int mid = (start + end) / 2;
+  merge_sort(tmp, start, mid);
+  merge_sort(tmp, mid + 1, end);
+
+  // already in order, nothing to merge
+  if (array[mid] <= array[mid + 1])
+    return;
+
+  int i = start;
+  int j = mid + 1;
+  int k = start;
+  while (i <= mid and j <= end)
+  {
+    if (array[i] <= array[j])
+      tmp[k++] = array[i++];
+    else
+      tmp[k++] = array[j++];
+  }
+  while (i <= mid)
+    tmp[k++] = array[i++];
+  while (j <= end)
+    tmp[k++] = array[j++];
+
+  for (k = start; k <= end; ++k)
+    array[k] = tmp[k];
+}
   
 // helper to delete the array list (called by destructor and copy
 // constructor)
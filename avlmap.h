@@ -7,18 +7,38 @@
 #ifndef AVLMAP_H
 #define AVLMAP_H
 
+#include <cstddef>
+#include <iterator>
+#include <thread>
+#include <type_traits>
+#include <utility>
 #include "map.h"
 #include "arrayseq.h"
+#include "nodepool.h"
+#include "keyrange.h"
 
 
 template<typename K, typename V>
 class AVLMap : public Map<K,V>
 {
+  // tree node (defined below)
+  struct Node;
+
+  // longest root-to-leaf path an AVL tree of at most INT_MAX nodes
+  // can have (1.44 log2 n), with room to spare
+  static const int MAX_DEPTH = 64;
+
 public:
 
   // default constructor
   AVLMap();
 
+  // builds a perfectly balanced tree from pairs sorted by strictly
+  // increasing key (such as BinSearchMap::pairs()) in linear time.
+  // With threads > 1 the two subtrees of large ranges are built in
+  // parallel. Throws invalid_argument if pairs is not sorted.
+  AVLMap(const ArraySeq<std::pair<K,V>>& pairs, int threads = 1);
+
   // copy constructor
   AVLMap(const AVLMap& rhs);
 
@@ -62,17 +82,126 @@ public:
   // Returns true if the key is in the collection, and false otherwise.
   bool contains(const K& key) const;
 
+  // Returns a pointer to the value for the given key, or nullptr if
+  // the key is not in the collection.
+  V* find(const K& key);
+  const V* find(const K& key) const;
+
+  // Sets the value for the given key, adding the key-value pair if
+  // the key is not in the collection. Returns true if the pair was
+  // added and false if an existing value was replaced.
+  bool insert_or_assign(const K& key, const V& value);
+
+  // Adds the key-value pair if the key is not in the collection and
+  // otherwise leaves the existing value alone. Returns true if the
+  // pair was added.
+  bool try_emplace(const K& key, const V& value);
+
   // Returns the keys k in the collection such that k1 <= k <= k2
   ArraySeq<K> find_keys(const K& k1, const K& k2) const;
 
   // Returns the keys in the collection in ascending sorted order
   ArraySeq<K> sorted_keys() const;  
 
+  // Returns the number of keys in the collection less than key
+  int rank(const K& key) const;
+
+  // Returns the key at the given position in sorted order (0 is the
+  // smallest key). Throws out_of_range if the index is invalid.
+  const K& select(int index) const;
+
+  // Returns the number of keys k in the collection such that
+  // k1 <= k <= k2, without collecting them
+  int count_range(const K& k1, const K& k2) const;
+
   // Returns the height of the binary search tree
   int height() const;
 
+  // Replaces the contents of the map with every pair of left, the
+  // given pair, and every pair of right, in O(|height(left) -
+  // height(right)|) time. Every key of left must be less than key and
+  // every key of right greater, otherwise invalid_argument is thrown.
+  // left and right are left empty (either may be this map).
+  void join(AVLMap&& left, const K& key, const V& value, AVLMap&& right);
+
+  // Set operations that take over the nodes of rhs (leaving it empty)
+  // and split and join the two trees in O(m log(n/m + 1)) time, where
+  // m <= n are the two sizes. With threads > 1 the independent halves
+  // of large subproblems run in parallel.
+  //   union_with:      adds the pairs of rhs whose keys are not in the
+  //                    map (existing values are kept)
+  //   intersect_with:  keeps only the pairs whose keys are in rhs
+  //   difference_with: removes the pairs whose keys are in rhs
+  void union_with(AVLMap&& rhs, int threads = 1);
+  void intersect_with(AVLMap&& rhs, int threads = 1);
+  void difference_with(AVLMap&& rhs, int threads = 1);
+
   // helper to print the tree for debugging
   void print() const;
+
+  // helper for testing, returns true if the keys are in order, every
+  // node is balanced, and every height and size field matches its
+  // subtree
+  bool is_valid() const;
+
+  // Forward iterator over the keys in ascending order. Dereferencing
+  // gives the key and value() gives its value. The iterator keeps the
+  // nodes still to be visited on the current root-to-node path in a
+  // fixed-size stack, so stepping is amortized O(1) and no memory is
+  // allocated. Insert and erase invalidate every iterator.
+  class const_iterator
+  {
+  public:
+    typedef std::forward_iterator_tag iterator_category;
+    typedef K value_type;
+    typedef std::ptrdiff_t difference_type;
+    typedef const K* pointer;
+    typedef const K& reference;
+
+    // an iterator that refers to no map (equal to end())
+    const_iterator();
+
+    // copies only the live part of the stack
+    const_iterator(const const_iterator& rhs);
+    const_iterator& operator=(const const_iterator& rhs);
+
+    const K& operator*() const;
+    const K* operator->() const;
+
+    // the value for the current key
+    const V& value() const;
+
+    // move to the next key
+    const_iterator& operator++();
+    const_iterator operator++(int);
+
+    bool operator==(const const_iterator& rhs) const;
+    bool operator!=(const const_iterator& rhs) const;
+
+  private:
+    friend class AVLMap;
+
+    // push st_root and its chain of left children
+    void push_left(const Node* st_root);
+
+    // ancestors of the current node whose keys come after it, with
+    // the current node on top (empty at the end)
+    const Node* stack[MAX_DEPTH];
+    int depth = 0;
+  };
+
+  // iterators to the smallest key and one past the largest key
+  const_iterator begin() const;
+  const_iterator end() const;
+
+  // Returns an iterator to the first key not less than (lower_bound)
+  // or greater than (upper_bound) the given key, or end()
+  const_iterator lower_bound(const K& key) const;
+  const_iterator upper_bound(const K& key) const;
+
+  // Returns a view of the keys k such that k1 <= k <= k2, the same
+  // keys as find_keys but read in place as they are iterated
+  KeyRange<const_iterator> range(const K& k1, const K& k2) const;
   
 private:
 
@@ -83,6 +212,7 @@ private:
     Node* left;
     Node* right;
     int height;
+    int size;
   };
 
   // number of nodes
@@ -91,17 +221,89 @@ private:
   // root node
   Node* root = nullptr;
 
-  // clean up the tree and reset count to zero given subtree root
-  void make_empty(Node* st_root);
+  // slab storage for the tree nodes
+  NodePool<Node> pool;
 
-  // copy assignment helper
-  Node* copy(const Node* rhs_st_root) const;
-  
-  // erase helper
-  Node* erase(const K& key, Node* st_root);
+  // clean up the tree and reset count to zero
+  void make_empty();
 
-  // insert helper
-  Node* insert(const K& key, const V& value, Node* st_root);
+  // run the destructors of a subtree's nodes (the pool releases
+  // their memory all at once)
+  void destroy(Node* st_root);
+
+  // copy assignment helper
+  Node* copy(const Node* rhs_st_root);
+
+  // subproblems smaller than this many nodes are not split across
+  // threads by the bulk-load constructor and the set operations
+  static const int MIN_PARALLEL_SIZE = 4096;
+
+  // bulk-load helper, links nodes[start..end] (already allocated, in
+  // key order) into a balanced subtree holding pairs[start..end] and
+  // returns its root
+  Node* build(const ArraySeq<std::pair<K,V>>& pairs, Node** nodes,
+              int start, int end, int threads);
+
+  // set operations carried out by combine
+  enum SetOp { UNION, INTERSECTION, DIFFERENCE };
+
+  // join and split helpers. Each takes the subtrees passed in apart
+  // and returns the root of the balanced result.
+  //   join:       mid (a detached node) between left and right, whose
+  //               keys are all less and all greater than mid's
+  //   join_right: join when left is the taller tree
+  //   join_left:  join when right is the taller tree
+  //   join2:      left and right with no node between them
+  //   split:      the keys less than key into left, greater than key
+  //               into right, and the node holding key (or nullptr)
+  //               detached into found
+  //   split_last: the subtree without its largest node, moved to last
+  Node* join(Node* left, Node* mid, Node* right);
+  Node* join_right(Node* left, Node* mid, Node* right);
+  Node* join_left(Node* left, Node* mid, Node* right);
+  Node* join2(Node* left, Node* right);
+  void split(Node* st_root, const K& key, Node*& left, Node*& found, Node*& right);
+  Node* split_last(Node* st_root, Node*& last);
+
+  // set operation helper, applies op to the subtrees t1 (this map's)
+  // and t2 (rhs's). Dropped nodes are pushed onto garbage (linked
+  // through left) rather than freed so that parallel branches never
+  // touch the pool.
+  Node* combine(Node* t1, Node* t2, SetOp op, int threads, Node*& garbage);
+
+  // push every node of a subtree onto garbage
+  static void discard(Node* st_root, Node*& garbage);
+
+  // union_with, intersect_with, and difference_with helper
+  void set_operation(AVLMap&& rhs, SetOp op, int threads);
+
+  // insert_or_assign and try_emplace helper, searches for the key
+  // once and either adds the pair or (if assign) replaces the
+  // value. Returns true if the pair was added.
+  bool insert_unique(const K& key, const V& value, bool assign);
+
+  // walk back up a search path (links to the nodes from the root
+  // down, depth of them), fixing heights and rotating where needed.
+  // Above the first node whose height did not change no rotation or
+  // height change is possible, so only subtree sizes are fixed.
+  void rebalance_path(Node** path[], int depth);
+
+  // height of a subtree (0 if empty)
+  static int height(const Node* st_root);
+
+  // number of nodes in a subtree (0 if empty)
+  static int subtree_size(const Node* st_root);
+
+  // lower_bound and upper_bound helper, positions the iterator on the
+  // first key not less than key (or greater than key if upper)
+  const_iterator bound(const K& key, bool upper) const;
+
+  // number of keys in the collection less than key (or less than or
+  // equal to key if inclusive)
+  int count_less(const K& key, bool inclusive) const;
+
+  // recompute a node's height and subtree size from its children
+  static void update(Node* st_root);
   
   // find_keys helper
   void find_keys(const K& k1, const K& k2, const Node* st_root,
@@ -114,11 +316,17 @@ private:
   Node* right_rotate(Node* k2);
   Node* left_rotate(Node* k2);
   
-  // rebalance
+  // rebalance a node whose children are balanced and differ in
+  // height by at most two, returns the new subtree root
   Node* rebalance(Node* st_root);
 
   // print helper
   void print(std::string indent, const Node* st_root) const;
+
+  // is_valid helper, returns the number of nodes in the subtree or
+  // -1 if it breaks an invariant. Keys must lie strictly between lo
+  // and hi (when not null).
+  int check(const Node* st_root, const K* lo, const K* hi) const;
   
 };
 
@@ -147,6 +355,36 @@ void AVLMap<K,V>::print(std::string indent, const Node* st_root) const
 }
 
 
+template<typename K, typename V>
+bool AVLMap<K,V>::is_valid() const
+{
+  return check(root, nullptr, nullptr) == count;
+}
+
+
+template<typename K, typename V>
+int AVLMap<K,V>::check(const Node* st_root, const K* lo, const K* hi) const
+{
+  if (!st_root)
+    return 0;
+  if ((lo and !(*lo < st_root->key)) or (hi and !(st_root->key < *hi)))
+    return -1;
+  int left = check(st_root->left, lo, &st_root->key);
+  int right = check(st_root->right, &st_root->key, hi);
+  if (left == -1 or right == -1)
+    return -1;
+  int lH = height(st_root->left);
+  int rH = height(st_root->right);
+  if (lH - rH > 1 or rH - lH > 1)
+    return -1;
+  if (st_root->height != (lH > rH ? lH : rH) + 1)
+    return -1;
+  if (st_root->size != left + right + 1)
+    return -1;
+  return st_root->size;
+}
+
+
 //----------------------------------------------------------------------
 // TODO: Implement the above functions below
 //----------------------------------------------------------------------
@@ -158,6 +396,27 @@ AVLMap<K,V>::AVLMap()
   //dont think I need anything here
 }
 
+// builds a perfectly balanced tree from sorted pairs
+template<typename K, typename V>
+AVLMap<K,V>::AVLMap(const ArraySeq<std::pair<K,V>>& pairs, int threads)
+{
+  int n = pairs.size();
+  for (int i = 1; i < n; ++i)
+  {
+    if (!(pairs[i - 1].first < pairs[i].first))
+      throw std::invalid_argument("AVLMap<K,V>::AVLMap(const ArraySeq<std::pair<K,V>>& pairs, int threads). Pairs are not sorted.");
+  }
+
+  // the pool is not thread safe, so the nodes are allocated up front
+  // (in key order, so an inorder walk moves forward through memory)
+  Node** nodes = new Node*[n];
+  for (int i = 0; i < n; ++i)
+    nodes[i] = pool.alloc();
+  root = build(pairs, nodes, 0, n - 1, threads);
+  count = n;
+  delete[] nodes;
+}
+
 // copy constructor
 template<typename K, typename V>
 AVLMap<K,V>::AVLMap(const AVLMap& rhs)
@@ -172,6 +431,7 @@ AVLMap<K,V>::AVLMap(AVLMap&& rhs)
 {
   count = rhs.count;
   root = rhs.root;
+  pool = std::move(rhs.pool);
   rhs.root = nullptr;
   rhs.count = 0;
 }
@@ -182,7 +442,7 @@ AVLMap<K,V>& AVLMap<K,V>::operator=(const AVLMap& rhs)
 {
   if (this != &rhs)
   {
-    make_empty(root);
+    make_empty();
     root = copy(rhs.root);
     count = rhs.count;
   }
@@ -195,9 +455,10 @@ AVLMap<K,V>& AVLMap<K,V>::operator=(AVLMap&& rhs)
 {
   if (this != &rhs)
   {
-    make_empty(root);
+    make_empty();
     root = rhs.root;
     count = rhs.count;
+    pool = std::move(rhs.pool);
     rhs.root = nullptr;
     rhs.count = 0;
   }
@@ -208,7 +469,7 @@ AVLMap<K,V>& AVLMap<K,V>::operator=(AVLMap&& rhs)
 template<typename K, typename V>
 AVLMap<K,V>::~AVLMap()
 {
-  make_empty(root);
+  make_empty();
   count = 0;
 }
   
@@ -272,8 +533,30 @@ const V& AVLMap<K,V>::operator[](const K& key) const
 template<typename K, typename V>
 void AVLMap<K,V>::insert(const K& key, const V& value)
 {
-  root = insert(key, value, root);
-  return;
+  // walk down, remembering the link to every node on the way
+  Node** path[MAX_DEPTH];
+  int depth = 0;
+  Node** link = &root;
+  while (*link != nullptr)
+  {
+    path[depth++] = link;
+    if (key > (*link)->key)
+      link = &(*link)->right;
+    else
+      link = &(*link)->left;
+  }
+
+  Node* ptr = pool.alloc();
+  ptr->key = key;
+  ptr->value = value;
+  ptr->left = nullptr;
+  ptr->right = nullptr;
+  ptr->height = 1;
+  ptr->size = 1;
+  *link = ptr;
+  count++;
+
+  rebalance_path(path, depth);
 }
 
 // Shrinks the collection by removing the key-value pair with the
@@ -283,8 +566,49 @@ void AVLMap<K,V>::insert(const K& key, const V& value)
 template<typename K, typename V>
 void AVLMap<K,V>::erase(const K& key)
 {
-  root = erase(key, root);
-  return;
+  // walk down to the node, remembering the link to every node on the
+  // way
+  Node** path[MAX_DEPTH];
+  int depth = 0;
+  Node** link = &root;
+  while (*link != nullptr and !((*link)->key == key))
+  {
+    path[depth++] = link;
+    if (key > (*link)->key)
+      link = &(*link)->right;
+    else
+      link = &(*link)->left;
+  }
+  if (*link == nullptr)
+    throw std::out_of_range("void AVLMap<K,V>::erase(const K& key). Key does not exist.");
+
+  Node* del = *link;
+  if (del->left == nullptr)
+    *link = del->right;
+  else if (del->right == nullptr)
+    *link = del->left;
+  else
+  {
+    // two children: keep walking down to the inorder successor, move
+    // its pair into this node, and unlink the successor instead (one
+    // descent, the path covers both nodes)
+    path[depth++] = link;
+    Node** succ_link = &del->right;
+    while ((*succ_link)->left != nullptr)
+    {
+      path[depth++] = succ_link;
+      succ_link = &(*succ_link)->left;
+    }
+    Node* succ = *succ_link;
+    del->key = succ->key;
+    del->value = succ->value;
+    *succ_link = succ->right;
+    del = succ;
+  }
+  pool.free(del);
+  count--;
+
+  rebalance_path(path, depth);
 }
 
 // Returns true if the key is in the collection, and false otherwise.
@@ -305,6 +629,62 @@ bool AVLMap<K,V>::contains(const K& key) const
   return false;
 }
 
+// Returns a pointer to the value for the given key, or nullptr if
+// the key is not in the collection.
+template<typename K, typename V>
+V* AVLMap<K,V>::find(const K& key)
+{
+  Node* ptr = root;
+
+  while (ptr != nullptr)
+  {
+    if (ptr->key == key)
+      return &ptr->value;
+    else if (ptr->key < key)
+      ptr = ptr->right;
+    else
+      ptr = ptr->left;
+  }
+  return nullptr;
+}
+
+// Returns a pointer to the value for the given key, or nullptr if
+// the key is not in the collection.
+template<typename K, typename V>
+const V* AVLMap<K,V>::find(const K& key) const
+{
+  Node* ptr = root;
+
+  while (ptr != nullptr)
+  {
+    if (ptr->key == key)
+      return &ptr->value;
+    else if (ptr->key < key)
+      ptr = ptr->right;
+    else
+      ptr = ptr->left;
+  }
+  return nullptr;
+}
+
+// Sets the value for the given key, adding the key-value pair if
+// the key is not in the collection. Returns true if the pair was
+// added and false if an existing value was replaced.
+template<typename K, typename V>
+bool AVLMap<K,V>::insert_or_assign(const K& key, const V& value)
+{
+  return insert_unique(key, value, true);
+}
+
+// Adds the key-value pair if the key is not in the collection and
+// otherwise leaves the existing value alone. Returns true if the
+// pair was added.
+template<typename K, typename V>
+bool AVLMap<K,V>::try_emplace(const K& key, const V& value)
+{
+  return insert_unique(key, value, false);
+}
+
 // Returns the keys k in the collection such that k1 <= k <= k2
 template<typename K, typename V>
 ArraySeq<K> AVLMap<K,V>::find_keys(const K& k1, const K& k2) const
@@ -324,6 +704,230 @@ ArraySeq<K> AVLMap<K,V>::sorted_keys() const
   return tmp;
 }
 
+// Returns the number of keys in the collection less than key
+template<typename K, typename V>
+int AVLMap<K,V>::rank(const K& key) const
+{
+  return count_less(key, false);
+}
+
+// Returns the key at the given position in sorted order. Throws
+// out_of_range if the index is invalid.
+template<typename K, typename V>
+const K& AVLMap<K,V>::select(int index) const
+{
+  if (index < 0 or index >= count)
+    throw std::out_of_range("const K& AVLMap<K,V>::select(int index) const. Invalid index.");
+
+  Node* ptr = root;
+  while (true)
+  {
+    int left_size = subtree_size(ptr->left);
+    if (index < left_size)
+      ptr = ptr->left;
+    else if (index == left_size)
+      return ptr->key;
+    else
+    {
+      index -= left_size + 1;
+      ptr = ptr->right;
+    }
+  }
+}
+
+// Returns the number of keys k in the collection such that
+// k1 <= k <= k2
+template<typename K, typename V>
+int AVLMap<K,V>::count_range(const K& k1, const K& k2) const
+{
+  if (k2 < k1)
+    return 0;
+  return count_less(k2, true) - count_less(k1, false);
+}
+
+// iterator to the smallest key
+template<typename K, typename V>
+typename AVLMap<K,V>::const_iterator AVLMap<K,V>::begin() const
+{
+  const_iterator it;
+  it.push_left(root);
+  return it;
+}
+
+// iterator to one past the largest key
+template<typename K, typename V>
+typename AVLMap<K,V>::const_iterator AVLMap<K,V>::end() const
+{
+  return const_iterator();
+}
+
+// Returns an iterator to the first key not less than the given key
+template<typename K, typename V>
+typename AVLMap<K,V>::const_iterator AVLMap<K,V>::lower_bound(const K& key) const
+{
+  return bound(key, false);
+}
+
+// Returns an iterator to the first key greater than the given key
+template<typename K, typename V>
+typename AVLMap<K,V>::const_iterator AVLMap<K,V>::upper_bound(const K& key) const
+{
+  return bound(key, true);
+}
+
+// Returns a view of the keys k such that k1 <= k <= k2
+template<typename K, typename V>
+KeyRange<typename AVLMap<K,V>::const_iterator> AVLMap<K,V>::range(const K& k1, const K& k2) const
+{
+  const_iterator first = lower_bound(k1);
+  if (k2 < k1)
+    return KeyRange<const_iterator>(first, first);
+  return KeyRange<const_iterator>(first, upper_bound(k2));
+}
+
+template<typename K, typename V>
+AVLMap<K,V>::const_iterator::const_iterator()
+{
+}
+
+template<typename K, typename V>
+AVLMap<K,V>::const_iterator::const_iterator(const const_iterator& rhs)
+{
+  *this = rhs;
+}
+
+template<typename K, typename V>
+typename AVLMap<K,V>::const_iterator& AVLMap<K,V>::const_iterator::operator=(const const_iterator& rhs)
+{
+  depth = rhs.depth;
+  for (int i = 0; i < depth; ++i)
+    stack[i] = rhs.stack[i];
+  return *this;
+}
+
+template<typename K, typename V>
+const K& AVLMap<K,V>::const_iterator::operator*() const
+{
+  return stack[depth - 1]->key;
+}
+
+template<typename K, typename V>
+const K* AVLMap<K,V>::const_iterator::operator->() const
+{
+  return &stack[depth - 1]->key;
+}
+
+// the value for the current key
+template<typename K, typename V>
+const V& AVLMap<K,V>::const_iterator::value() const
+{
+  return stack[depth - 1]->value;
+}
+
+// move to the next key
+template<typename K, typename V>
+typename AVLMap<K,V>::const_iterator& AVLMap<K,V>::const_iterator::operator++()
+{
+  // the successor is the smallest key of the right subtree, or if
+  // there is none the nearest ancestor already on the stack
+  const Node* ptr = stack[--depth];
+  push_left(ptr->right);
+  return *this;
+}
+
+template<typename K, typename V>
+typename AVLMap<K,V>::const_iterator AVLMap<K,V>::const_iterator::operator++(int)
+{
+  const_iterator tmp = *this;
+  ++(*this);
+  return tmp;
+}
+
+template<typename K, typename V>
+bool AVLMap<K,V>::const_iterator::operator==(const const_iterator& rhs) const
+{
+  if (depth == 0 or rhs.depth == 0)
+    return depth == rhs.depth;
+  return stack[depth - 1] == rhs.stack[rhs.depth - 1];
+}
+
+template<typename K, typename V>
+bool AVLMap<K,V>::const_iterator::operator!=(const const_iterator& rhs) const
+{
+  return !(*this == rhs);
+}
+
+// push st_root and its chain of left children
+template<typename K, typename V>
+void AVLMap<K,V>::const_iterator::push_left(const Node* st_root)
+{
+  while (st_root != nullptr)
+  {
+    stack[depth++] = st_root;
+    st_root = st_root->left;
+  }
+}
+
+// Replaces the contents of the map with every pair of left, the
+// given pair, and every pair of right. Throws invalid_argument if the
+// keys are not in order.
+template<typename K, typename V>
+void AVLMap<K,V>::join(AVLMap&& left, const K& key, const V& value, AVLMap&& right)
+{
+  // largest key of left and smallest key of right
+  const Node* ptr = left.root;
+  while (ptr != nullptr and ptr->right != nullptr)
+    ptr = ptr->right;
+  if (ptr != nullptr and !(ptr->key < key))
+    throw std::invalid_argument("void AVLMap<K,V>::join(AVLMap&& left, const K& key, const V& value, AVLMap&& right). Keys of left are not less than key.");
+  ptr = right.root;
+  while (ptr != nullptr and ptr->left != nullptr)
+    ptr = ptr->left;
+  if (ptr != nullptr and !(key < ptr->key))
+    throw std::invalid_argument("void AVLMap<K,V>::join(AVLMap&& left, const K& key, const V& value, AVLMap&& right). Keys of right are not greater than key.");
+
+  Node* left_root = left.root;
+  Node* right_root = right.root;
+  left.root = nullptr;
+  left.count = 0;
+  right.root = nullptr;
+  right.count = 0;
+
+  // the old contents go unless they are one of the two sides, then
+  // the nodes of both sides move into this map's pool
+  if (&left != this and &right != this)
+    make_empty();
+  pool.splice(left.pool);
+  pool.splice(right.pool);
+
+  Node* mid = pool.alloc();
+  mid->key = key;
+  mid->value = value;
+  root = join(left_root, mid, right_root);
+  count = subtree_size(root);
+}
+
+// Adds the pairs of rhs whose keys are not in the map
+template<typename K, typename V>
+void AVLMap<K,V>::union_with(AVLMap&& rhs, int threads)
+{
+  set_operation(std::move(rhs), UNION, threads);
+}
+
+// Keeps only the pairs whose keys are in rhs
+template<typename K, typename V>
+void AVLMap<K,V>::intersect_with(AVLMap&& rhs, int threads)
+{
+  set_operation(std::move(rhs), INTERSECTION, threads);
+}
+
+// Removes the pairs whose keys are in rhs
+template<typename K, typename V>
+void AVLMap<K,V>::difference_with(AVLMap&& rhs, int threads)
+{
+  set_operation(std::move(rhs), DIFFERENCE, threads);
+}
+
 // Returns the height of the binary search tree
 template<typename K, typename V>
 int AVLMap<K,V>::height() const
@@ -333,33 +937,43 @@ int AVLMap<K,V>::height() const
   return 0;
 }
 
-// clean up the tree and reset count to zero given subtree root
+// clean up the tree and reset count to zero
 template<typename K, typename V>
-void AVLMap<K,V>::make_empty(Node* st_root)
+void AVLMap<K,V>::make_empty()
+{
+  // the pool releases node memory a slab at a time, so the tree only
+  // needs walking when the nodes have destructors to run
+  if (!std::is_trivially_destructible<Node>::value)
+    destroy(root);
+  pool.clear();
+  root = nullptr;
+  count = 0;
+}
+
+// run the destructors of a subtree's nodes
+template<typename K, typename V>
+void AVLMap<K,V>::destroy(Node* st_root)
 {
   if (st_root != nullptr)
   {
-    make_empty(st_root->left);
-    make_empty(st_root->right);
-
-    st_root->left = nullptr;
-    st_root->right = nullptr;
-    delete st_root;
-    st_root = nullptr;
+    destroy(st_root->left);
+    destroy(st_root->right);
+    st_root->~Node();
   }
-  return;
 }
 
 // copy assignment helper
 template<typename K, typename V>
-typename AVLMap<K,V>::Node* AVLMap<K,V>::copy(const Node* rhs_st_root) const
+typename AVLMap<K,V>::Node* AVLMap<K,V>::copy(const Node* rhs_st_root)
 {
   Node* cpy = nullptr;
   if (rhs_st_root != nullptr)
   {
-    cpy = new Node;
+    cpy = pool.alloc();
     cpy->key = rhs_st_root->key;
     cpy->value = rhs_st_root->value;
+    cpy->height = rhs_st_root->height;
+    cpy->size = rhs_st_root->size;
 
     cpy->left = copy(rhs_st_root->left);
     cpy->right = copy(rhs_st_root->right);
@@ -367,152 +981,409 @@ typename AVLMap<K,V>::Node* AVLMap<K,V>::copy(const Node* rhs_st_root) const
   return cpy;
 }
   
-// erase helper
+// bulk-load helper
+template<typename K, typename V>
+typename AVLMap<K,V>::Node* AVLMap<K,V>::build(const ArraySeq<std::pair<K,V>>& pairs, Node** nodes, int start, int end, int threads)
+{
+  if (start > end)
+    return nullptr;
+
+  // the middle pair is the root, so the two halves differ in size by
+  // at most one and the tree is balanced without any rotations
+  int mid = start + (end - start) / 2;
+  Node* st_root = nodes[mid];
+  st_root->key = pairs[mid].first;
+  st_root->value = pairs[mid].second;
+
+  if (threads > 1 and end - start >= MIN_PARALLEL_SIZE)
+  {
+    // the halves touch disjoint nodes, so they can be built at once
+    std::thread left_builder([&]() {
+      st_root->left = build(pairs, nodes, start, mid - 1, threads / 2);
+    });
+    st_root->right = build(pairs, nodes, mid + 1, end, threads - threads / 2);
+    left_builder.join();
+  }
+  else
+  {
+    st_root->left = build(pairs, nodes, start, mid - 1, 1);
+    st_root->right = build(pairs, nodes, mid + 1, end, 1);
+  }
+  update(st_root);
+  return st_root;
+}
+
+// join mid between left and right
 template<typename K, typename V>
-typename AVLMap<K,V>::Node* AVLMap<K,V>::erase(const K& key, Node* st_root)
+typename AVLMap<K,V>::Node* AVLMap<K,V>::join(Node* left, Node* mid, Node* right)
+{
+  if (height(left) > height(right) + 1)
+    return join_right(left, mid, right);
+  if (height(right) > height(left) + 1)
+    return join_left(left, mid, right);
+  mid->left = left;
+  mid->right = right;
+  update(mid);
+  return mid;
+}
+
+// join when left is the taller tree: walk down its right spine to the
+// first subtree no more than one taller than right, hang mid there,
+// and rebalance on the way back up
+template<typename K, typename V>
+typename AVLMap<K,V>::Node* AVLMap<K,V>::join_right(Node* left, Node* mid, Node* right)
+{
+  if (height(left->right) <= height(right) + 1)
+  {
+    mid->left = left->right;
+    mid->right = right;
+    update(mid);
+    left->right = mid;
+  }
+  else
+    left->right = join_right(left->right, mid, right);
+  update(left);
+  return rebalance(left);
+}
+
+// join when right is the taller tree (mirror of join_right)
+template<typename K, typename V>
+typename AVLMap<K,V>::Node* AVLMap<K,V>::join_left(Node* left, Node* mid, Node* right)
+{
+  if (height(right->left) <= height(left) + 1)
+  {
+    mid->left = left;
+    mid->right = right->left;
+    update(mid);
+    right->left = mid;
+  }
+  else
+    right->left = join_left(left, mid, right->left);
+  update(right);
+  return rebalance(right);
+}
+
+// join left and right with no node between them
+template<typename K, typename V>
+typename AVLMap<K,V>::Node* AVLMap<K,V>::join2(Node* left, Node* right)
+{
+  if (left == nullptr)
+    return right;
+  Node* last = nullptr;
+  Node* rest = split_last(left, last);
+  return join(rest, last, right);
+}
+
+// split a subtree around key
+template<typename K, typename V>
+void AVLMap<K,V>::split(Node* st_root, const K& key, Node*& left, Node*& found, Node*& right)
 {
-  //std::cout << "******************** subtree root: " << st_root->key << ", " << key << "\n";
-  //print();
   if (st_root == nullptr)
-    throw std::out_of_range("typename AVLMap<K,V>::Node* erase(const K& key, Node* st_root). Key does not exist.");
+  {
+    left = nullptr;
+    found = nullptr;
+    right = nullptr;
+  }
   else if (key < st_root->key)
-    st_root->left = erase(key , st_root->left);
-  else if (key > st_root->key)
-    st_root->right = erase(key , st_root->right);
-  else if (key == st_root->key) {
-    // case 1: left subtree is empty
-    if (st_root->left == nullptr)
-    {
-      //std::cout << "case 1 deleting: " << st_root->key << "\n";
-      Node* tmp = st_root;
-      st_root = st_root->right;
-      count--;
-      delete tmp;
-      tmp = nullptr;
-    }
-    // case 2: right subtree is empty
-    else if (st_root->right == nullptr)
+  {
+    split(st_root->left, key, left, found, right);
+    right = join(right, st_root, st_root->right);
+  }
+  else if (st_root->key < key)
+  {
+    split(st_root->right, key, left, found, right);
+    left = join(st_root->left, st_root, left);
+  }
+  else
+  {
+    left = st_root->left;
+    right = st_root->right;
+    found = st_root;
+    found->left = nullptr;
+    found->right = nullptr;
+    update(found);
+  }
+}
+
+// remove the largest node of a subtree
+template<typename K, typename V>
+typename AVLMap<K,V>::Node* AVLMap<K,V>::split_last(Node* st_root, Node*& last)
+{
+  if (st_root->right == nullptr)
+  {
+    last = st_root;
+    Node* rest = st_root->left;
+    last->left = nullptr;
+    update(last);
+    return rest;
+  }
+  Node* rest = split_last(st_root->right, last);
+  return join(st_root->left, st_root, rest);
+}
+
+// set operation helper
+template<typename K, typename V>
+typename AVLMap<K,V>::Node* AVLMap<K,V>::combine(Node* t1, Node* t2, SetOp op, int threads, Node*& garbage)
+{
+  if (t1 == nullptr)
+  {
+    if (op == UNION)
+      return t2;
+    discard(t2, garbage);
+    return nullptr;
+  }
+  if (t2 == nullptr)
+  {
+    if (op == INTERSECTION)
     {
-      //std::cout << "case 2 deleting: " << st_root->key << "\n";
-      Node* tmp = st_root;
-      st_root = st_root->left;
-      count--;
-      delete tmp;
-      tmp = nullptr;
+      discard(t1, garbage);
+      return nullptr;
     }
-    // case 3: inorder successor
-    // use iteration to find , replace , delete inorder successor
-    else 
+    return t1;
+  }
+
+  // t1's root splits t2, and each side is combined with the matching
+  // child of t1
+  bool parallel = threads > 1 and t1->size + t2->size >= MIN_PARALLEL_SIZE;
+  Node* left2 = nullptr;
+  Node* found = nullptr;
+  Node* right2 = nullptr;
+  split(t2, t1->key, left2, found, right2);
+  Node* left1 = t1->left;
+  Node* right1 = t1->right;
+
+  Node* left = nullptr;
+  Node* right = nullptr;
+  if (parallel)
+  {
+    // the two sides share no nodes, and the left side collects its
+    // dropped nodes separately until it is done
+    Node* left_garbage = nullptr;
+    std::thread left_worker([&]() {
+      left = combine(left1, left2, op, threads / 2, left_garbage);
+    });
+    right = combine(right1, right2, op, threads - threads / 2, garbage);
+    left_worker.join();
+    if (left_garbage != nullptr)
     {
-      //std::cout << "case 3" << "\n";
-      //finds successor
-      Node* succ = st_root->right;
-      Node* pre = st_root;
-      while (succ->left != nullptr)
-      {
-        pre = succ;
-        succ = succ->left;
-      }
-
-      //copies the key of the successor into root
-      st_root->key = succ->key;
-      st_root->value = succ->value;
-
-      //deletes
-      st_root->right = erase(succ->key, st_root->right);
-      if(pre != st_root)
-        pre->left = succ->right;
-      else if (pre == st_root)
-      {
-        pre->right = succ->right;
-      }
+      Node* last = left_garbage;
+      while (last->left != nullptr)
+        last = last->left;
+      last->left = garbage;
+      garbage = left_garbage;
     }
   }
-  
-  int rH = 0;
-  int lH = 0;
-  if (st_root)
-  {
-  if (st_root->left)
-    lH = st_root->left->height;
-  if (st_root->right)
-    rH = st_root->right->height;
-  
-  if (lH > rH)
-    st_root->height = lH + 1;
   else
-    st_root->height = rH + 1;
+  {
+    left = combine(left1, left2, op, 1, garbage);
+    right = combine(right1, right2, op, 1, garbage);
   }
-  return rebalance(st_root);
+
+  // t1's pair is kept over a duplicate from t2
+  if (found != nullptr)
+  {
+    found->left = garbage;
+    garbage = found;
+  }
+  bool keep = op == UNION or (op == INTERSECTION) == (found != nullptr);
+  if (keep)
+    return join(left, t1, right);
+  t1->left = garbage;
+  garbage = t1;
+  return join2(left, right);
 }
 
-// insert helper
+// push every node of a subtree onto garbage
 template<typename K, typename V>
-typename AVLMap<K,V>::Node* AVLMap<K,V>::insert(const K& key, const V& value, Node* st_root)
+void AVLMap<K,V>::discard(Node* st_root, Node*& garbage)
 {
   if (st_root == nullptr)
+    return;
+  discard(st_root->left, garbage);
+  discard(st_root->right, garbage);
+  st_root->left = garbage;
+  garbage = st_root;
+}
+
+// union_with, intersect_with, and difference_with helper
+template<typename K, typename V>
+void AVLMap<K,V>::set_operation(AVLMap&& rhs, SetOp op, int threads)
+{
+  if (&rhs == this)
   {
-    Node* ptr = new Node;
-    ptr->key = key;
-    ptr->value = value;
-    ptr->left = nullptr;
-    ptr->right = nullptr;
-    ptr->height = 1;
-    count++;
-    return ptr;
+    // a map's union and intersection with itself is itself
+    if (op == DIFFERENCE)
+      make_empty();
+    return;
   }
-  else 
+
+  Node* rhs_root = rhs.root;
+  rhs.root = nullptr;
+  rhs.count = 0;
+  pool.splice(rhs.pool);
+
+  Node* garbage = nullptr;
+  root = combine(root, rhs_root, op, threads, garbage);
+  count = subtree_size(root);
+
+  while (garbage != nullptr)
   {
-    if (key > st_root->key)
+    Node* del = garbage;
+    garbage = garbage->left;
+    pool.free(del);
+  }
+}
+
+// insert_or_assign and try_emplace helper
+template<typename K, typename V>
+bool AVLMap<K,V>::insert_unique(const K& key, const V& value, bool assign)
+{
+  Node** path[MAX_DEPTH];
+  int depth = 0;
+  Node** link = &root;
+  while (*link != nullptr)
+  {
+    if (key == (*link)->key)
     {
-      st_root->right = insert(key, value, st_root->right);
+      // found, so no heights change
+      if (assign)
+        (*link)->value = value;
+      return false;
     }
+    path[depth++] = link;
+    if (key > (*link)->key)
+      link = &(*link)->right;
     else
+      link = &(*link)->left;
+  }
+
+  Node* ptr = pool.alloc();
+  ptr->key = key;
+  ptr->value = value;
+  ptr->left = nullptr;
+  ptr->right = nullptr;
+  ptr->height = 1;
+  ptr->size = 1;
+  *link = ptr;
+  count++;
+
+  rebalance_path(path, depth);
+  return true;
+}
+
+// walk back up a search path fixing heights and rotating
+template<typename K, typename V>
+void AVLMap<K,V>::rebalance_path(Node** path[], int depth)
+{
+  int i = depth - 1;
+  while (i >= 0)
+  {
+    Node*& st_root = *path[i--];
+    int old_height = st_root->height;
+    update(st_root);
+    st_root = rebalance(st_root);
+    if (st_root->height == old_height)
+      break;
+  }
+
+  // every ancestor still gained (or lost) a node
+  while (i >= 0)
+  {
+    Node* st_root = *path[i--];
+    st_root->size = subtree_size(st_root->left) + subtree_size(st_root->right) + 1;
+  }
+}
+
+// height of a subtree (0 if empty)
+template<typename K, typename V>
+int AVLMap<K,V>::height(const Node* st_root)
+{
+  if (st_root == nullptr)
+    return 0;
+  return st_root->height;
+}
+
+// number of nodes in a subtree (0 if empty)
+template<typename K, typename V>
+int AVLMap<K,V>::subtree_size(const Node* st_root)
+{
+  if (st_root == nullptr)
+    return 0;
+  return st_root->size;
+}
+
+// number of keys in the collection less than (or equal to) key
+template<typename K, typename V>
+int AVLMap<K,V>::count_less(const K& key, bool inclusive) const
+{
+  int less = 0;
+  Node* ptr = root;
+  while (ptr != nullptr)
+  {
+    if (ptr->key < key or (inclusive and ptr->key == key))
     {
-      st_root->left = insert(key, value, st_root->left);
+      // ptr and its whole left subtree are below key
+      less += subtree_size(ptr->left) + 1;
+      ptr = ptr->right;
     }
-    int rH = 0;
-    int lH = 0;
-    if (st_root->left)
-      lH = st_root->left->height;
-    if (st_root->right)
-      rH = st_root->right->height;
-  
-    if (lH > rH)
-      st_root->height = lH + 1;
     else
-      st_root->height = rH + 1;
-  } 
+      ptr = ptr->left;
+  }
+  return less;
+}
 
-  return rebalance(st_root);
+// lower_bound and upper_bound helper
+template<typename K, typename V>
+typename AVLMap<K,V>::const_iterator AVLMap<K,V>::bound(const K& key, bool upper) const
+{
+  // keep exactly the nodes an in-order walk from the bound would
+  // still visit on the way back up: those where the search went left
+  const_iterator it;
+  const Node* ptr = root;
+  while (ptr != nullptr)
+  {
+    if (ptr->key < key or (upper and ptr->key == key))
+      ptr = ptr->right;
+    else
+    {
+      it.stack[it.depth++] = ptr;
+      ptr = ptr->left;
+    }
+  }
+  return it;
+}
+
+// recompute a node's height and subtree size from its children
+template<typename K, typename V>
+void AVLMap<K,V>::update(Node* st_root)
+{
+  st_root->size = subtree_size(st_root->left) + subtree_size(st_root->right) + 1;
+  int lH = height(st_root->left);
+  int rH = height(st_root->right);
+  if (lH > rH)
+    st_root->height = lH + 1;
+  else
+    st_root->height = rH + 1;
 }
   
 // find_keys helper
 template<typename K, typename V>
 void AVLMap<K,V>::find_keys(const K& k1, const K& k2, const Node* st_root, ArraySeq<K>& keys) const
 {
-  //do this different
-  if (!st_root)
+  //base
+  if (st_root == nullptr)
     return;
+
+  // only subtrees that can hold keys in [k1, k2] are visited, so the
+  // walk follows the paths to k1 and k2 plus the keys in between
   if (k1 < st_root->key)
     find_keys(k1, k2, st_root->left, keys);
 
-  if (k1 <= st_root->key and k2 >= st_root->key)
+  if (st_root->key >= k1 and st_root->key <= k2)
     keys.insert(st_root->key, keys.size());
 
-  find_keys(k1, k2, st_root->right, keys);
-  /*  
-  else if (st_root->key <= k1)
+  if (st_root->key < k2)
     find_keys(k1, k2, st_root->right, keys);
-  else if (st_root->key > k1)
-    find_keys(k1, k2, st_root->left, keys);
-  //else if (st_root->key == k1)
-    //keys.insert(k1, keys.size());
-  
-  find_keys(k1, k2, st_root->right, keys);
-  std::cout << "key: " << st_root->key << " k1: " << k1 << " k2: " << k2 <<std::endl;
-  keys.insert(st_root->key, keys.size());
-*/
 }
 
 // sorted_keys helper
@@ -535,31 +1406,8 @@ typename AVLMap<K,V>::Node* AVLMap<K,V>::right_rotate(Node* k2)
   Node* k1 = k2->left;
   k2->left = k1->right;
   k1->right = k2;
-  
-  int rH = 0;
-  int lH = 0;
-  if (k2->left)
-    lH = k2->left->height;
-  if (k2->right)
-    rH = k2->right->height;
-  
-  if (lH > rH)
-    k2->height = lH + 1;
-  else
-    k2->height = rH + 1;
-  
-  rH = 0;
-  lH = 0;
-  if (k1->left)
-    lH = k1->left->height;
-  if (k1->right)
-    rH = k1->right->height;
-  
-  if (lH > rH)
-    k1->height = lH + 1;
-  else
-    k1->height = rH + 1;
-  
+  update(k2);
+  update(k1);
   return k1;
 }
 
@@ -570,31 +1418,8 @@ typename AVLMap<K,V>::Node* AVLMap<K,V>::left_rotate(Node* k2)
   Node* k1 = k2->right;
   k2->right = k1->left;
   k1->left = k2;
-
-  int rH = 0;
-  int lH = 0;
-  if (k2->left)
-    lH = k2->left->height;
-  if (k2->right)
-    rH = k2->right->height;
-  
-  if (lH > rH)
-    k2->height = lH + 1;
-  else
-    k2->height = rH + 1;
-  
-  rH = 0;
-  lH = 0;
-  if (k1->left)
-    lH = k1->left->height;
-  if (k1->right)
-    rH = k1->right->height;
-  
-  if (lH > rH)
-    k1->height = lH + 1;
-  else
-    k1->height = rH + 1;
-  
+  update(k2);
+  update(k1);
   return k1;
 }
   
@@ -605,60 +1430,23 @@ typename AVLMap<K,V>::Node* AVLMap<K,V>::rebalance(Node* st_root)
   if (!st_root)
     return nullptr;
 
-  Node* lptr = st_root->left;
-  Node* rptr = st_root->right;
-  
-  int BF = 0;
-  int rH = 0;
-  int lH = 0;
-  if (lptr)
-    lH = lptr->height;
-  if (rptr)
-    rH = rptr->height;
-  
-  BF = lH - rH;
-  
-  if ((lptr and !rptr) and (lptr->height > 1))
-  {
-    //check for double
-    if (lptr->right != nullptr)
-    {
-      lptr = left_rotate(lptr);
-      st_root->left = lptr;
-    }
-    //rotate right
-    st_root = right_rotate(st_root);
-  }
-  else if ((!lptr and rptr) and (rptr->height > 1))
-  {
-    //check for double
-    if (rptr->left != nullptr)
-    {
-      rptr = right_rotate(rptr);
-      st_root->right = rptr;
-    }
-    //rotate left
-    st_root = left_rotate(st_root);
-  }
-  else if ((lptr and rptr) and BF > 1) //left heavy
+  int BF = height(st_root->left) - height(st_root->right);
+
+  if (BF > 1) //left heavy
   {
     //check for double
-    if (lptr->right->height > lptr->left->height)
-    {
-      lptr = left_rotate(lptr);
-      st_root->left = lptr;
-    }
+    Node* lptr = st_root->left;
+    if (height(lptr->right) > height(lptr->left))
+      st_root->left = left_rotate(lptr);
     //rotate right
     st_root = right_rotate(st_root);
   }
-  else if ((lptr and rptr) and BF < -1) //right heavy
+  else if (BF < -1) //right heavy
   {
     //check for double
-    if (rptr->left->height > rptr->right->height)
-    {
-      rptr = right_rotate(rptr);
-      st_root->right = rptr;
-    }
+    Node* rptr = st_root->right;
+    if (height(rptr->left) > height(rptr->right))
+      st_root->right = right_rotate(rptr);
     //rotate left
     st_root = left_rotate(st_root);
   }
@@ -7,8 +7,11 @@
 #ifndef BINSEARCHMAP_H
 #define BINSEARCHMAP_H
 
+#include <cstddef>
+#include <iterator>
 #include "map.h"
 #include "arrayseq.h"
+#include "keyrange.h"
 
 
 template<typename K, typename V>
@@ -45,12 +48,80 @@ public:
   // otherwise.
   bool contains(const K& key) const;
 
+  // Returns a pointer to the value for the given key, or nullptr if
+  // the key is not in the collection.
+  V* find(const K& key);
+  const V* find(const K& key) const;
+
+  // Sets the value for the given key, adding the key-value pair if
+  // the key is not in the collection. Returns true if the pair was
+  // added and false if an existing value was replaced.
+  bool insert_or_assign(const K& key, const V& value);
+
+  // Adds the key-value pair if the key is not in the collection and
+  // otherwise leaves the existing value alone. Returns true if the
+  // pair was added.
+  bool try_emplace(const K& key, const V& value);
+
   // Returns the keys k in the collection such that k1 <= k <= k2
   ArraySeq<K> find_keys(const K& k1, const K& k2) const;
 
   // Returns the keys in the collection in ascending sorted order.
   ArraySeq<K> sorted_keys() const;  
 
+  // Returns the key-value pairs in ascending key order (the map's own
+  // storage), e.g. to build an AVLMap from them in linear time
+  const ArraySeq<std::pair<K,V>>& pairs() const;
+
+  // Forward iterator over the keys in ascending order. Dereferencing
+  // gives the key and value() gives its value. Insert and erase
+  // invalidate every iterator.
+  class const_iterator
+  {
+  public:
+    typedef std::forward_iterator_tag iterator_category;
+    typedef K value_type;
+    typedef std::ptrdiff_t difference_type;
+    typedef const K* pointer;
+    typedef const K& reference;
+
+    // an iterator that refers to no map
+    const_iterator();
+
+    const K& operator*() const;
+    const K* operator->() const;
+
+    // the value for the current key
+    const V& value() const;
+
+    // move to the next key
+    const_iterator& operator++();
+    const_iterator operator++(int);
+
+    bool operator==(const const_iterator& rhs) const;
+    bool operator!=(const const_iterator& rhs) const;
+
+  private:
+    friend class BinSearchMap;
+    const_iterator(const ArraySeq<std::pair<K,V>>* seq, int index);
+
+    const ArraySeq<std::pair<K,V>>* seq = nullptr;
+    int index = 0;
+  };
+
+  // iterators to the smallest key and one past the largest key
+  const_iterator begin() const;
+  const_iterator end() const;
+
+  // Returns an iterator to the first key not less than (lower_bound)
+  // or greater than (upper_bound) the given key, or end()
+  const_iterator lower_bound(const K& key) const;
+  const_iterator upper_bound(const K& key) const;
+
+  // Returns a view of the keys k such that k1 <= k <= k2, the same
+  // keys as find_keys but read in place as they are iterated
+  KeyRange<const_iterator> range(const K& k1, const K& k2) const;
+
 private:
 
   // If the key is in the collection, bin_search returns true and
@@ -59,10 +130,18 @@ private:
   // bin_search returns false and provides the last index checked by
   // the binary search algorithm. 
   bool bin_search(const K& key, int& index) const;
+
+  // lower_bound and upper_bound helper, returns the index of the first
+  // key not less than key (or greater than key if upper), or size()
+  int bound_index(const K& key, bool upper) const;
   
   // implemented as a resizable array of (key-value) pairs
   ArraySeq<std::pair<K,V>> seq;
 
+  // insert_or_assign and try_emplace helper, searches for the key
+  // once and either adds the pair or (if assign) replaces the value
+  bool insert_unique(const K& key, const V& value, bool assign);
+
 };
 
 // TODO: Implement the BinSearchMap functions below. Note that you do
@@ -153,6 +232,46 @@ bool BinSearchMap<K,V>::contains(const K& key) const
   return bin_search(key, index);
 }
 
+// Returns a pointer to the value for the given key, or nullptr if
+// the key is not in the collection.
+template<typename K, typename V>
+V* BinSearchMap<K,V>::find(const K& key)
+{
+  int index = -1;
+  if (bin_search(key, index))
+    return &seq[index].second;
+  return nullptr;
+}
+
+// Returns a pointer to the value for the given key, or nullptr if
+// the key is not in the collection.
+template<typename K, typename V>
+const V* BinSearchMap<K,V>::find(const K& key) const
+{
+  int index = -1;
+  if (bin_search(key, index))
+    return &seq[index].second;
+  return nullptr;
+}
+
+// Sets the value for the given key, adding the key-value pair if
+// the key is not in the collection. Returns true if the pair was
+// added and false if an existing value was replaced.
+template<typename K, typename V>
+bool BinSearchMap<K,V>::insert_or_assign(const K& key, const V& value)
+{
+  return insert_unique(key, value, true);
+}
+
+// Adds the key-value pair if the key is not in the collection and
+// otherwise leaves the existing value alone. Returns true if the
+// pair was added.
+template<typename K, typename V>
+bool BinSearchMap<K,V>::try_emplace(const K& key, const V& value)
+{
+  return insert_unique(key, value, false);
+}
+
 // Returns the keys k in the collection such that k1 <= k <= k2
 template<typename K, typename V>
 ArraySeq<K> BinSearchMap<K,V>::find_keys(const K& k1, const K& k2) const 
@@ -176,6 +295,13 @@ ArraySeq<K> BinSearchMap<K,V>::find_keys(const K& k1, const K& k2) const
   return tmp;
 }
 
+// Returns the key-value pairs in ascending key order
+template<typename K, typename V>
+const ArraySeq<std::pair<K,V>>& BinSearchMap<K,V>::pairs() const
+{
+  return seq;
+}
+
 // Returns the keys in the collection in ascending sorted order.
 template<typename K, typename V>
 ArraySeq<K> BinSearchMap<K,V>::sorted_keys() const 
@@ -186,6 +312,102 @@ ArraySeq<K> BinSearchMap<K,V>::sorted_keys() const
   return tmp;
 }
 
+// iterator to the smallest key
+template<typename K, typename V>
+typename BinSearchMap<K,V>::const_iterator BinSearchMap<K,V>::begin() const
+{
+  return const_iterator(&seq, 0);
+}
+
+// iterator to one past the largest key
+template<typename K, typename V>
+typename BinSearchMap<K,V>::const_iterator BinSearchMap<K,V>::end() const
+{
+  return const_iterator(&seq, seq.size());
+}
+
+// Returns an iterator to the first key not less than the given key
+template<typename K, typename V>
+typename BinSearchMap<K,V>::const_iterator BinSearchMap<K,V>::lower_bound(const K& key) const
+{
+  return const_iterator(&seq, bound_index(key, false));
+}
+
+// Returns an iterator to the first key greater than the given key
+template<typename K, typename V>
+typename BinSearchMap<K,V>::const_iterator BinSearchMap<K,V>::upper_bound(const K& key) const
+{
+  return const_iterator(&seq, bound_index(key, true));
+}
+
+// Returns a view of the keys k such that k1 <= k <= k2
+template<typename K, typename V>
+KeyRange<typename BinSearchMap<K,V>::const_iterator> BinSearchMap<K,V>::range(const K& k1, const K& k2) const
+{
+  const_iterator first = lower_bound(k1);
+  if (k2 < k1)
+    return KeyRange<const_iterator>(first, first);
+  return KeyRange<const_iterator>(first, upper_bound(k2));
+}
+
+template<typename K, typename V>
+BinSearchMap<K,V>::const_iterator::const_iterator()
+{
+}
+
+template<typename K, typename V>
+BinSearchMap<K,V>::const_iterator::const_iterator(const ArraySeq<std::pair<K,V>>* seq, int index)
+  : seq(seq), index(index)
+{
+}
+
+template<typename K, typename V>
+const K& BinSearchMap<K,V>::const_iterator::operator*() const
+{
+  return (*seq)[index].first;
+}
+
+template<typename K, typename V>
+const K* BinSearchMap<K,V>::const_iterator::operator->() const
+{
+  return &(*seq)[index].first;
+}
+
+// the value for the current key
+template<typename K, typename V>
+const V& BinSearchMap<K,V>::const_iterator::value() const
+{
+  return (*seq)[index].second;
+}
+
+// move to the next key
+template<typename K, typename V>
+typename BinSearchMap<K,V>::const_iterator& BinSearchMap<K,V>::const_iterator::operator++()
+{
+  ++index;
+  return *this;
+}
+
+template<typename K, typename V>
+typename BinSearchMap<K,V>::const_iterator BinSearchMap<K,V>::const_iterator::operator++(int)
+{
+  const_iterator tmp = *this;
+  ++index;
+  return tmp;
+}
+
+template<typename K, typename V>
+bool BinSearchMap<K,V>::const_iterator::operator==(const const_iterator& rhs) const
+{
+  return seq == rhs.seq and index == rhs.index;
+}
+
+template<typename K, typename V>
+bool BinSearchMap<K,V>::const_iterator::operator!=(const const_iterator& rhs) const
+{
+  return !(*this == rhs);
+}
+
 // If the key is in the collection, bin_search returns true and
 // provides the key's index within the array sequence (via the index
 // output parameter). If the key is not in the collection,
@@ -221,5 +443,46 @@ bool BinSearchMap<K,V>::bin_search(const K& key, int& index) const
   }
   return false;
 }
+
+// lower_bound and upper_bound helper, returns the index of the first
+// key not less than key (or greater than key if upper), or size()
+template<typename K, typename V>
+int BinSearchMap<K,V>::bound_index(const K& key, bool upper) const
+{
+  int start = 0;
+  int end = seq.size();
+  while (start < end)
+  {
+    int mid = (start + end) / 2;
+    if (seq[mid].first < key or (upper and seq[mid].first == key))
+      start = mid + 1;
+    else
+      end = mid;
+  }
+  return start;
+}
+  
+// insert_or_assign and try_emplace helper
+template<typename K, typename V>
+bool BinSearchMap<K,V>::insert_unique(const K& key, const V& value, bool assign)
+{
+  int index = -1;
+  if (bin_search(key, index))
+  {
+    if (assign)
+      seq[index].second = value;
+    return false;
+  }
+
+  // bin_search leaves index on the last element checked, which is
+  // next to where the key belongs
+  if (index == -1)
+    seq.insert(std::pair<K,V> {key, value}, 0);
+  else if (seq[index].first > key)
+    seq.insert(std::pair<K,V> {key, value}, index);
+  else
+    seq.insert(std::pair<K,V> {key, value}, index + 1);
+  return true;
+}
   
 #endif
@@ -0,0 +1,556 @@
+//---------------------------------------------------------------------------
+// NAME: Adam Huonder
+// DATE: Fall 2021
+// DESC: Implements a map adapter that keeps a blocked Bloom filter
+//       in front of another map so most misses skip the map
+//---------------------------------------------------------------------------
+
+#ifndef BLOOMMAP_H
+#define BLOOMMAP_H
+
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <stdexcept>
+#include "map.h"
+#include "arrayseq.h"
+#include "hashmap.h"
+
+//{{{ Header
+// M is the map holding the key-value pairs (AVLMap<K,V>,
+// BinSearchMap<K,V>, ...). Every key is also added to a blocked Bloom
+// filter: each key picks one 64-byte block and sets a few bits in it,
+// so a lookup for a key that is not in the map is usually rejected
+// after reading a single cache line instead of searching M. Erased
+// keys cannot be removed from the filter, so it is rebuilt from M
+// after enough erases (and when the map outgrows it).
+template<typename K, typename V, typename M, typename Hash = std::hash<K>>
+class BloomMap : public Map<K,V>
+{
+public:
+
+  // default constructor, the filter is sized for the given false
+  // positive rate (0 < false_positive_rate < 1)
+  BloomMap(double false_positive_rate = 0.01);
+
+  // copy constructor
+  BloomMap(const BloomMap& rhs);
+
+  // move constructor
+  BloomMap(BloomMap&& rhs);
+
+  // copy assignment
+  BloomMap& operator=(const BloomMap& rhs);
+
+  // move assignment
+  BloomMap& operator=(BloomMap&& rhs);
+
+  // destructor
+  ~BloomMap();
+
+  // Returns the number of key-value pairs in the map
+  int size() const;
+
+  // Tests if the map is empty
+  bool empty() const;
+
+  // Allows values associated with a key to be updated. Throws
+  // out_of_range if the given key is not in the collection.
+  V& operator[](const K& key);
+
+  // Returns the value for a given key. Throws out_of_range if the
+  // given key is not in the collection.
+  const V& operator[](const K& key) const;
+
+  // Extends the collection by adding the given key-value
+  // pair. Assumes the key being added is not present in the
+  // collection. Insert does not check if the key is present.
+  void insert(const K& key, const V& value);
+
+  // Shrinks the collection by removing the key-value pair with the
+  // given key. Throws out_of_range if the given key is not in the
+  // collection.
+  void erase(const K& key);
+
+  // Returns true if the key is in the collection, and false otherwise.
+  bool contains(const K& key) const;
+
+  // Returns a pointer to the value for the given key, or nullptr if
+  // the key is not in the collection.
+  V* find(const K& key);
+  const V* find(const K& key) const;
+
+  // Sets the value for the given key, adding the key-value pair if
+  // the key is not in the collection. Returns true if the pair was
+  // added and false if an existing value was replaced.
+  bool insert_or_assign(const K& key, const V& value);
+
+  // Adds the key-value pair if the key is not in the collection and
+  // otherwise leaves the existing value alone. Returns true if the
+  // pair was added.
+  bool try_emplace(const K& key, const V& value);
+
+  // Returns the keys k in the collection such that k1 <= k <= k2
+  ArraySeq<K> find_keys(const K& k1, const K& k2) const;
+
+  // Returns the keys in the collection in ascending sorted order
+  ArraySeq<K> sorted_keys() const;
+
+  // The underlying map (for operations the adapter does not wrap)
+  const M& base() const;
+
+  // statistics functions for the filter: lookups answered by the
+  // filter alone (map searches avoided), lookups passed on to the
+  // map, and passed lookups that turned out to be misses
+  long filtered_lookups() const;
+  long passed_lookups() const;
+  long false_positives() const;
+
+private:
+
+  // a 512-bit block, aligned to a cache line
+  struct alignas(64) Block {
+    std::uint64_t words[8];
+  };
+
+  // keys the filter is first sized for
+  static const int MIN_PLANNED = 1024;
+
+  // the map holding the key-value pairs
+  M map;
+
+  // target false positive rate
+  double fp_rate;
+
+  // bits set per key
+  int probes = 0;
+
+  // number of blocks, always a power of two
+  int nblocks = 0;
+
+  // the filter
+  Block* blocks = nullptr;
+
+  // number of keys the filter is sized for (it is rebuilt larger
+  // once the map holds more)
+  int planned = MIN_PLANNED;
+
+  // erases since the filter was last rebuilt. Once stale keys make up
+  // half of the filter it is rebuilt.
+  int erased = 0;
+
+  // lookup counters
+  mutable long filtered = 0;
+  mutable long passed = 0;
+  mutable long false_pos = 0;
+
+  // the user supplied hasher
+  Hash hasher;
+
+  // the hash function (hasher output run through mix_hash)
+  std::size_t hash(const K& key) const;
+
+  // set the key's bits in the filter
+  void add(const K& key);
+
+  // returns false if the key is definitely not in the map, and true
+  // if it may be
+  bool filter_contains(const K& key) const;
+
+  // filter_contains, counting the result as a filtered or passed
+  // lookup
+  bool may_contain(const K& key) const;
+
+  // size the filter for planned keys and add every key of the map
+  void rebuild();
+
+  // helper to copy the filter of another map
+  void copy(const BloomMap& rhs);
+};
+//}}}
+
+//{{{ public functions / essential operators
+// default constructor
+template<typename K, typename V, typename M, typename Hash>
+BloomMap<K,V,M,Hash>::BloomMap(double false_positive_rate)
+{
+  if (false_positive_rate <= 0 or false_positive_rate >= 1)
+    throw std::invalid_argument("BloomMap<K,V,M,Hash>::BloomMap(double false_positive_rate). Rate must be in (0, 1).");
+  fp_rate = false_positive_rate;
+  rebuild();
+}
+
+// copy constructor
+template<typename K, typename V, typename M, typename Hash>
+BloomMap<K,V,M,Hash>::BloomMap(const BloomMap& rhs)
+  : map(rhs.map)
+{
+  copy(rhs);
+}
+
+// move constructor
+template<typename K, typename V, typename M, typename Hash>
+BloomMap<K,V,M,Hash>::BloomMap(BloomMap&& rhs)
+  : map(std::move(rhs.map))
+{
+  fp_rate = rhs.fp_rate;
+  probes = rhs.probes;
+  nblocks = rhs.nblocks;
+  blocks = rhs.blocks;
+  planned = rhs.planned;
+  erased = rhs.erased;
+  filtered = rhs.filtered;
+  passed = rhs.passed;
+  false_pos = rhs.false_pos;
+  hasher = rhs.hasher;
+  rhs.blocks = nullptr;
+  rhs.planned = MIN_PLANNED;
+  rhs.rebuild();
+}
+
+// copy assignment
+template<typename K, typename V, typename M, typename Hash>
+BloomMap<K,V,M,Hash>& BloomMap<K,V,M,Hash>::operator=(const BloomMap& rhs)
+{
+  if (this != &rhs)
+  {
+    map = rhs.map;
+    delete[] blocks;
+    copy(rhs);
+  }
+  return *this;
+}
+
+// move assignment
+template<typename K, typename V, typename M, typename Hash>
+BloomMap<K,V,M,Hash>& BloomMap<K,V,M,Hash>::operator=(BloomMap&& rhs)
+{
+  if (this != &rhs)
+  {
+    map = std::move(rhs.map);
+    delete[] blocks;
+    fp_rate = rhs.fp_rate;
+    probes = rhs.probes;
+    nblocks = rhs.nblocks;
+    blocks = rhs.blocks;
+    planned = rhs.planned;
+    erased = rhs.erased;
+    filtered = rhs.filtered;
+    passed = rhs.passed;
+    false_pos = rhs.false_pos;
+    hasher = rhs.hasher;
+    rhs.blocks = nullptr;
+    rhs.planned = MIN_PLANNED;
+    rhs.rebuild();
+  }
+  return *this;
+}
+
+// destructor
+template<typename K, typename V, typename M, typename Hash>
+BloomMap<K,V,M,Hash>::~BloomMap()
+{
+  delete[] blocks;
+}
+
+// Returns the number of key-value pairs in the map
+template<typename K, typename V, typename M, typename Hash>
+int BloomMap<K,V,M,Hash>::size() const
+{
+  return map.size();
+}
+
+// Tests if the map is empty
+template<typename K, typename V, typename M, typename Hash>
+bool BloomMap<K,V,M,Hash>::empty() const
+{
+  return map.empty();
+}
+
+// Allows values associated with a key to be updated. Throws
+// out_of_range if the given key is not in the collection.
+template<typename K, typename V, typename M, typename Hash>
+V& BloomMap<K,V,M,Hash>::operator[](const K& key)
+{
+  if (!may_contain(key))
+    throw std::out_of_range("V& BloomMap<K,V,M,Hash>::operator[](const K& key). Key does not exist.");
+  V* value = map.find(key);
+  if (value == nullptr)
+  {
+    false_pos++;
+    throw std::out_of_range("V& BloomMap<K,V,M,Hash>::operator[](const K& key). Key does not exist.");
+  }
+  return *value;
+}
+
+// Returns the value for a given key. Throws out_of_range if the
+// given key is not in the collection.
+template<typename K, typename V, typename M, typename Hash>
+const V& BloomMap<K,V,M,Hash>::operator[](const K& key) const
+{
+  if (!may_contain(key))
+    throw std::out_of_range("const V& BloomMap<K,V,M,Hash>::operator[](const K& key) const. Key does not exist.");
+  const M& cmap = map;
+  const V* value = cmap.find(key);
+  if (value == nullptr)
+  {
+    false_pos++;
+    throw std::out_of_range("const V& BloomMap<K,V,M,Hash>::operator[](const K& key) const. Key does not exist.");
+  }
+  return *value;
+}
+
+// Extends the collection by adding the given key-value
+// pair. Assumes the key being added is not present in the
+// collection. Insert does not check if the key is present.
+template<typename K, typename V, typename M, typename Hash>
+void BloomMap<K,V,M,Hash>::insert(const K& key, const V& value)
+{
+  map.insert(key, value);
+  if (map.size() > planned)
+  {
+    planned *= 2;
+    rebuild();
+  }
+  else
+    add(key);
+}
+
+// Shrinks the collection by removing the key-value pair with the
+// given key. Throws out_of_range if the given key is not in the
+// collection.
+template<typename K, typename V, typename M, typename Hash>
+void BloomMap<K,V,M,Hash>::erase(const K& key)
+{
+  if (!may_contain(key))
+    throw std::out_of_range("void BloomMap<K,V,M,Hash>::erase(const K& key). Key does not exist.");
+  if (!map.contains(key))
+  {
+    false_pos++;
+    throw std::out_of_range("void BloomMap<K,V,M,Hash>::erase(const K& key). Key does not exist.");
+  }
+  map.erase(key);
+  erased++;
+  if (erased > map.size() and erased > MIN_PLANNED)
+  {
+    while (planned / 2 >= MIN_PLANNED and planned / 2 >= map.size() * 2)
+      planned /= 2;
+    rebuild();
+  }
+}
+
+// Returns true if the key is in the collection, and false otherwise.
+template<typename K, typename V, typename M, typename Hash>
+bool BloomMap<K,V,M,Hash>::contains(const K& key) const
+{
+  if (!may_contain(key))
+    return false;
+  if (map.contains(key))
+    return true;
+  false_pos++;
+  return false;
+}
+
+// Returns a pointer to the value for the given key, or nullptr if
+// the key is not in the collection.
+template<typename K, typename V, typename M, typename Hash>
+V* BloomMap<K,V,M,Hash>::find(const K& key)
+{
+  if (!may_contain(key))
+    return nullptr;
+  V* value = map.find(key);
+  if (value == nullptr)
+    false_pos++;
+  return value;
+}
+
+// Returns a pointer to the value for the given key, or nullptr if
+// the key is not in the collection.
+template<typename K, typename V, typename M, typename Hash>
+const V* BloomMap<K,V,M,Hash>::find(const K& key) const
+{
+  if (!may_contain(key))
+    return nullptr;
+  const M& cmap = map;
+  const V* value = cmap.find(key);
+  if (value == nullptr)
+    false_pos++;
+  return value;
+}
+
+// Sets the value for the given key, adding the key-value pair if
+// the key is not in the collection. Returns true if the pair was
+// added and false if an existing value was replaced.
+template<typename K, typename V, typename M, typename Hash>
+bool BloomMap<K,V,M,Hash>::insert_or_assign(const K& key, const V& value)
+{
+  // an internal probe, so it is not counted as a lookup
+  V* existing = filter_contains(key) ? map.find(key) : nullptr;
+  if (existing != nullptr)
+  {
+    *existing = value;
+    return false;
+  }
+  insert(key, value);
+  return true;
+}
+
+// Adds the key-value pair if the key is not in the collection and
+// otherwise leaves the existing value alone. Returns true if the
+// pair was added.
+template<typename K, typename V, typename M, typename Hash>
+bool BloomMap<K,V,M,Hash>::try_emplace(const K& key, const V& value)
+{
+  // an internal probe, so it is not counted as a lookup
+  if (filter_contains(key) and map.find(key) != nullptr)
+    return false;
+  insert(key, value);
+  return true;
+}
+
+// Returns the keys k in the collection such that k1 <= k <= k2
+template<typename K, typename V, typename M, typename Hash>
+ArraySeq<K> BloomMap<K,V,M,Hash>::find_keys(const K& k1, const K& k2) const
+{
+  return map.find_keys(k1, k2);
+}
+
+// Returns the keys in the collection in ascending sorted order
+template<typename K, typename V, typename M, typename Hash>
+ArraySeq<K> BloomMap<K,V,M,Hash>::sorted_keys() const
+{
+  return map.sorted_keys();
+}
+
+// The underlying map
+template<typename K, typename V, typename M, typename Hash>
+const M& BloomMap<K,V,M,Hash>::base() const
+{
+  return map;
+}
+//}}}
+
+//{{{ statistics functions for the filter
+template<typename K, typename V, typename M, typename Hash>
+long BloomMap<K,V,M,Hash>::filtered_lookups() const
+{
+  return filtered;
+}
+
+template<typename K, typename V, typename M, typename Hash>
+long BloomMap<K,V,M,Hash>::passed_lookups() const
+{
+  return passed;
+}
+
+template<typename K, typename V, typename M, typename Hash>
+long BloomMap<K,V,M,Hash>::false_positives() const
+{
+  return false_pos;
+}
+//}}}
+
+//{{{ private functions
+// the hash function
+template<typename K, typename V, typename M, typename Hash>
+std::size_t BloomMap<K,V,M,Hash>::hash(const K& key) const
+{
+  return mix_hash(hasher(key));
+}
+
+// set the key's bits in the filter. The high bits of the hash pick
+// the block, and the bits within it come from double hashing on a
+// second mix of the hash.
+template<typename K, typename V, typename M, typename Hash>
+void BloomMap<K,V,M,Hash>::add(const K& key)
+{
+  std::size_t h = hash(key);
+  Block& block = blocks[(h >> 32) & (nblocks - 1)];
+  std::uint64_t g = mix_hash(h);
+  std::uint32_t g1 = g;
+  std::uint32_t g2 = (g >> 32) | 1;
+  for (int i = 0; i < probes; ++i)
+  {
+    int bit = (g1 + i * g2) & 511;
+    block.words[bit >> 6] |= 1ULL << (bit & 63);
+  }
+}
+
+// returns false if the key is definitely not in the map
+template<typename K, typename V, typename M, typename Hash>
+bool BloomMap<K,V,M,Hash>::filter_contains(const K& key) const
+{
+  std::size_t h = hash(key);
+  const Block& block = blocks[(h >> 32) & (nblocks - 1)];
+  std::uint64_t g = mix_hash(h);
+  std::uint32_t g1 = g;
+  std::uint32_t g2 = (g >> 32) | 1;
+  for (int i = 0; i < probes; ++i)
+  {
+    int bit = (g1 + i * g2) & 511;
+    if (!(block.words[bit >> 6] & (1ULL << (bit & 63))))
+      return false;
+  }
+  return true;
+}
+
+// filter_contains, counting the result
+template<typename K, typename V, typename M, typename Hash>
+bool BloomMap<K,V,M,Hash>::may_contain(const K& key) const
+{
+  if (!filter_contains(key))
+  {
+    filtered++;
+    return false;
+  }
+  passed++;
+  return true;
+}
+
+// size the filter for planned keys and add every key of the map
+template<typename K, typename V, typename M, typename Hash>
+void BloomMap<K,V,M,Hash>::rebuild()
+{
+  // optimal bits per key and bit count for the target rate
+  double ln2 = std::log(2.0);
+  double bits_per_key = -std::log(fp_rate) / (ln2 * ln2);
+  probes = (int) std::lround(bits_per_key * ln2);
+  if (probes < 1)
+    probes = 1;
+  if (probes > 16)
+    probes = 16;
+  long bits = (long) std::ceil(bits_per_key * planned);
+  int new_nblocks = 1;
+  while (new_nblocks * 512L < bits)
+    new_nblocks *= 2;
+
+  delete[] blocks;
+  nblocks = new_nblocks;
+  blocks = new Block[nblocks]();
+  erased = 0;
+
+  ArraySeq<K> keys = map.sorted_keys();
+  for (int i = 0; i < keys.size(); ++i)
+    add(keys[i]);
+}
+
+// helper to copy the filter of another map
+template<typename K, typename V, typename M, typename Hash>
+void BloomMap<K,V,M,Hash>::copy(const BloomMap& rhs)
+{
+  fp_rate = rhs.fp_rate;
+  probes = rhs.probes;
+  nblocks = rhs.nblocks;
+  planned = rhs.planned;
+  erased = rhs.erased;
+  filtered = rhs.filtered;
+  passed = rhs.passed;
+  false_pos = rhs.false_pos;
+  hasher = rhs.hasher;
+  blocks = new Block[nblocks];
+  for (int i = 0; i < nblocks; ++i)
+    blocks[i] = rhs.blocks[i];
+}
+//}}}
+
+#endif
@@ -7,13 +7,21 @@
 #ifndef BSTMAP_H
 #define BSTMAP_H
 
+#include <cstddef>
+#include <iterator>
+#include <type_traits>
 #include "map.h"
 #include "arrayseq.h"
+#include "nodepool.h"
+#include "keyrange.h"
 
 
 template<typename K, typename V>
 class BSTMap : public Map<K,V>
 {
+  // tree node (defined below)
+  struct Node;
+
 public:
 
   // default constructor
@@ -62,6 +70,21 @@ public:
   // Returns true if the key is in the collection, and false otherwise.
   bool contains(const K& key) const;
 
+  // Returns a pointer to the value for the given key, or nullptr if
+  // the key is not in the collection.
+  V* find(const K& key);
+  const V* find(const K& key) const;
+
+  // Sets the value for the given key, adding the key-value pair if
+  // the key is not in the collection. Returns true if the pair was
+  // added and false if an existing value was replaced.
+  bool insert_or_assign(const K& key, const V& value);
+
+  // Adds the key-value pair if the key is not in the collection and
+  // otherwise leaves the existing value alone. Returns true if the
+  // pair was added.
+  bool try_emplace(const K& key, const V& value);
+
   // Returns the keys k in the collection such that k1 <= k <= k2
   ArraySeq<K> find_keys(const K& k1, const K& k2) const;
 
@@ -70,6 +93,62 @@ public:
 
   // Returns the height of the binary search tree
   int height() const;
+
+  // Forward iterator over the keys in ascending order. Dereferencing
+  // gives the key and value() gives its value. The nodes have no
+  // parent links, so the iterator keeps the nodes still to be visited
+  // on the current root-to-node path in a stack, and stepping is
+  // amortized O(1). The tree's height is unbounded, so unlike
+  // AVLMap's the stack grows as needed. Insert and erase invalidate
+  // every iterator.
+  class const_iterator
+  {
+  public:
+    typedef std::forward_iterator_tag iterator_category;
+    typedef K value_type;
+    typedef std::ptrdiff_t difference_type;
+    typedef const K* pointer;
+    typedef const K& reference;
+
+    // an iterator that refers to no map (equal to end())
+    const_iterator();
+
+    const K& operator*() const;
+    const K* operator->() const;
+
+    // the value for the current key
+    const V& value() const;
+
+    // move to the next key
+    const_iterator& operator++();
+    const_iterator operator++(int);
+
+    bool operator==(const const_iterator& rhs) const;
+    bool operator!=(const const_iterator& rhs) const;
+
+  private:
+    friend class BSTMap;
+
+    // push st_root and its chain of left children
+    void push_left(const Node* st_root);
+
+    // ancestors of the current node whose keys come after it, with
+    // the current node on top (empty at the end)
+    ArraySeq<const Node*> stack;
+  };
+
+  // iterators to the smallest key and one past the largest key
+  const_iterator begin() const;
+  const_iterator end() const;
+
+  // Returns an iterator to the first key not less than (lower_bound)
+  // or greater than (upper_bound) the given key, or end()
+  const_iterator lower_bound(const K& key) const;
+  const_iterator upper_bound(const K& key) const;
+
+  // Returns a view of the keys k such that k1 <= k <= k2, the same
+  // keys as find_keys but read in place as they are iterated
+  KeyRange<const_iterator> range(const K& k1, const K& k2) const;
   
 private:
 
@@ -87,15 +166,26 @@ private:
   // array of linked lists
   Node* root = nullptr;
 
-  // clean up the tree and reset count to zero given subtree root
-  void make_empty(Node* st_root);
+  // slab storage for the tree nodes
+  NodePool<Node> pool;
+
+  // clean up the tree and reset count to zero
+  void make_empty();
+
+  // run the destructors of a subtree's nodes (the pool releases
+  // their memory all at once)
+  void destroy(Node* st_root);
 
   // copy assignment helper
-  Node* copy(const Node* rhs_st_root) const;
+  Node* copy(const Node* rhs_st_root);
   
   // erase helper
   Node* erase(const K& key, Node* st_root);
 
+  // insert_or_assign and try_emplace helper, searches for the key
+  // once and either adds the pair or (if assign) replaces the value
+  bool insert_unique(const K& key, const V& value, bool assign);
+
   // find_keys helper
   void find_keys(const K& k1, const K& k2, const Node* st_root,
                  ArraySeq<K>& keys) const;
@@ -106,6 +196,10 @@ private:
   // height helper
   int height(const Node* st_root) const;
 
+  // lower_bound and upper_bound helper, positions the iterator on the
+  // first key not less than key (or greater than key if upper)
+  const_iterator bound(const K& key, bool upper) const;
+
 };
 
 
@@ -132,6 +226,7 @@ BSTMap<K,V>::BSTMap(BSTMap&& rhs)
 {
   count = rhs.count;
   root = rhs.root;
+  pool = std::move(rhs.pool);
   rhs.root = nullptr;
   rhs.count = 0;
 }
@@ -142,7 +237,7 @@ BSTMap<K,V>& BSTMap<K,V>::operator=(const BSTMap& rhs)
 {
   if (this != &rhs)
   {
-    make_empty(root);
+    make_empty();
     root = copy(rhs.root);
     count = rhs.count;
   }
@@ -155,9 +250,10 @@ BSTMap<K,V>& BSTMap<K,V>::operator=(BSTMap&& rhs)
 {
   if (this != &rhs)
   {
-    make_empty(root);
+    make_empty();
     root = rhs.root;
     count = rhs.count;
+    pool = std::move(rhs.pool);
     rhs.root = nullptr;
     rhs.count = 0;
   }
@@ -168,7 +264,7 @@ BSTMap<K,V>& BSTMap<K,V>::operator=(BSTMap&& rhs)
 template<typename K, typename V>
 BSTMap<K,V>::~BSTMap()
 {
-  make_empty(root);
+  make_empty();
   count = 0;
 }
   
@@ -236,7 +332,7 @@ void BSTMap<K,V>::insert(const K& key, const V& value)
   Node* ptr = root;
   Node* pre = root;
 
-  Node* in = new Node;
+  Node* in = pool.alloc();
   in->key = key;
   in->value = value;
   in->left = nullptr;
@@ -295,6 +391,62 @@ bool BSTMap<K,V>::contains(const K& key) const
   return false;
 }
 
+// Returns a pointer to the value for the given key, or nullptr if
+// the key is not in the collection.
+template<typename K, typename V>
+V* BSTMap<K,V>::find(const K& key)
+{
+  Node* ptr = root;
+
+  while (ptr != nullptr)
+  {
+    if (ptr->key == key)
+      return &ptr->value;
+    else if (ptr->key < key)
+      ptr = ptr->right;
+    else
+      ptr = ptr->left;
+  }
+  return nullptr;
+}
+
+// Returns a pointer to the value for the given key, or nullptr if
+// the key is not in the collection.
+template<typename K, typename V>
+const V* BSTMap<K,V>::find(const K& key) const
+{
+  Node* ptr = root;
+
+  while (ptr != nullptr)
+  {
+    if (ptr->key == key)
+      return &ptr->value;
+    else if (ptr->key < key)
+      ptr = ptr->right;
+    else
+      ptr = ptr->left;
+  }
+  return nullptr;
+}
+
+// Sets the value for the given key, adding the key-value pair if
+// the key is not in the collection. Returns true if the pair was
+// added and false if an existing value was replaced.
+template<typename K, typename V>
+bool BSTMap<K,V>::insert_or_assign(const K& key, const V& value)
+{
+  return insert_unique(key, value, true);
+}
+
+// Adds the key-value pair if the key is not in the collection and
+// otherwise leaves the existing value alone. Returns true if the
+// pair was added.
+template<typename K, typename V>
+bool BSTMap<K,V>::try_emplace(const K& key, const V& value)
+{
+  return insert_unique(key, value, false);
+}
+
 // Returns the keys k in the collection such that k1 <= k <= k2
 template<typename K, typename V>
 ArraySeq<K> BSTMap<K,V>::find_keys(const K& k1, const K& k2) const
@@ -319,31 +471,149 @@ int BSTMap<K,V>::height() const
 {
   return height(root);
 }
+
+// iterator to the smallest key
+template<typename K, typename V>
+typename BSTMap<K,V>::const_iterator BSTMap<K,V>::begin() const
+{
+  const_iterator it;
+  it.push_left(root);
+  return it;
+}
+
+// iterator to one past the largest key
+template<typename K, typename V>
+typename BSTMap<K,V>::const_iterator BSTMap<K,V>::end() const
+{
+  return const_iterator();
+}
+
+// Returns an iterator to the first key not less than the given key
+template<typename K, typename V>
+typename BSTMap<K,V>::const_iterator BSTMap<K,V>::lower_bound(const K& key) const
+{
+  return bound(key, false);
+}
+
+// Returns an iterator to the first key greater than the given key
+template<typename K, typename V>
+typename BSTMap<K,V>::const_iterator BSTMap<K,V>::upper_bound(const K& key) const
+{
+  return bound(key, true);
+}
+
+// Returns a view of the keys k such that k1 <= k <= k2
+template<typename K, typename V>
+KeyRange<typename BSTMap<K,V>::const_iterator> BSTMap<K,V>::range(const K& k1, const K& k2) const
+{
+  const_iterator first = lower_bound(k1);
+  if (k2 < k1)
+    return KeyRange<const_iterator>(first, first);
+  return KeyRange<const_iterator>(first, upper_bound(k2));
+}
+
+template<typename K, typename V>
+BSTMap<K,V>::const_iterator::const_iterator()
+{
+}
+
+template<typename K, typename V>
+const K& BSTMap<K,V>::const_iterator::operator*() const
+{
+  return stack[stack.size() - 1]->key;
+}
+
+template<typename K, typename V>
+const K* BSTMap<K,V>::const_iterator::operator->() const
+{
+  return &stack[stack.size() - 1]->key;
+}
+
+// the value for the current key
+template<typename K, typename V>
+const V& BSTMap<K,V>::const_iterator::value() const
+{
+  return stack[stack.size() - 1]->value;
+}
+
+// move to the next key
+template<typename K, typename V>
+typename BSTMap<K,V>::const_iterator& BSTMap<K,V>::const_iterator::operator++()
+{
+  // the successor is the smallest key of the right subtree, or if
+  // there is none the nearest ancestor already on the stack
+  const Node* ptr = stack[stack.size() - 1];
+  stack.erase(stack.size() - 1);
+  push_left(ptr->right);
+  return *this;
+}
+
+template<typename K, typename V>
+typename BSTMap<K,V>::const_iterator BSTMap<K,V>::const_iterator::operator++(int)
+{
+  const_iterator tmp = *this;
+  ++(*this);
+  return tmp;
+}
+
+template<typename K, typename V>
+bool BSTMap<K,V>::const_iterator::operator==(const const_iterator& rhs) const
+{
+  if (stack.empty() or rhs.stack.empty())
+    return stack.empty() == rhs.stack.empty();
+  return stack[stack.size() - 1] == rhs.stack[rhs.stack.size() - 1];
+}
+
+template<typename K, typename V>
+bool BSTMap<K,V>::const_iterator::operator!=(const const_iterator& rhs) const
+{
+  return !(*this == rhs);
+}
+
+// push st_root and its chain of left children
+template<typename K, typename V>
+void BSTMap<K,V>::const_iterator::push_left(const Node* st_root)
+{
+  while (st_root != nullptr)
+  {
+    stack.insert(st_root, stack.size());
+    st_root = st_root->left;
+  }
+}
   
-// clean up the tree and reset count to zero given subtree root
+// clean up the tree and reset count to zero
+template<typename K, typename V>
+void BSTMap<K,V>::make_empty()
+{
+  // the pool releases node memory a slab at a time, so the tree only
+  // needs walking when the nodes have destructors to run
+  if (!std::is_trivially_destructible<Node>::value)
+    destroy(root);
+  pool.clear();
+  root = nullptr;
+  count = 0;
+}
+
+// run the destructors of a subtree's nodes
 template<typename K, typename V>
-void BSTMap<K,V>::make_empty(Node* st_root)
+void BSTMap<K,V>::destroy(Node* st_root)
 {
   if (st_root != nullptr)
   {
-    make_empty(st_root->left);
-    make_empty(st_root->right);
-
-    st_root->left = nullptr;
-    st_root->right = nullptr;
-    delete st_root;
+    destroy(st_root->left);
+    destroy(st_root->right);
+    st_root->~Node();
   }
-  return;
 }
 
 // copy assignment helper
 template<typename K, typename V>
-typename BSTMap<K,V>::Node* BSTMap<K,V>::copy(const Node* rhs_st_root) const
+typename BSTMap<K,V>::Node* BSTMap<K,V>::copy(const Node* rhs_st_root)
 {
   Node* cpy = nullptr;
   if (rhs_st_root != nullptr)
   {
-    cpy = new Node;
+    cpy = pool.alloc();
     cpy->key = rhs_st_root->key;
     cpy->value = rhs_st_root->value;
 
@@ -370,7 +640,7 @@ typename BSTMap<K,V>::Node* BSTMap<K,V>::erase(const K& key, Node* st_root)
       Node* tmp = st_root;
       st_root = st_root->right;
       count--;
-      delete tmp;
+      pool.free(tmp);
       return st_root;
     }
     // case 2: right subtree is empty
@@ -379,7 +649,7 @@ typename BSTMap<K,V>::Node* BSTMap<K,V>::erase(const K& key, Node* st_root)
       Node* tmp = st_root;
       st_root = st_root->left;
       count--;
-      delete tmp;
+      pool.free(tmp);
       return st_root;
     }
     // case 3: inorder successor
@@ -394,13 +664,14 @@ typename BSTMap<K,V>::Node* BSTMap<K,V>::erase(const K& key, Node* st_root)
         succ = succ->left;
       }
       st_root->key = succ->key;
+      st_root->value = succ->value;
       if(pre != st_root)
         pre->left = succ->right;
       else if (pre == st_root)
       {
         pre->right = succ->right;
       }
-      delete succ;
+      pool.free(succ);
       count--;
       return st_root;
     }
@@ -409,6 +680,44 @@ typename BSTMap<K,V>::Node* BSTMap<K,V>::erase(const K& key, Node* st_root)
   return st_root;
 }
 
+// insert_or_assign and try_emplace helper
+template<typename K, typename V>
+bool BSTMap<K,V>::insert_unique(const K& key, const V& value, bool assign)
+{
+  Node* ptr = root;
+  Node* pre = nullptr;
+
+  while (ptr != nullptr)
+  {
+    if (ptr->key == key)
+    {
+      if (assign)
+        ptr->value = value;
+      return false;
+    }
+    pre = ptr;
+    if (key > ptr->key)
+      ptr = ptr->right;
+    else
+      ptr = ptr->left;
+  }
+
+  Node* in = pool.alloc();
+  in->key = key;
+  in->value = value;
+  in->left = nullptr;
+  in->right = nullptr;
+
+  if (pre == nullptr)
+    root = in;
+  else if (pre->key > key)
+    pre->left = in;
+  else
+    pre->right = in;
+  count++;
+  return true;
+}
+
 // find_keys helper
 template<typename K, typename V>
 void BSTMap<K,V>::find_keys(const K& k1, const K& k2, const Node* st_root, ArraySeq<K>& keys) const
@@ -417,13 +726,16 @@ void BSTMap<K,V>::find_keys(const K& k1, const K& k2, const Node* st_root, Array
   if (st_root == nullptr)
     return;
 
-  find_keys(k1, k2, st_root->left, keys);
+  // only subtrees that can hold keys in [k1, k2] are visited, so the
+  // walk follows the paths to k1 and k2 plus the keys in between
+  if (k1 < st_root->key)
+    find_keys(k1, k2, st_root->left, keys);
 
   if (st_root->key >= k1 and st_root->key <= k2)
     keys.insert(st_root->key, keys.size());
-  
-  find_keys(k1, k2, st_root->right, keys);
-  return;
+
+  if (st_root->key < k2)
+    find_keys(k1, k2, st_root->right, keys);
 }
 
 // sorted_keys helper
@@ -439,6 +751,27 @@ void BSTMap<K,V>::sorted_keys(const Node* st_root, ArraySeq<K>& keys) const
   return;
 }
 
+// lower_bound and upper_bound helper
+template<typename K, typename V>
+typename BSTMap<K,V>::const_iterator BSTMap<K,V>::bound(const K& key, bool upper) const
+{
+  // keep exactly the nodes an in-order walk from the bound would
+  // still visit on the way back up: those where the search went left
+  const_iterator it;
+  const Node* ptr = root;
+  while (ptr != nullptr)
+  {
+    if (ptr->key < key or (upper and ptr->key == key))
+      ptr = ptr->right;
+    else
+    {
+      it.stack.insert(ptr, it.stack.size());
+      ptr = ptr->left;
+    }
+  }
+  return it;
+}
+
 // height helper
 template<typename K, typename V>
 int BSTMap<K,V>::height(const Node* st_root) const
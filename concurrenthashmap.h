@@ -0,0 +1,457 @@
+//---------------------------------------------------------------------------
+// NAME: Adam Huonder
+// DATE: Fall 2021
+// DESC: Implements a thread-safe separate chaining hash map with
+//       lock striping and a resize that moves each stripe
+//       incrementally during later updates to it
+//---------------------------------------------------------------------------
+
+#ifndef CONCURRENTHASHMAP_H
+#define CONCURRENTHASHMAP_H
+
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <shared_mutex>
+#include <stdexcept>
+#include <type_traits>
+#include "hashmap.h"
+#include "nodepool.h"
+
+//{{{ Header
+// Buckets are split into STRIPES groups by the low bits of the hash,
+// and each group (stripe) has its own reader/writer lock. Lookups take
+// a stripe's lock shared, updates take it exclusive, so threads only
+// contend when they touch the same stripe. Values are returned by
+// copy since a reference could be invalidated by another thread.
+template<typename K, typename V, typename Hash = std::hash<K>>
+class ConcurrentHashMap
+{
+public:
+
+  // default constructor
+  ConcurrentHashMap();
+
+  // the map is shared between threads and is not copied or moved
+  ConcurrentHashMap(const ConcurrentHashMap& rhs) = delete;
+  ConcurrentHashMap& operator=(const ConcurrentHashMap& rhs) = delete;
+
+  // destructor
+  ~ConcurrentHashMap();
+
+  // Returns the number of key-value pairs in the map
+  int size() const;
+
+  // Tests if the map is empty
+  bool empty() const;
+
+  // Copies the value for the given key into value and returns true,
+  // or returns false if the key is not in the collection.
+  bool find(const K& key, V& value) const;
+
+  // Returns true if the key is in the collection, and false otherwise.
+  bool contains(const K& key) const;
+
+  // Extends the collection by adding the given key-value
+  // pair. Assumes the key being added is not present in the
+  // collection. Insert does not check if the key is present.
+  void insert(const K& key, const V& value);
+
+  // Sets the value for the given key, adding the key-value pair if
+  // the key is not in the collection. Returns true if the pair was
+  // added and false if an existing value was replaced.
+  bool insert_or_assign(const K& key, const V& value);
+
+  // Adds the key-value pair if the key is not in the collection and
+  // otherwise leaves the existing value alone. Returns true if the
+  // pair was added.
+  bool try_emplace(const K& key, const V& value);
+
+  // Shrinks the collection by removing the key-value pair with the
+  // given key. Throws out_of_range if the given key is not in the
+  // collection.
+  void erase(const K& key);
+
+private:
+
+  // node for linked-list separate chaining
+  struct Node {
+    K key;
+    V value;
+    Node* next;
+  };
+
+  // array of linked lists
+  struct Table {
+    Node** buckets;
+    int capacity;
+  };
+
+  // number of stripes, a power of two no larger than the initial
+  // capacity so every bucket of a stripe keeps the same stripe (the
+  // low bits of its index) as the table doubles
+  static const int STRIPES = 64;
+
+  // a lock, the table its buckets currently live in, and the pool
+  // its nodes come from. During a resize, next is the table the
+  // stripe is being moved into, and the stripe's first
+  // migrate_index buckets in table are already there. Padded to a
+  // cache line so neighboring stripe locks do not false share.
+  struct alignas(64) Stripe {
+    mutable std::shared_mutex lock;
+    Table* table = nullptr;
+    Table* next = nullptr;
+    int migrate_index = 0;
+    NodePool<Node> pool;
+  };
+
+  // threshold for resize and rehash
+  const double load_factor_threshold = 0.75;
+
+  // number of a stripe's old buckets moved by each update to it
+  const int migrate_step = 4;
+
+  // number of key-value pairs in map
+  std::atomic<int> count;
+
+  // current table size, read without a lock to check the load
+  std::atomic<int> capacity;
+
+  // held by the one thread doing a resize
+  std::mutex resize_lock;
+
+  // the newest table, and the one before it that stripes may still
+  // be moving out of (only used by the resizing thread)
+  Table* current = nullptr;
+  Table* previous = nullptr;
+
+  // the stripes
+  Stripe stripes[STRIPES];
+
+  // the user supplied hasher
+  Hash hasher;
+
+  // the hash function (hasher output run through mix_hash)
+  std::size_t hash(const K& key) const;
+
+  // insert_or_assign and try_emplace helper, searches for the key
+  // once and either adds the pair or (if assign) replaces the value
+  bool insert_unique(const K& key, const V& value, bool assign);
+
+  // the head of the chain holding the hash, in the stripe's table or
+  // (if that bucket was already moved) in its next table. The
+  // caller holds the stripe's lock.
+  Node** bucket(const Stripe& stripe, std::size_t h) const;
+
+  // move up to the given number of the stripe's buckets into its
+  // next table. The caller holds the stripe's lock exclusive.
+  void migrate(Stripe& stripe, int buckets);
+
+  // grow the table if the load factor is over the threshold
+  void resize_and_rehash();
+};
+//}}}
+
+//{{{ public functions
+// default constructor
+template<typename K, typename V, typename Hash>
+ConcurrentHashMap<K,V,Hash>::ConcurrentHashMap()
+  : count(0), capacity(STRIPES)
+{
+  current = new Table;
+  current->capacity = STRIPES;
+  current->buckets = new Node*[STRIPES];
+  for (int i = 0; i < STRIPES; ++i)
+  {
+    current->buckets[i] = nullptr;
+    stripes[i].table = current;
+  }
+}
+
+// destructor
+template<typename K, typename V, typename Hash>
+ConcurrentHashMap<K,V,Hash>::~ConcurrentHashMap()
+{
+  for (int s = 0; s < STRIPES; ++s)
+    migrate(stripes[s], current->capacity);
+  if (!std::is_trivially_destructible<Node>::value)
+  {
+    for (int i = 0; i < current->capacity; ++i)
+    {
+      Node* del = current->buckets[i];
+      while (del != nullptr)
+      {
+        Node* next = del->next;
+        del->~Node();
+        del = next;
+      }
+    }
+  }
+  for (int s = 0; s < STRIPES; ++s)
+    stripes[s].pool.clear();
+  if (previous != nullptr)
+  {
+    delete[] previous->buckets;
+    delete previous;
+  }
+  delete[] current->buckets;
+  delete current;
+}
+
+// Returns the number of key-value pairs in the map
+template<typename K, typename V, typename Hash>
+int ConcurrentHashMap<K,V,Hash>::size() const
+{
+  return count.load();
+}
+
+// Tests if the map is empty
+template<typename K, typename V, typename Hash>
+bool ConcurrentHashMap<K,V,Hash>::empty() const
+{
+  return count.load() == 0;
+}
+
+// Copies the value for the given key into value and returns true,
+// or returns false if the key is not in the collection.
+template<typename K, typename V, typename Hash>
+bool ConcurrentHashMap<K,V,Hash>::find(const K& key, V& value) const
+{
+  std::size_t h = hash(key);
+  const Stripe& stripe = stripes[h & (STRIPES - 1)];
+  std::shared_lock<std::shared_mutex> guard(stripe.lock);
+  Node* tmp = *bucket(stripe, h);
+  while (tmp != nullptr)
+  {
+    if (tmp->key == key)
+    {
+      value = tmp->value;
+      return true;
+    }
+    tmp = tmp->next;
+  }
+  return false;
+}
+
+// Returns true if the key is in the collection, and false otherwise.
+template<typename K, typename V, typename Hash>
+bool ConcurrentHashMap<K,V,Hash>::contains(const K& key) const
+{
+  std::size_t h = hash(key);
+  const Stripe& stripe = stripes[h & (STRIPES - 1)];
+  std::shared_lock<std::shared_mutex> guard(stripe.lock);
+  Node* tmp = *bucket(stripe, h);
+  while (tmp != nullptr)
+  {
+    if (tmp->key == key)
+      return true;
+    tmp = tmp->next;
+  }
+  return false;
+}
+
+// Extends the collection by adding the given key-value
+// pair. Assumes the key being added is not present in the
+// collection. Insert does not check if the key is present.
+template<typename K, typename V, typename Hash>
+void ConcurrentHashMap<K,V,Hash>::insert(const K& key, const V& value)
+{
+  std::size_t h = hash(key);
+  Stripe& stripe = stripes[h & (STRIPES - 1)];
+  {
+    std::unique_lock<std::shared_mutex> guard(stripe.lock);
+    migrate(stripe, migrate_step);
+    Node* in = stripe.pool.alloc();
+    in->key = key;
+    in->value = value;
+    Node*& head = *bucket(stripe, h);
+    in->next = head;
+    head = in;
+  }
+  count++;
+  resize_and_rehash();
+}
+
+// Sets the value for the given key, adding the key-value pair if
+// the key is not in the collection. Returns true if the pair was
+// added and false if an existing value was replaced.
+template<typename K, typename V, typename Hash>
+bool ConcurrentHashMap<K,V,Hash>::insert_or_assign(const K& key, const V& value)
+{
+  return insert_unique(key, value, true);
+}
+
+// Adds the key-value pair if the key is not in the collection and
+// otherwise leaves the existing value alone. Returns true if the
+// pair was added.
+template<typename K, typename V, typename Hash>
+bool ConcurrentHashMap<K,V,Hash>::try_emplace(const K& key, const V& value)
+{
+  return insert_unique(key, value, false);
+}
+
+// Shrinks the collection by removing the key-value pair with the
+// given key. Throws out_of_range if the given key is not in the
+// collection.
+template<typename K, typename V, typename Hash>
+void ConcurrentHashMap<K,V,Hash>::erase(const K& key)
+{
+  std::size_t h = hash(key);
+  Stripe& stripe = stripes[h & (STRIPES - 1)];
+  std::unique_lock<std::shared_mutex> guard(stripe.lock);
+  migrate(stripe, migrate_step);
+  Node** link = bucket(stripe, h);
+  while (*link != nullptr)
+  {
+    if ((*link)->key == key)
+    {
+      Node* del = *link;
+      *link = del->next;
+      stripe.pool.free(del);
+      count--;
+      return;
+    }
+    link = &(*link)->next;
+  }
+  throw std::out_of_range("void ConcurrentHashMap<K,V,Hash>::erase(const K& key). Key does not exist.");
+}
+//}}}
+
+//{{{ private functions
+// the hash function
+template<typename K, typename V, typename Hash>
+std::size_t ConcurrentHashMap<K,V,Hash>::hash(const K& key) const
+{
+  return mix_hash(hasher(key));
+}
+
+// insert_or_assign and try_emplace helper
+template<typename K, typename V, typename Hash>
+bool ConcurrentHashMap<K,V,Hash>::insert_unique(const K& key, const V& value, bool assign)
+{
+  std::size_t h = hash(key);
+  Stripe& stripe = stripes[h & (STRIPES - 1)];
+  {
+    std::unique_lock<std::shared_mutex> guard(stripe.lock);
+    migrate(stripe, migrate_step);
+    Node*& head = *bucket(stripe, h);
+    Node* tmp = head;
+    while (tmp != nullptr)
+    {
+      if (tmp->key == key)
+      {
+        if (assign)
+          tmp->value = value;
+        return false;
+      }
+      tmp = tmp->next;
+    }
+    Node* in = stripe.pool.alloc();
+    in->key = key;
+    in->value = value;
+    in->next = head;
+    head = in;
+  }
+  count++;
+  resize_and_rehash();
+  return true;
+}
+
+// the head of the chain holding the hash
+template<typename K, typename V, typename Hash>
+typename ConcurrentHashMap<K,V,Hash>::Node**
+ConcurrentHashMap<K,V,Hash>::bucket(const Stripe& stripe, std::size_t h) const
+{
+  // a stripe's buckets are s, s + STRIPES, s + 2 * STRIPES, ... so
+  // bucket b is the stripe's (b / STRIPES)-th
+  int b = h & (stripe.table->capacity - 1);
+  if (stripe.next != nullptr and b / STRIPES < stripe.migrate_index)
+    return &stripe.next->buckets[h & (stripe.next->capacity - 1)];
+  return &stripe.table->buckets[b];
+}
+
+// move up to the given number of the stripe's buckets into its next table
+template<typename K, typename V, typename Hash>
+void ConcurrentHashMap<K,V,Hash>::migrate(Stripe& stripe, int buckets)
+{
+  if (stripe.next == nullptr)
+    return;
+  Table* old = stripe.table;
+  Table* next = stripe.next;
+  int stripe_buckets = old->capacity / STRIPES;
+  int s = &stripe - stripes;
+  while (buckets > 0 and stripe.migrate_index < stripe_buckets)
+  {
+    // bucket b only splits into buckets b and b + old capacity,
+    // which are in the same stripe
+    int b = s + stripe.migrate_index * STRIPES;
+    while (old->buckets[b] != nullptr)
+    {
+      Node* tmp = old->buckets[b];
+      old->buckets[b] = tmp->next;
+      Node*& head = next->buckets[hash(tmp->key) & (next->capacity - 1)];
+      tmp->next = head;
+      head = tmp;
+    }
+    stripe.migrate_index++;
+    buckets--;
+  }
+  if (stripe.migrate_index == stripe_buckets)
+  {
+    stripe.table = next;
+    stripe.next = nullptr;
+    stripe.migrate_index = 0;
+  }
+}
+
+// grow the table if the load factor is over the threshold
+template<typename K, typename V, typename Hash>
+void ConcurrentHashMap<K,V,Hash>::resize_and_rehash()
+{
+  if (count.load() < load_factor_threshold * capacity.load())
+    return;
+
+  // only one thread resizes, everyone else keeps going
+  std::unique_lock<std::mutex> resizing(resize_lock, std::try_to_lock);
+  if (!resizing.owns_lock() or count.load() < load_factor_threshold * capacity.load())
+    return;
+
+  // Stripes move into the new table a few buckets at a time as they
+  // are updated, the way HashMap's incremental mode drains its old
+  // table, so no single insert pays for the whole rehash. A stripe
+  // still moving out of the previous table (one that saw almost no
+  // updates since the last resize) is finished here before the
+  // previous table is freed; no stripe points at it after that.
+  if (previous != nullptr)
+  {
+    for (int s = 0; s < STRIPES; ++s)
+    {
+      std::unique_lock<std::shared_mutex> guard(stripes[s].lock);
+      migrate(stripes[s], previous->capacity);
+    }
+    delete[] previous->buckets;
+    delete previous;
+  }
+
+  Table* next = new Table;
+  next->capacity = current->capacity * 2;
+  next->buckets = new Node*[next->capacity];
+  for (int i = 0; i < next->capacity; ++i)
+    next->buckets[i] = nullptr;
+
+  // start every stripe moving, each stays readable and writable in
+  // both tables until it is done
+  for (int s = 0; s < STRIPES; ++s)
+  {
+    std::unique_lock<std::shared_mutex> guard(stripes[s].lock);
+    stripes[s].next = next;
+    stripes[s].migrate_index = 0;
+  }
+
+  previous = current;
+  current = next;
+  capacity.store(next->capacity);
+}
+//}}}
+
+#endif
@@ -0,0 +1,113 @@
+//---------------------------------------------------------------------------
+// NAME: Adam Huonder
+// FILE: concurrenthashmap_bench.cpp
+// DATE: Fall 2021
+// DESC: compares ConcurrentHashMap's striped locks against a HashMap
+//       behind one global mutex on a read/write mix at 1, 2, 4, 8, ...
+//       threads
+//
+//       g++ -std=c++17 -O2 -pthread concurrenthashmap_bench.cpp -o concurrenthashmap_bench
+//       ./concurrenthashmap_bench [ops per thread] [max threads] [write percent]
+//---------------------------------------------------------------------------
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include "concurrenthashmap.h"
+#include "hashmap.h"
+
+using namespace std;
+
+
+// milliseconds since start
+double elapsed_ms(chrono::steady_clock::time_point start)
+{
+  chrono::duration<double, milli> d = chrono::steady_clock::now() - start;
+  return d.count();
+}
+
+// the baseline, every call takes the one lock
+struct LockedHashMap {
+  mutable mutex lock;
+  HashMap<int,int> map;
+  bool contains(int key) const
+  {
+    lock_guard<mutex> guard(lock);
+    return map.contains(key);
+  }
+  bool insert_or_assign(int key, int value)
+  {
+    lock_guard<mutex> guard(lock);
+    return map.insert_or_assign(key, value);
+  }
+};
+
+// each thread runs ops random operations over a shared key range,
+// write_percent of them insert_or_assign and the rest contains.
+// Returns the wall time for all threads and adds the number of
+// reads that hit to found.
+template<typename M>
+double run(int threads, int ops, int write_percent, long& found)
+{
+  // keys drawn from twice the number of writes, so reads hit about
+  // half the time once the map fills
+  const int key_range = 2 * threads * (ops / 100 * write_percent + 1);
+  M map;
+  atomic<long> hits(0);
+  ArraySeq<thread*> workers;
+  auto start = chrono::steady_clock::now();
+  for (int t = 0; t < threads; ++t)
+  {
+    thread* worker = new thread([&map, &hits, t, ops, write_percent, key_range]() {
+      mt19937 gen(t + 1);
+      long thread_hits = 0;
+      for (int i = 0; i < ops; ++i)
+      {
+        int key = gen() % key_range;
+        if (int(gen() % 100) < write_percent)
+          map.insert_or_assign(key, i);
+        else
+          thread_hits += map.contains(key);
+      }
+      hits += thread_hits;
+    });
+    workers.insert(worker, t);
+  }
+  for (int t = 0; t < workers.size(); ++t)
+  {
+    workers[t]->join();
+    delete workers[t];
+  }
+  found += hits.load();
+  return elapsed_ms(start);
+}
+
+int main(int argc, char* argv[])
+{
+  int ops = 1000000;
+  int max_threads = 8;
+  int write_percent = 10;
+  if (argc > 1)
+    ops = atoi(argv[1]);
+  if (argc > 2)
+    max_threads = atoi(argv[2]);
+  if (argc > 3)
+    write_percent = atoi(argv[3]);
+
+  cout << ops << " ops per thread, " << write_percent << "% writes, "
+       << thread::hardware_concurrency() << " hardware threads" << endl;
+  for (int threads = 1; threads <= max_threads; threads *= 2)
+  {
+    long found = 0;
+    double locked_ms = run<LockedHashMap>(threads, ops, write_percent, found);
+    double striped_ms = run<ConcurrentHashMap<int,int>>(threads, ops, write_percent, found);
+    cout << threads << " threads: HashMap + mutex " << locked_ms
+         << " ms, ConcurrentHashMap " << striped_ms << " ms (" << found
+         << " found)" << endl;
+  }
+}
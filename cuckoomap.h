@@ -0,0 +1,616 @@
+//---------------------------------------------------------------------------
+// NAME: Adam Huonder
+// DATE: Fall 2021
+// DESC: Implements a bucketized cuckoo hash map (two candidate
+//       buckets of four slots per key, plus a small overflow stash)
+//---------------------------------------------------------------------------
+
+#ifndef CUCKOOMAP_H
+#define CUCKOOMAP_H
+
+#include <functional>
+#include <stdexcept>
+#include <utility>
+#include "map.h"
+#include "arrayseq.h"
+#include "hashmap.h"
+
+//{{{ Header
+template<typename K, typename V, typename Hash = std::hash<K>>
+class CuckooMap : public Map<K,V>
+{
+public:
+
+  // default constructor
+  CuckooMap();
+
+  // copy constructor
+  CuckooMap(const CuckooMap& rhs);
+
+  // move constructor
+  CuckooMap(CuckooMap&& rhs);
+
+  // copy assignment
+  CuckooMap& operator=(const CuckooMap& rhs);
+
+  // move assignment
+  CuckooMap& operator=(CuckooMap&& rhs);
+
+  // destructor
+  ~CuckooMap();
+
+  // Returns the number of key-value pairs in the map
+  int size() const;
+
+  // Tests if the map is empty
+  bool empty() const;
+
+  // Allows values associated with a key to be updated. Throws
+  // out_of_range if the given key is not in the collection.
+  V& operator[](const K& key);
+
+  // Returns the value for a given key. Throws out_of_range if the
+  // given key is not in the collection.
+  const V& operator[](const K& key) const;
+
+  // Extends the collection by adding the given key-value
+  // pair. Assumes the key being added is not present in the
+  // collection. Insert does not check if the key is present.
+  void insert(const K& key, const V& value);
+
+  // Shrinks the collection by removing the key-value pair with the
+  // given key. Does not modify the collection if the collection does
+  // not contain the key. Throws out_of_range if the given key is not
+  // in the collection.
+  void erase(const K& key);
+
+  // Returns true if the key is in the collection, and false otherwise.
+  bool contains(const K& key) const;
+
+  // Returns a pointer to the value for the given key, or nullptr if
+  // the key is not in the collection.
+  V* find(const K& key);
+  const V* find(const K& key) const;
+
+  // Sets the value for the given key, adding the key-value pair if
+  // the key is not in the collection. Returns true if the pair was
+  // added and false if an existing value was replaced.
+  bool insert_or_assign(const K& key, const V& value);
+
+  // Adds the key-value pair if the key is not in the collection and
+  // otherwise leaves the existing value alone. Returns true if the
+  // pair was added.
+  bool try_emplace(const K& key, const V& value);
+
+  // Returns the keys k in the collection such that k1 <= k <= k2
+  ArraySeq<K> find_keys(const K& k1, const K& k2) const;
+
+  // Returns the keys in the collection in ascending sorted order
+  ArraySeq<K> sorted_keys() const;
+
+  // statistics functions for the cuckoo table implementation
+  // (fraction of slots in use, total displacements performed by
+  // inserts, and pairs currently held in the stash)
+  double occupancy() const;
+  long kick_count() const;
+  int stash_size() const;
+
+private:
+
+  // slots per bucket
+  static const int SLOTS = 4;
+
+  // displacements tried before an insert gives up and uses the stash
+  static const int MAX_KICKS = 500;
+
+  // pairs the stash may hold before the table is grown
+  static const int MAX_STASH = 8;
+
+  // a bucket of SLOTS inline key-value pairs. used has bit i set if
+  // slot i holds a pair.
+  struct Bucket {
+    K keys[SLOTS];
+    V values[SLOTS];
+    unsigned char used = 0;
+  };
+
+  // number of key-value pairs in map
+  int count = 0;
+
+  // number of buckets, always a power of two
+  int capacity = 4;
+
+  // grow once this fraction of the slots is in use
+  const double load_factor_threshold = 0.9;
+
+  // array of buckets
+  Bucket* table = nullptr;
+
+  // pairs that could not be placed in either of their buckets
+  ArraySeq<std::pair<K,V>> stash;
+
+  // total displacements performed by inserts
+  long kicks = 0;
+
+  // the user supplied hasher
+  Hash hasher;
+
+  // the hash function (hasher output run through mix_hash)
+  std::size_t hash(const K& key) const;
+
+  // the two candidate buckets for a hash value
+  int first_bucket(std::size_t h) const;
+  int second_bucket(std::size_t h) const;
+
+  // finds the key, setting bucket and slot (slot is the stash index
+  // and bucket is -1 if it is in the stash). Returns false if the
+  // key is not in the collection.
+  bool locate(const K& key, int& bucket, int& slot) const;
+
+  // insert_or_assign and try_emplace helper, searches for the key
+  // once and either adds the pair or (if assign) replaces the value
+  bool insert_unique(const K& key, const V& value, bool assign);
+
+  // places the pair (whose key has hash h), displacing residents as
+  // needed. A pair left over after MAX_KICKS displacements goes into
+  // the stash.
+  void place(K key, V value, std::size_t h);
+
+  // double the number of buckets and reinsert every pair
+  void resize_and_rehash();
+};
+//}}}
+
+//{{{ public functions / essential operators
+// default constructor
+template<typename K, typename V, typename Hash>
+CuckooMap<K,V,Hash>::CuckooMap()
+{
+  table = new Bucket[capacity];
+}
+
+// copy constructor
+template<typename K, typename V, typename Hash>
+CuckooMap<K,V,Hash>::CuckooMap(const CuckooMap& rhs)
+{
+  count = rhs.count;
+  capacity = rhs.capacity;
+  kicks = rhs.kicks;
+  hasher = rhs.hasher;
+  stash = rhs.stash;
+  table = new Bucket[capacity];
+  for (int i = 0; i < capacity; ++i)
+    table[i] = rhs.table[i];
+}
+
+// move constructor
+template<typename K, typename V, typename Hash>
+CuckooMap<K,V,Hash>::CuckooMap(CuckooMap&& rhs)
+{
+  count = rhs.count;
+  capacity = rhs.capacity;
+  kicks = rhs.kicks;
+  hasher = rhs.hasher;
+  stash = std::move(rhs.stash);
+  table = rhs.table;
+  rhs.count = 0;
+  rhs.capacity = 4;
+  rhs.kicks = 0;
+  rhs.table = new Bucket[rhs.capacity];
+}
+
+// copy assignment
+template<typename K, typename V, typename Hash>
+CuckooMap<K,V,Hash>& CuckooMap<K,V,Hash>::operator=(const CuckooMap& rhs)
+{
+  if (this != &rhs)
+  {
+    delete[] table;
+    count = rhs.count;
+    capacity = rhs.capacity;
+    kicks = rhs.kicks;
+    hasher = rhs.hasher;
+    stash = rhs.stash;
+    table = new Bucket[capacity];
+    for (int i = 0; i < capacity; ++i)
+      table[i] = rhs.table[i];
+  }
+  return *this;
+}
+
+// move assignment
+template<typename K, typename V, typename Hash>
+CuckooMap<K,V,Hash>& CuckooMap<K,V,Hash>::operator=(CuckooMap&& rhs)
+{
+  if (this != &rhs)
+  {
+    delete[] table;
+    count = rhs.count;
+    capacity = rhs.capacity;
+    kicks = rhs.kicks;
+    hasher = rhs.hasher;
+    stash = std::move(rhs.stash);
+    table = rhs.table;
+    rhs.count = 0;
+    rhs.capacity = 4;
+    rhs.kicks = 0;
+    rhs.table = new Bucket[rhs.capacity];
+  }
+  return *this;
+}
+
+// destructor
+template<typename K, typename V, typename Hash>
+CuckooMap<K,V,Hash>::~CuckooMap()
+{
+  delete[] table;
+}
+
+// Returns the number of key-value pairs in the map
+template<typename K, typename V, typename Hash>
+int CuckooMap<K,V,Hash>::size() const
+{
+  return count;
+}
+
+// Tests if the map is empty
+template<typename K, typename V, typename Hash>
+bool CuckooMap<K,V,Hash>::empty() const
+{
+  return count == 0;
+}
+
+// Allows values associated with a key to be updated. Throws
+// out_of_range if the given key is not in the collection.
+template<typename K, typename V, typename Hash>
+V& CuckooMap<K,V,Hash>::operator[](const K& key)
+{
+  V* value = find(key);
+  if (value == nullptr)
+    throw std::out_of_range("V& CuckooMap<K,V,Hash>::operator[](const K& key). Key does not exist.");
+  return *value;
+}
+
+// Returns the value for a given key. Throws out_of_range if the
+// given key is not in the collection.
+template<typename K, typename V, typename Hash>
+const V& CuckooMap<K,V,Hash>::operator[](const K& key) const
+{
+  const V* value = find(key);
+  if (value == nullptr)
+    throw std::out_of_range("const V& CuckooMap<K,V,Hash>::operator[](const K& key) const. Key does not exist.");
+  return *value;
+}
+
+// Extends the collection by adding the given key-value
+// pair. Assumes the key being added is not present in the
+// collection. Insert does not check if the key is present.
+template<typename K, typename V, typename Hash>
+void CuckooMap<K,V,Hash>::insert(const K& key, const V& value)
+{
+  if ((count + 1) * 1.0 > capacity * SLOTS * load_factor_threshold)
+    resize_and_rehash();
+  place(key, value, hash(key));
+  count++;
+  while (stash.size() > MAX_STASH)
+    resize_and_rehash();
+}
+
+// Shrinks the collection by removing the key-value pair with the
+// given key. Does not modify the collection if the collection does
+// not contain the key. Throws out_of_range if the given key is not
+// in the collection.
+template<typename K, typename V, typename Hash>
+void CuckooMap<K,V,Hash>::erase(const K& key)
+{
+  int bucket = -1;
+  int slot = -1;
+  if (!locate(key, bucket, slot))
+    throw std::out_of_range("void CuckooMap<K,V,Hash>::erase(const K& key). Key does not exist.");
+
+  if (bucket == -1)
+    stash.erase(slot);
+  else
+  {
+    table[bucket].used &= ~(1 << slot);
+    table[bucket].keys[slot] = K();
+    table[bucket].values[slot] = V();
+  }
+  count--;
+}
+
+// Returns true if the key is in the collection, and false otherwise.
+template<typename K, typename V, typename Hash>
+bool CuckooMap<K,V,Hash>::contains(const K& key) const
+{
+  int bucket = -1;
+  int slot = -1;
+  return locate(key, bucket, slot);
+}
+
+// Returns a pointer to the value for the given key, or nullptr if
+// the key is not in the collection.
+template<typename K, typename V, typename Hash>
+V* CuckooMap<K,V,Hash>::find(const K& key)
+{
+  int bucket = -1;
+  int slot = -1;
+  if (!locate(key, bucket, slot))
+    return nullptr;
+  if (bucket == -1)
+    return &stash[slot].second;
+  return &table[bucket].values[slot];
+}
+
+// Returns a pointer to the value for the given key, or nullptr if
+// the key is not in the collection.
+template<typename K, typename V, typename Hash>
+const V* CuckooMap<K,V,Hash>::find(const K& key) const
+{
+  int bucket = -1;
+  int slot = -1;
+  if (!locate(key, bucket, slot))
+    return nullptr;
+  if (bucket == -1)
+    return &stash[slot].second;
+  return &table[bucket].values[slot];
+}
+
+// Sets the value for the given key, adding the key-value pair if
+// the key is not in the collection. Returns true if the pair was
+// added and false if an existing value was replaced.
+template<typename K, typename V, typename Hash>
+bool CuckooMap<K,V,Hash>::insert_or_assign(const K& key, const V& value)
+{
+  return insert_unique(key, value, true);
+}
+
+// Adds the key-value pair if the key is not in the collection and
+// otherwise leaves the existing value alone. Returns true if the
+// pair was added.
+template<typename K, typename V, typename Hash>
+bool CuckooMap<K,V,Hash>::try_emplace(const K& key, const V& value)
+{
+  return insert_unique(key, value, false);
+}
+
+// Returns the keys k in the collection such that k1 <= k <= k2
+template<typename K, typename V, typename Hash>
+ArraySeq<K> CuckooMap<K,V,Hash>::find_keys(const K& k1, const K& k2) const
+{
+  ArraySeq<K> keys;
+  for (int i = 0; i < capacity; ++i)
+  {
+    for (int j = 0; j < SLOTS; ++j)
+    {
+      const K& key = table[i].keys[j];
+      if ((table[i].used & (1 << j)) and key >= k1 and key <= k2)
+        keys.insert(key, keys.size());
+    }
+  }
+  for (int i = 0; i < stash.size(); ++i)
+  {
+    if (stash[i].first >= k1 and stash[i].first <= k2)
+      keys.insert(stash[i].first, keys.size());
+  }
+  return keys;
+}
+
+// Returns the keys in the collection in ascending sorted order
+template<typename K, typename V, typename Hash>
+ArraySeq<K> CuckooMap<K,V,Hash>::sorted_keys() const
+{
+  ArraySeq<K> keys;
+  for (int i = 0; i < capacity; ++i)
+  {
+    for (int j = 0; j < SLOTS; ++j)
+    {
+      if (table[i].used & (1 << j))
+        keys.insert(table[i].keys[j], keys.size());
+    }
+  }
+  for (int i = 0; i < stash.size(); ++i)
+    keys.insert(stash[i].first, keys.size());
+  keys.sort();
+  return keys;
+}
+//}}}
+
+//{{{ statistics functions for the cuckoo table implementation
+template<typename K, typename V, typename Hash>
+double CuckooMap<K,V,Hash>::occupancy() const
+{
+  return ((count - stash.size()) * 1.0) / (capacity * SLOTS * 1.0);
+}
+
+template<typename K, typename V, typename Hash>
+long CuckooMap<K,V,Hash>::kick_count() const
+{
+  return kicks;
+}
+
+template<typename K, typename V, typename Hash>
+int CuckooMap<K,V,Hash>::stash_size() const
+{
+  return stash.size();
+}
+//}}}
+
+//{{{ private functions
+// the hash function
+template<typename K, typename V, typename Hash>
+std::size_t CuckooMap<K,V,Hash>::hash(const K& key) const
+{
+  return mix_hash(hasher(key));
+}
+
+// the first candidate bucket (low bits of the hash)
+template<typename K, typename V, typename Hash>
+int CuckooMap<K,V,Hash>::first_bucket(std::size_t h) const
+{
+  return h & (capacity - 1);
+}
+
+// the second candidate bucket (high bits of the hash, so the two
+// choices are independent)
+template<typename K, typename V, typename Hash>
+int CuckooMap<K,V,Hash>::second_bucket(std::size_t h) const
+{
+  return (h >> 32) & (capacity - 1);
+}
+
+// finds the key, setting bucket and slot
+template<typename K, typename V, typename Hash>
+bool CuckooMap<K,V,Hash>::locate(const K& key, int& bucket, int& slot) const
+{
+  std::size_t h = hash(key);
+  int candidates[2] = {first_bucket(h), second_bucket(h)};
+  for (int c = 0; c < 2; ++c)
+  {
+    const Bucket& b = table[candidates[c]];
+    for (int j = 0; j < SLOTS; ++j)
+    {
+      if ((b.used & (1 << j)) and b.keys[j] == key)
+      {
+        bucket = candidates[c];
+        slot = j;
+        return true;
+      }
+    }
+  }
+  for (int i = 0; i < stash.size(); ++i)
+  {
+    if (stash[i].first == key)
+    {
+      bucket = -1;
+      slot = i;
+      return true;
+    }
+  }
+  return false;
+}
+
+// insert_or_assign and try_emplace helper, probes the two buckets
+// and the stash once and inserts into the first free slot seen
+template<typename K, typename V, typename Hash>
+bool CuckooMap<K,V,Hash>::insert_unique(const K& key, const V& value, bool assign)
+{
+  if ((count + 1) * 1.0 > capacity * SLOTS * load_factor_threshold)
+    resize_and_rehash();
+
+  // look for the key in both buckets and the stash, remembering the
+  // first free slot so a miss can insert without searching again
+  std::size_t h = hash(key);
+  int candidates[2] = {first_bucket(h), second_bucket(h)};
+  int free_bucket = -1;
+  int free_slot = -1;
+  for (int c = 0; c < 2; ++c)
+  {
+    Bucket& b = table[candidates[c]];
+    for (int j = 0; j < SLOTS; ++j)
+    {
+      if (!(b.used & (1 << j)))
+      {
+        if (free_bucket == -1)
+        {
+          free_bucket = candidates[c];
+          free_slot = j;
+        }
+      }
+      else if (b.keys[j] == key)
+      {
+        if (assign)
+          b.values[j] = value;
+        return false;
+      }
+    }
+  }
+  for (int i = 0; i < stash.size(); ++i)
+  {
+    if (stash[i].first == key)
+    {
+      if (assign)
+        stash[i].second = value;
+      return false;
+    }
+  }
+
+  if (free_bucket != -1)
+  {
+    Bucket& b = table[free_bucket];
+    b.keys[free_slot] = key;
+    b.values[free_slot] = value;
+    b.used |= 1 << free_slot;
+  }
+  else
+    place(key, value, h);
+  count++;
+  while (stash.size() > MAX_STASH)
+    resize_and_rehash();
+  return true;
+}
+
+// places the pair (whose key has hash h), displacing residents as needed
+template<typename K, typename V, typename Hash>
+void CuckooMap<K,V,Hash>::place(K key, V value, std::size_t h)
+{
+  int bucket = first_bucket(h);
+  for (int kick = 0; kick <= MAX_KICKS; ++kick)
+  {
+    // take a free slot in either candidate bucket if there is one
+    int candidates[2] = {bucket, first_bucket(h) == bucket ? second_bucket(h) : first_bucket(h)};
+    for (int c = 0; c < 2; ++c)
+    {
+      Bucket& b = table[candidates[c]];
+      for (int j = 0; j < SLOTS; ++j)
+      {
+        if (!(b.used & (1 << j)))
+        {
+          b.keys[j] = std::move(key);
+          b.values[j] = std::move(value);
+          b.used |= 1 << j;
+          return;
+        }
+      }
+    }
+
+    // both full: evict a resident of the second bucket and carry it
+    // to its other bucket
+    bucket = candidates[1];
+    int victim = kicks % SLOTS;
+    std::swap(key, table[bucket].keys[victim]);
+    std::swap(value, table[bucket].values[victim]);
+    kicks++;
+    h = hash(key);
+  }
+  stash.insert(std::pair<K,V> {key, value}, stash.size());
+}
+
+// double the number of buckets and reinsert every pair
+template<typename K, typename V, typename Hash>
+void CuckooMap<K,V,Hash>::resize_and_rehash()
+{
+  Bucket* old = table;
+  int old_capacity = capacity;
+  ArraySeq<std::pair<K,V>> old_stash = std::move(stash);
+  stash = ArraySeq<std::pair<K,V>>();
+  capacity *= 2;
+  table = new Bucket[capacity];
+  for (int i = 0; i < old_capacity; ++i)
+  {
+    for (int j = 0; j < SLOTS; ++j)
+    {
+      if (old[i].used & (1 << j))
+      {
+        std::size_t h = hash(old[i].keys[j]);
+        place(std::move(old[i].keys[j]), std::move(old[i].values[j]), h);
+      }
+    }
+  }
+  for (int i = 0; i < old_stash.size(); ++i)
+    place(old_stash[i].first, old_stash[i].second, hash(old_stash[i].first));
+  delete[] old;
+}
+//}}}
+
+#endif
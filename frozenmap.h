@@ -0,0 +1,530 @@
+//---------------------------------------------------------------------------
+// NAME: Adam Huonder
+// DATE: Fall 2021
+// DESC: Implements an immutable map over a minimal perfect hash
+//       (hash and displace), built once from an existing map
+//---------------------------------------------------------------------------
+
+#ifndef FROZENMAP_H
+#define FROZENMAP_H
+
+#include <cstdint>
+#include <functional>
+#include <stdexcept>
+#include "map.h"
+#include "arrayseq.h"
+#include "hashmap.h"
+
+//{{{ Header
+// The keys are split into buckets of about BUCKET_SIZE keys. Each
+// bucket stores one int: a seed that sends all of its keys to free
+// slots, or (for one-key buckets) the slot itself stored as -(slot+1).
+// The n keys and values sit in two packed arrays of exactly n slots,
+// so a lookup reads one seed and then one key, with no chains.
+template<typename K, typename V, typename Hash = std::hash<K>>
+class FrozenMap : public Map<K,V>
+{
+public:
+
+  // default constructor (an empty map)
+  FrozenMap();
+
+  // builds the table from the keys and values of the given map,
+  // hashing with a copy of the given hasher
+  FrozenMap(const Map<K,V>& map, const Hash& key_hasher = Hash());
+
+  // copy constructor
+  FrozenMap(const FrozenMap& rhs);
+
+  // move constructor
+  FrozenMap(FrozenMap&& rhs);
+
+  // copy assignment
+  FrozenMap& operator=(const FrozenMap& rhs);
+
+  // move assignment
+  FrozenMap& operator=(FrozenMap&& rhs);
+
+  // destructor
+  ~FrozenMap();
+
+  // Returns the number of key-value pairs in the map
+  int size() const;
+
+  // Tests if the map is empty
+  bool empty() const;
+
+  // Allows values associated with a key to be updated (the set of
+  // keys is fixed, the values are not). Throws out_of_range if the
+  // given key is not in the collection.
+  V& operator[](const K& key);
+
+  // Returns the value for a given key. Throws out_of_range if the
+  // given key is not in the collection.
+  const V& operator[](const K& key) const;
+
+  // The key set is fixed once built, so insert and erase throw
+  // logic_error.
+  void insert(const K& key, const V& value);
+  void erase(const K& key);
+
+  // Returns true if the key is in the collection, and false otherwise.
+  bool contains(const K& key) const;
+
+  // Returns a pointer to the value for the given key, or nullptr if
+  // the key is not in the collection.
+  V* find(const K& key);
+  const V* find(const K& key) const;
+
+  // Returns the keys k in the collection such that k1 <= k <= k2
+  ArraySeq<K> find_keys(const K& k1, const K& k2) const;
+
+  // Returns the keys in the collection in ascending sorted order
+  ArraySeq<K> sorted_keys() const;
+
+private:
+
+  // average number of keys per bucket
+  static const int BUCKET_SIZE = 3;
+
+  // seeds tried for one bucket before giving up (only reachable if
+  // the hasher maps two different keys to the same value)
+  static const int MAX_SEED = 1 << 24;
+
+  // number of key-value pairs (and slots)
+  int count = 0;
+
+  // number of buckets
+  int nbuckets = 0;
+
+  // per-bucket seed or -(slot+1)
+  int* seeds = nullptr;
+
+  // packed keys and values, indexed by slot
+  K* keys = nullptr;
+  V* values = nullptr;
+
+  // the user supplied hasher
+  Hash hasher;
+
+  // the hash function (hasher output run through mix_hash)
+  std::size_t hash(const K& key) const;
+
+  // the bucket for a hash value
+  int bucket(std::size_t h) const;
+
+  // the slot a seed sends a hash value to
+  int slot(std::size_t h, int seed) const;
+
+  // returns the slot holding the key, or -1
+  int find_slot(const K& key) const;
+
+  // builds seeds, keys, and values from the given map
+  void build(const Map<K,V>& map);
+
+  // helper to copy the arrays of another map
+  void copy(const FrozenMap& rhs);
+
+  // helper to delete the arrays
+  void make_empty();
+};
+
+// Freezes a map into a FrozenMap. The HashMap overload hashes with a
+// copy of the map's hasher (so a stateful hasher carries over).
+template<typename K, typename V>
+FrozenMap<K,V> freeze(const Map<K,V>& map);
+
+template<typename K, typename V, typename Hash>
+FrozenMap<K,V,Hash> freeze(const HashMap<K,V,Hash>& map);
+//}}}
+
+//{{{ public functions / essential operators
+// default constructor
+template<typename K, typename V, typename Hash>
+FrozenMap<K,V,Hash>::FrozenMap()
+{
+}
+
+// builds the table from the keys and values of the given map,
+// hashing with a copy of the given hasher
+template<typename K, typename V, typename Hash>
+FrozenMap<K,V,Hash>::FrozenMap(const Map<K,V>& map, const Hash& key_hasher)
+  : hasher(key_hasher)
+{
+  build(map);
+}
+
+// copy constructor
+template<typename K, typename V, typename Hash>
+FrozenMap<K,V,Hash>::FrozenMap(const FrozenMap& rhs)
+{
+  copy(rhs);
+}
+
+// move constructor
+template<typename K, typename V, typename Hash>
+FrozenMap<K,V,Hash>::FrozenMap(FrozenMap&& rhs)
+{
+  count = rhs.count;
+  nbuckets = rhs.nbuckets;
+  seeds = rhs.seeds;
+  keys = rhs.keys;
+  values = rhs.values;
+  hasher = rhs.hasher;
+  rhs.count = 0;
+  rhs.nbuckets = 0;
+  rhs.seeds = nullptr;
+  rhs.keys = nullptr;
+  rhs.values = nullptr;
+}
+
+// copy assignment
+template<typename K, typename V, typename Hash>
+FrozenMap<K,V,Hash>& FrozenMap<K,V,Hash>::operator=(const FrozenMap& rhs)
+{
+  if (this != &rhs)
+  {
+    make_empty();
+    copy(rhs);
+  }
+  return *this;
+}
+
+// move assignment
+template<typename K, typename V, typename Hash>
+FrozenMap<K,V,Hash>& FrozenMap<K,V,Hash>::operator=(FrozenMap&& rhs)
+{
+  if (this != &rhs)
+  {
+    make_empty();
+    count = rhs.count;
+    nbuckets = rhs.nbuckets;
+    seeds = rhs.seeds;
+    keys = rhs.keys;
+    values = rhs.values;
+    hasher = rhs.hasher;
+    rhs.count = 0;
+    rhs.nbuckets = 0;
+    rhs.seeds = nullptr;
+    rhs.keys = nullptr;
+    rhs.values = nullptr;
+  }
+  return *this;
+}
+
+// destructor
+template<typename K, typename V, typename Hash>
+FrozenMap<K,V,Hash>::~FrozenMap()
+{
+  make_empty();
+}
+
+// Returns the number of key-value pairs in the map
+template<typename K, typename V, typename Hash>
+int FrozenMap<K,V,Hash>::size() const
+{
+  return count;
+}
+
+// Tests if the map is empty
+template<typename K, typename V, typename Hash>
+bool FrozenMap<K,V,Hash>::empty() const
+{
+  return count == 0;
+}
+
+// Allows values associated with a key to be updated. Throws
+// out_of_range if the given key is not in the collection.
+template<typename K, typename V, typename Hash>
+V& FrozenMap<K,V,Hash>::operator[](const K& key)
+{
+  int index = find_slot(key);
+  if (index == -1)
+    throw std::out_of_range("V& FrozenMap<K,V,Hash>::operator[](const K& key). Key does not exist.");
+  return values[index];
+}
+
+// Returns the value for a given key. Throws out_of_range if the
+// given key is not in the collection.
+template<typename K, typename V, typename Hash>
+const V& FrozenMap<K,V,Hash>::operator[](const K& key) const
+{
+  int index = find_slot(key);
+  if (index == -1)
+    throw std::out_of_range("const V& FrozenMap<K,V,Hash>::operator[](const K& key) const. Key does not exist.");
+  return values[index];
+}
+
+// The key set is fixed once built
+template<typename K, typename V, typename Hash>
+void FrozenMap<K,V,Hash>::insert(const K&, const V&)
+{
+  throw std::logic_error("void FrozenMap<K,V,Hash>::insert(const K& key, const V& value). Map is frozen.");
+}
+
+// The key set is fixed once built
+template<typename K, typename V, typename Hash>
+void FrozenMap<K,V,Hash>::erase(const K&)
+{
+  throw std::logic_error("void FrozenMap<K,V,Hash>::erase(const K& key). Map is frozen.");
+}
+
+// Returns true if the key is in the collection, and false otherwise.
+template<typename K, typename V, typename Hash>
+bool FrozenMap<K,V,Hash>::contains(const K& key) const
+{
+  return find_slot(key) != -1;
+}
+
+// Returns a pointer to the value for the given key, or nullptr if
+// the key is not in the collection.
+template<typename K, typename V, typename Hash>
+V* FrozenMap<K,V,Hash>::find(const K& key)
+{
+  int index = find_slot(key);
+  return index == -1 ? nullptr : &values[index];
+}
+
+// Returns a pointer to the value for the given key, or nullptr if
+// the key is not in the collection.
+template<typename K, typename V, typename Hash>
+const V* FrozenMap<K,V,Hash>::find(const K& key) const
+{
+  int index = find_slot(key);
+  return index == -1 ? nullptr : &values[index];
+}
+
+// Returns the keys k in the collection such that k1 <= k <= k2
+template<typename K, typename V, typename Hash>
+ArraySeq<K> FrozenMap<K,V,Hash>::find_keys(const K& k1, const K& k2) const
+{
+  ArraySeq<K> found;
+  for (int i = 0; i < count; ++i)
+  {
+    if (keys[i] >= k1 and keys[i] <= k2)
+      found.insert(keys[i], found.size());
+  }
+  return found;
+}
+
+// Returns the keys in the collection in ascending sorted order
+template<typename K, typename V, typename Hash>
+ArraySeq<K> FrozenMap<K,V,Hash>::sorted_keys() const
+{
+  ArraySeq<K> sorted;
+  for (int i = 0; i < count; ++i)
+    sorted.insert(keys[i], sorted.size());
+  sorted.sort();
+  return sorted;
+}
+
+// Freezes a map into a FrozenMap
+template<typename K, typename V>
+FrozenMap<K,V> freeze(const Map<K,V>& map)
+{
+  return FrozenMap<K,V>(map);
+}
+
+// Freezes a HashMap into a FrozenMap with the same hasher
+template<typename K, typename V, typename Hash>
+FrozenMap<K,V,Hash> freeze(const HashMap<K,V,Hash>& map)
+{
+  return FrozenMap<K,V,Hash>(map, map.hash_function());
+}
+//}}}
+
+//{{{ private functions
+// the hash function
+template<typename K, typename V, typename Hash>
+std::size_t FrozenMap<K,V,Hash>::hash(const K& key) const
+{
+  return mix_hash(hasher(key));
+}
+
+// the bucket for a hash value (high bits, so it is independent of
+// the slot chosen from the whole hash)
+template<typename K, typename V, typename Hash>
+int FrozenMap<K,V,Hash>::bucket(std::size_t h) const
+{
+  return (h >> 32) % nbuckets;
+}
+
+// the slot a seed sends a hash value to
+template<typename K, typename V, typename Hash>
+int FrozenMap<K,V,Hash>::slot(std::size_t h, int seed) const
+{
+  return mix_hash(h + seed * 0x9e3779b97f4a7c15ULL) % count;
+}
+
+// returns the slot holding the key, or -1
+template<typename K, typename V, typename Hash>
+int FrozenMap<K,V,Hash>::find_slot(const K& key) const
+{
+  if (count == 0)
+    return -1;
+  std::size_t h = hash(key);
+  int seed = seeds[bucket(h)];
+  int index = seed < 0 ? -seed - 1 : slot(h, seed);
+  if (keys[index] == key)
+    return index;
+  return -1;
+}
+
+// builds seeds, keys, and values from the given map
+template<typename K, typename V, typename Hash>
+void FrozenMap<K,V,Hash>::build(const Map<K,V>& map)
+{
+  ArraySeq<K> src = map.sorted_keys();
+  count = src.size();
+  if (count == 0)
+    return;
+  nbuckets = (count + BUCKET_SIZE - 1) / BUCKET_SIZE;
+
+  std::size_t* hashes = new std::size_t[count];
+  for (int i = 0; i < count; ++i)
+    hashes[i] = hash(src[i]);
+
+  // group the keys by bucket (counting sort): the keys of bucket b
+  // are members[start[b] .. start[b+1]-1]
+  int* start = new int[nbuckets + 1]();
+  for (int i = 0; i < count; ++i)
+    start[bucket(hashes[i]) + 1]++;
+  int max_size = 0;
+  for (int b = 0; b < nbuckets; ++b)
+  {
+    if (start[b + 1] > max_size)
+      max_size = start[b + 1];
+    start[b + 1] += start[b];
+  }
+  int* members = new int[count];
+  int* fill = new int[nbuckets];
+  for (int b = 0; b < nbuckets; ++b)
+    fill[b] = start[b];
+  for (int i = 0; i < count; ++i)
+    members[fill[bucket(hashes[i])]++] = i;
+
+  // order the buckets largest first (counting sort on size), since
+  // big buckets are the hardest to place once the table fills up
+  int* by_size = new int[max_size + 2]();
+  for (int b = 0; b < nbuckets; ++b)
+    by_size[max_size - (start[b + 1] - start[b]) + 1]++;
+  for (int s = 0; s <= max_size; ++s)
+    by_size[s + 1] += by_size[s];
+  int* order = new int[nbuckets];
+  for (int b = 0; b < nbuckets; ++b)
+    order[by_size[max_size - (start[b + 1] - start[b])]++] = b;
+
+  seeds = new int[nbuckets]();
+  bool* taken = new bool[count]();
+  int* placed = new int[max_size + 1];
+  int next_free = 0;
+  for (int o = 0; o < nbuckets; ++o)
+  {
+    int b = order[o];
+    int size = start[b + 1] - start[b];
+    if (size == 0)
+      break;
+
+    // one-key buckets take the next free slot directly
+    if (size == 1)
+    {
+      while (taken[next_free])
+        next_free++;
+      taken[next_free] = true;
+      seeds[b] = -(next_free + 1);
+      continue;
+    }
+
+    // try seeds until every key of the bucket lands in a free slot
+    // distinct from the others
+    int seed = 1;
+    while (true)
+    {
+      int j = 0;
+      for (; j < size; ++j)
+      {
+        int s = slot(hashes[members[start[b] + j]], seed);
+        if (taken[s])
+          break;
+        taken[s] = true;
+        placed[j] = s;
+      }
+      if (j == size)
+        break;
+      while (j > 0)
+        taken[placed[--j]] = false;
+      if (++seed == MAX_SEED)
+      {
+        delete[] hashes;
+        delete[] start;
+        delete[] members;
+        delete[] fill;
+        delete[] by_size;
+        delete[] order;
+        delete[] taken;
+        delete[] placed;
+        make_empty();
+        throw std::invalid_argument("FrozenMap<K,V,Hash>::FrozenMap(const Map<K,V>& map). Keys have equal hashes.");
+      }
+    }
+    seeds[b] = seed;
+  }
+
+  keys = new K[count];
+  values = new V[count];
+  for (int i = 0; i < count; ++i)
+  {
+    std::size_t h = hashes[i];
+    int seed = seeds[bucket(h)];
+    int index = seed < 0 ? -seed - 1 : slot(h, seed);
+    keys[index] = src[i];
+    values[index] = map[src[i]];
+  }
+
+  delete[] hashes;
+  delete[] start;
+  delete[] members;
+  delete[] fill;
+  delete[] by_size;
+  delete[] order;
+  delete[] taken;
+  delete[] placed;
+}
+
+// helper to copy the arrays of another map
+template<typename K, typename V, typename Hash>
+void FrozenMap<K,V,Hash>::copy(const FrozenMap& rhs)
+{
+  count = rhs.count;
+  nbuckets = rhs.nbuckets;
+  hasher = rhs.hasher;
+  if (count == 0)
+    return;
+  seeds = new int[nbuckets];
+  keys = new K[count];
+  values = new V[count];
+  for (int b = 0; b < nbuckets; ++b)
+    seeds[b] = rhs.seeds[b];
+  for (int i = 0; i < count; ++i)
+  {
+    keys[i] = rhs.keys[i];
+    values[i] = rhs.values[i];
+  }
+}
+
+// helper to delete the arrays
+template<typename K, typename V, typename Hash>
+void FrozenMap<K,V,Hash>::make_empty()
+{
+  delete[] seeds;
+  delete[] keys;
+  delete[] values;
+  seeds = nullptr;
+  keys = nullptr;
+  values = nullptr;
+  count = 0;
+  nbuckets = 0;
+}
+//}}}
+
+#endif
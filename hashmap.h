@@ -1,19 +1,49 @@
 #ifndef HASHMAP_H
 #define HASHMAP_H
 
+#include <cstddef>
+#include <cstdint>
 #include <functional>
+#include <iterator>
+#include <thread>
+#include <type_traits>
+#include <utility>
 #include "map.h"
 #include "arrayseq.h"
+#include "nodepool.h"
+
+// 64-bit mixing finalizer (from MurmurHash3) applied to every hash
+// so that weak hashers such as the identity std::hash<int> still
+// spread keys across the low bits used to pick a bucket
+inline std::uint64_t mix_hash(std::uint64_t h)
+{
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdULL;
+  h ^= h >> 33;
+  h *= 0xc4ceb9fe1a85ec53ULL;
+  h ^= h >> 33;
+  return h;
+}
 
 //{{{ Header
-template<typename K, typename V>
+// Hash is the hasher for K, std::hash<K> unless a custom one is given
+template<typename K, typename V, typename Hash = std::hash<K>>
 class HashMap : public Map<K,V>
 {
+  // chain node (defined below)
+  struct Node;
+
 public:
 
   // default constructor
   HashMap();
 
+  // an empty map that hashes with a copy of the given hasher
+  HashMap(const Hash& key_hasher);
+
+  // builds the map from the given key-value pairs (see insert_range)
+  HashMap(const ArraySeq<std::pair<K,V>>& pairs, int threads = 1);
+
   // copy constructor
   HashMap(const HashMap& rhs);
 
@@ -57,7 +87,46 @@ public:
   // Returns true if the key is in the collection, and false otherwise.
   bool contains(const K& key) const;
 
+  // Returns a pointer to the value for the given key, or nullptr if
+  // the key is not in the collection.
+  V* find(const K& key);
+  const V* find(const K& key) const;
+
+  // Sets the value for the given key, adding the key-value pair if
+  // the key is not in the collection. Returns true if the pair was
+  // added and false if an existing value was replaced.
+  bool insert_or_assign(const K& key, const V& value);
+
+  // Adds the key-value pair if the key is not in the collection and
+  // otherwise leaves the existing value alone. Returns true if the
+  // pair was added.
+  bool try_emplace(const K& key, const V& value);
+
+  // Adds every key-value pair in pairs. Like insert, assumes none of
+  // the keys are present (in the collection or twice in pairs). The
+  // table is sized once up front, and with threads > 1 the nodes are
+  // filled, grouped by bucket range, and linked in parallel, each
+  // thread owning a range of buckets.
+  void insert_range(const ArraySeq<std::pair<K,V>>& pairs, int threads = 1);
+
+  // Adds the key-value pairs in [first, last), with the same
+  // assumptions as insert. Iter must be a forward iterator over
+  // std::pair<K,V> (or anything with first and second).
+  template<typename Iter>
+  void insert_range(Iter first, Iter last);
+
+  // Looks up a batch of keys. Entry i of the result is true if
+  // keys[i] is in the collection.
+  ArraySeq<bool> contains_many(const ArraySeq<K>& keys) const;
+
+  // Looks up a batch of keys. Entry i of the result points to the
+  // value for keys[i], or is nullptr if keys[i] is not in the
+  // collection.
+  ArraySeq<V*> find_many(const ArraySeq<K>& keys);
+  ArraySeq<const V*> find_many(const ArraySeq<K>& keys) const;
+
   // Returns the keys k in the collection such that k1 <= k <= k2
+  // (in ascending order when the ordered index is on)
   ArraySeq<K> find_keys(const K& k1, const K& k2) const;
 
   // Returns the keys in the collection in ascending sorted order
@@ -67,33 +136,207 @@ public:
   int min_chain_length() const;
   int max_chain_length() const;
   double avg_chain_length() const;
+
+  // number of buckets in the table (not counting an old table still
+  // being drained), and whether an incremental resize is in progress
+  int bucket_count() const;
+  bool resizing() const;
+
+  // the hasher the map was built with
+  const Hash& hash_function() const;
+
+  // Turns incremental resizing on or off. When on, a resize keeps the
+  // old table and moves a few of its buckets into the new table on
+  // each insert, erase, and (non-const) lookup instead of rehashing
+  // everything at once. Turning it off finishes any pending resize.
+  void incremental_resize(bool enabled);
+
+  // Turns the ordered index on or off. When on, the map keeps a
+  // sorted copy of its keys, rebuilt on the first range query after
+  // the map changes, so find_keys and sorted_keys cost O(log n + k)
+  // instead of a walk over every bucket. Point lookups are unchanged.
+  void ordered_index(bool enabled);
+
+  // Grows the table so that n key-value pairs fit without another
+  // resize. Never shrinks the table.
+  void reserve(int n);
+
+  // Turns shrinking on or off. When on, an erase that leaves the
+  // table less than shrink_threshold full halves it (down to
+  // min_capacity buckets), so a map emptied by erases stops paying
+  // for its peak size in find_keys, sorted_keys, and make_empty.
+  void shrink_on_erase(bool enabled);
+
+  // Forward iterator over the keys in no particular (bucket) order,
+  // including the buckets of a resize still in progress. Dereferencing
+  // gives the key and value() gives its value. Insert, erase, and the
+  // non-const lookups (which may move buckets while resizing)
+  // invalidate every iterator.
+  class const_iterator
+  {
+  public:
+    typedef std::forward_iterator_tag iterator_category;
+    typedef K value_type;
+    typedef std::ptrdiff_t difference_type;
+    typedef const K* pointer;
+    typedef const K& reference;
+
+    // an iterator that refers to no map
+    const_iterator();
+
+    const K& operator*() const;
+    const K* operator->() const;
+
+    // the value for the current key
+    const V& value() const;
+
+    // move to the next key
+    const_iterator& operator++();
+    const_iterator operator++(int);
+
+    bool operator==(const const_iterator& rhs) const;
+    bool operator!=(const const_iterator& rhs) const;
+
+  private:
+    friend class HashMap;
+    const_iterator(const HashMap* map, int index, const Node* node);
+
+    // move to the first node of the next non-empty chain (or the end)
+    void next_chain();
+
+    // the map, the chain (see chain()) and the node within it
+    // (nullptr at the end)
+    const HashMap* map = nullptr;
+    int index = 0;
+    const Node* node = nullptr;
+  };
+
+  // iterators to the first key and one past the last key
+  const_iterator begin() const;
+  const_iterator end() const;
   
 private:
 
-  // node for linked-list separate chaining
+  // node for linked-list separate chaining. The full (mixed) hash is
+  // kept so chain walks can skip keys with a different hash without
+  // calling operator== and resizes never call the hasher.
   struct Node {
     K key;
     V value;
+    std::size_t hash;
     Node* next;
   };
 
   // number of key-value pairs in map
   int count = 0;
 
-  // max size of the (array) table
+  // max size of the (array) table, always a power of two so a
+  // bucket is picked by masking instead of a division
   int capacity = 16;
 
   // threshold for resize and rehash
   const double load_factor_threshold = 0.75;
+
+  // load below which an erase halves the table (when shrinking is
+  // on), far enough under load_factor_threshold that alternating
+  // inserts and erases do not resize back and forth
+  const double shrink_threshold = 0.1875;
+
+  // the table is never shrunk below this many buckets
+  const int min_capacity = 16;
+
+  // true if erases shrink the table
+  bool shrinking = false;
   
   // array of linked lists
   Node** table = new Node*[capacity];
 
-  // the hash function
-  int hash(const K& key) const;
+  // slab storage for the chain nodes
+  NodePool<Node> pool;
+
+  // table being drained into table during an incremental resize
+  // (nullptr when no resize is in progress)
+  Node** old_table = nullptr;
+
+  // size of old_table
+  int old_capacity = 0;
+
+  // old_table buckets below this index have been moved to table
+  int migrate_index = 0;
+
+  // true if resizes are spread across later operations
+  bool incremental = false;
+
+  // number of old buckets moved per operation while resizing
+  const int migrate_step = 4;
+
+  // number of keys a batch lookup hashes and prefetches before
+  // walking any of their chains
+  static const int PREFETCH_GROUP = 16;
 
-  // resize and rehash the table
-  void resize_and_rehash();
+  // true if range queries use the sorted key index
+  bool ordered = false;
+
+  // sorted copy of the keys, only valid when index_valid is true
+  mutable ArraySeq<K> index;
+  mutable bool index_valid = false;
+
+  // the user supplied hasher
+  Hash hasher;
+
+  // the hash function (hasher output run through mix_hash)
+  std::size_t hash(const K& key) const;
+
+  // returns the chain holding (or that would hold) a key with the
+  // given hash value
+  Node*& bucket(std::size_t h);
+  Node* bucket(std::size_t h) const;
+
+  // returns the address of the table slot for the given hash value
+  Node* const* bucket_slot(std::size_t h) const;
+
+  // returns the i-th chain across table and the unmigrated part of
+  // old_table, for 0 <= i < capacity + old_capacity
+  Node* chain(int i) const;
+
+  // resize and rehash the table to the given number of buckets (a
+  // power of two)
+  void resize_and_rehash(int new_capacity);
+
+  // move up to the given number of old_table buckets into table
+  void migrate(int buckets);
+
+  // copy the chains of rhs into this (empty, initialized) table
+  void copy(const HashMap& rhs);
+
+  // insert_range helpers: copy pairs[start..end-1] into nodes, set
+  // their hashes, and count them by bucket range (the part of the
+  // table one of parts threads links) into counts; copy
+  // nodes[start..end-1] into grouped in bucket range order, at the
+  // next free index per range in offsets; and push
+  // nodes[start..end-1] onto their chains (in input order)
+  void fill_nodes(const ArraySeq<std::pair<K,V>>& pairs, Node** nodes, int start, int end,
+                  int parts, int* counts);
+  void group_nodes(Node** nodes, int start, int end, int parts, int* offsets, Node** grouped);
+  void link_nodes(Node** nodes, int start, int end);
+
+  // the bucket range (of parts equal ranges) the hash falls in
+  int part(std::size_t h, int parts) const;
+
+  // batch lookup helper, sets nodes[i] to the node holding keys[i]
+  // or nullptr
+  void find_nodes(const ArraySeq<K>& keys, Node** nodes) const;
+
+  // collect every key, in bucket order
+  ArraySeq<K> all_keys() const;
+
+  // rebuild the sorted key index if the map changed since the last
+  // rebuild
+  void update_index() const;
+
+  // insert_or_assign and try_emplace helper, searches for the key
+  // once and either adds the pair or (if assign) replaces the value
+  bool insert_unique(const K& key, const V& value, bool assign);
 
   // initialize the table to all nullptr
   void init_table();
@@ -103,19 +346,33 @@ private:
 };
 //}}}
 
-// TODO: implement the public and private HashMap functions below.
-
 //{{{ public functions / essential operators
 // default constructor
-template<typename K, typename V>
-HashMap<K,V>::HashMap()
+template<typename K, typename V, typename Hash>
+HashMap<K,V,Hash>::HashMap()
+{
+  init_table();
+}
+
+// an empty map that hashes with a copy of the given hasher
+template<typename K, typename V, typename Hash>
+HashMap<K,V,Hash>::HashMap(const Hash& key_hasher)
+  : hasher(key_hasher)
 {
   init_table();
 }
 
+// builds the map from the given key-value pairs
+template<typename K, typename V, typename Hash>
+HashMap<K,V,Hash>::HashMap(const ArraySeq<std::pair<K,V>>& pairs, int threads)
+{
+  init_table();
+  insert_range(pairs, threads);
+}
+
 // copy constructor
-template<typename K, typename V>
-HashMap<K,V>::HashMap(const HashMap& rhs)
+template<typename K, typename V, typename Hash>
+HashMap<K,V,Hash>::HashMap(const HashMap& rhs)
 {
   if (this != &rhs)
   {
@@ -124,41 +381,49 @@ HashMap<K,V>::HashMap(const HashMap& rhs)
     table = new Node*[rhs.capacity];//could this be a mem leak?
     count = rhs.count;
     capacity = rhs.capacity;
+    incremental = rhs.incremental;
+    shrinking = rhs.shrinking;
+    ordered = rhs.ordered;
+    hasher = rhs.hasher;
     init_table();
-    for (int i = 0; i < capacity; ++i)
-    {
-      Node* tmp = rhs.table[i];
-      while (tmp != nullptr)
-      {
-        Node* cpy = new Node;
-        cpy->key = tmp->key;
-        cpy->value = tmp->value;
-        cpy->next = table[i];
-        table[i] = cpy;
-        tmp = tmp->next;
-      }
-    }
+    copy(rhs);
   }
 }
 
 // move constructor
-template<typename K, typename V>
-HashMap<K,V>::HashMap(HashMap&& rhs)
+template<typename K, typename V, typename Hash>
+HashMap<K,V,Hash>::HashMap(HashMap&& rhs)
 {
   init_table();
   make_empty();
   capacity = rhs.capacity;
   count = rhs.count;
   table = rhs.table;
-  //come back to this
-  rhs.table = nullptr;
+  old_table = rhs.old_table;
+  old_capacity = rhs.old_capacity;
+  migrate_index = rhs.migrate_index;
+  incremental = rhs.incremental;
+  shrinking = rhs.shrinking;
+  ordered = rhs.ordered;
+  index = std::move(rhs.index);
+  index_valid = rhs.index_valid;
+  hasher = rhs.hasher;
+  pool = std::move(rhs.pool);
+  // leave rhs an empty map that is still usable
+  rhs.table = new Node*[16];
+  rhs.old_table = nullptr;
   rhs.count = 0;
-  rhs.capacity = 0;
+  rhs.capacity = 16;
+  rhs.old_capacity = 0;
+  rhs.migrate_index = 0;
+  rhs.index = ArraySeq<K>();
+  rhs.index_valid = false;
+  rhs.init_table();
 }
 
 // copy assignment
-template<typename K, typename V>
-HashMap<K,V>& HashMap<K,V>::operator=(const HashMap& rhs)
+template<typename K, typename V, typename Hash>
+HashMap<K,V,Hash>& HashMap<K,V,Hash>::operator=(const HashMap& rhs)
 {
   if (this != &rhs)
   {
@@ -166,27 +431,19 @@ HashMap<K,V>& HashMap<K,V>::operator=(const HashMap& rhs)
     table = new Node*[rhs.capacity];//could this be a mem leak?
     count = rhs.count;
     capacity = rhs.capacity;
+    incremental = rhs.incremental;
+    shrinking = rhs.shrinking;
+    ordered = rhs.ordered;
+    hasher = rhs.hasher;
     init_table();
-    for (int i = 0; i < capacity; ++i)
-    {
-      Node* tmp = rhs.table[i];
-      while (tmp != nullptr)
-      {
-        Node* cpy = new Node;
-        cpy->key = tmp->key;
-        cpy->value = tmp->value;
-        cpy->next = table[i];
-        table[i] = cpy;
-        tmp = tmp->next;
-      }
-    }
+    copy(rhs);
   }
   return *this;
 }
 
 // move assignment
-template<typename K, typename V>
-HashMap<K,V>& HashMap<K,V>::operator=(HashMap&& rhs)
+template<typename K, typename V, typename Hash>
+HashMap<K,V,Hash>& HashMap<K,V,Hash>::operator=(HashMap&& rhs)
 {
   if (this != &rhs)
   {
@@ -194,31 +451,46 @@ HashMap<K,V>& HashMap<K,V>::operator=(HashMap&& rhs)
     capacity = rhs.capacity;
     count = rhs.count;
     table = rhs.table;
+    old_table = rhs.old_table;
+    old_capacity = rhs.old_capacity;
+    migrate_index = rhs.migrate_index;
+    incremental = rhs.incremental;
+    shrinking = rhs.shrinking;
+    ordered = rhs.ordered;
+    index = std::move(rhs.index);
+    index_valid = rhs.index_valid;
+    hasher = rhs.hasher;
+    pool = std::move(rhs.pool);
     rhs.table = new Node*[16];
+    rhs.old_table = nullptr;
     rhs.count = 0;
     rhs.capacity = 16;
+    rhs.old_capacity = 0;
+    rhs.migrate_index = 0;
+    rhs.index = ArraySeq<K>();
+    rhs.index_valid = false;
     rhs.init_table();
   }
   return *this;
 }
 
 // destructor
-template<typename K, typename V>
-HashMap<K,V>::~HashMap()
+template<typename K, typename V, typename Hash>
+HashMap<K,V,Hash>::~HashMap()
 {
   make_empty();
 }
   
 // Returns the number of key-value pairs in the map
-template<typename K, typename V>
-int HashMap<K,V>::size() const
+template<typename K, typename V, typename Hash>
+int HashMap<K,V,Hash>::size() const
 {
   return count;
 }
 
 // Tests if the map is empty
-template<typename K, typename V>
-bool HashMap<K,V>::empty() const
+template<typename K, typename V, typename Hash>
+bool HashMap<K,V,Hash>::empty() const
 {
   if (count == 0)
     return true;
@@ -227,108 +499,327 @@ bool HashMap<K,V>::empty() const
 
 // Allows values associated with a key to be updated. Throws
 // out_of_range if the given key is not in the collection.
-template<typename K, typename V>
-V& HashMap<K,V>::operator[](const K& key)
+template<typename K, typename V, typename Hash>
+V& HashMap<K,V,Hash>::operator[](const K& key)
 {
-  int index = hash(key) % capacity;
-  Node* tmp = table[index];
+  migrate(migrate_step);
+  std::size_t h = hash(key);
+  Node* tmp = bucket(h);
   while (tmp != nullptr)
   {
-    if (tmp->key == key)
+    if (tmp->hash == h and tmp->key == key)
       return tmp->value;
     tmp = tmp->next;
   }
-  throw std::out_of_range("V& HashMap<K,V>::operator[](const K& key). Key does not exist.");
+  throw std::out_of_range("V& HashMap<K,V,Hash>::operator[](const K& key). Key does not exist.");
 }
 
 // Returns the value for a given key. Throws out_of_range if the
 // given key is not in the collection. 
-template<typename K, typename V>
-const V& HashMap<K,V>::operator[](const K& key) const
+template<typename K, typename V, typename Hash>
+const V& HashMap<K,V,Hash>::operator[](const K& key) const
 {
-  int index = hash(key) % capacity;
-  Node* tmp = table[index];
+  std::size_t h = hash(key);
+  Node* tmp = bucket(h);
   while (tmp != nullptr)
   {
-    if (tmp->key == key)
+    if (tmp->hash == h and tmp->key == key)
       return tmp->value;
     tmp = tmp->next;
   }
-  throw std::out_of_range("const V& HashMap<K,V>::operator[](const K& key) const. Key does not exist.");
+  throw std::out_of_range("const V& HashMap<K,V,Hash>::operator[](const K& key) const. Key does not exist.");
 }
 
 // Extends the collection by adding the given key-value
 // pair. Assumes the key being added is not present in the
 // collection. Insert does not check if the key is present.
-template<typename K, typename V>
-void HashMap<K,V>::insert(const K& key, const V& value)
+template<typename K, typename V, typename Hash>
+void HashMap<K,V,Hash>::insert(const K& key, const V& value)
 {
-  Node* in = new Node;
+  migrate(migrate_step);
+  std::size_t h = hash(key);
+  Node* in = pool.alloc();
   in->key = key;
   in->value = value;
-  int index = hash(key) % capacity;
-  in->next = table[index];
-  table[index] = in;
+  in->hash = h;
+  Node*& head = bucket(h);
+  in->next = head;
+  head = in;
   count++;
-  if ((count * 1.0) / (capacity * 1.0) >= 0.75)
-    resize_and_rehash();
+  index_valid = false;
+  if ((count * 1.0) / (capacity * 1.0) >= load_factor_threshold)
+    resize_and_rehash(capacity * 2);
 }
 
 // Shrinks the collection by removing the key-value pair with the
 // given key. Does not modify the collection if the collection does
 // not contain the key. Throws out_of_range if the given key is not
 // in the collection.
-template<typename K, typename V>
-void HashMap<K,V>::erase(const K& key)
+template<typename K, typename V, typename Hash>
+void HashMap<K,V,Hash>::erase(const K& key)
 {
-  int index = hash(key) % capacity;
-  Node* tmp = table[index];
+  migrate(migrate_step);
+  std::size_t h = hash(key);
+  Node*& head = bucket(h);
+  Node* tmp = head;
   Node* pre = nullptr;
   while (tmp != nullptr)
   {
-    if (tmp->key == key)
+    if (tmp->hash == h and tmp->key == key)
     {
       if (pre == nullptr)
-      {
-        table[index] = tmp->next;
-        delete tmp;
-        count--;
-        return;
-      }
-      pre->next = tmp->next;
-      delete tmp;
+        head = tmp->next;
+      else
+        pre->next = tmp->next;
+      pool.free(tmp);
       count--;
+      index_valid = false;
+      if (shrinking and capacity > min_capacity and
+          (count * 1.0) / (capacity * 1.0) < shrink_threshold)
+        resize_and_rehash(capacity / 2);
       return;
     }
     pre = tmp;
     tmp = tmp->next;
   }
-  throw std::out_of_range("void HashMap<K,V>::erase(const K& key). Key does not exist.");
+  throw std::out_of_range("void HashMap<K,V,Hash>::erase(const K& key). Key does not exist.");
 }
 
 // Returns true if the key is in the collection, and false otherwise.
-template<typename K, typename V>
-bool HashMap<K,V>::contains(const K& key) const
+template<typename K, typename V, typename Hash>
+bool HashMap<K,V,Hash>::contains(const K& key) const
 {
-  int index = hash(key) % capacity;
-  Node* tmp = table[index];
+  std::size_t h = hash(key);
+  Node* tmp = bucket(h);
   while (tmp != nullptr)
   {
-    if (tmp->key == key)
+    if (tmp->hash == h and tmp->key == key)
       return true;
     tmp = tmp->next;
   }
   return false;
 }
 
+// Returns a pointer to the value for the given key, or nullptr if
+// the key is not in the collection.
+template<typename K, typename V, typename Hash>
+V* HashMap<K,V,Hash>::find(const K& key)
+{
+  migrate(migrate_step);
+  std::size_t h = hash(key);
+  Node* tmp = bucket(h);
+  while (tmp != nullptr)
+  {
+    if (tmp->hash == h and tmp->key == key)
+      return &tmp->value;
+    tmp = tmp->next;
+  }
+  return nullptr;
+}
+
+// Returns a pointer to the value for the given key, or nullptr if
+// the key is not in the collection.
+template<typename K, typename V, typename Hash>
+const V* HashMap<K,V,Hash>::find(const K& key) const
+{
+  std::size_t h = hash(key);
+  Node* tmp = bucket(h);
+  while (tmp != nullptr)
+  {
+    if (tmp->hash == h and tmp->key == key)
+      return &tmp->value;
+    tmp = tmp->next;
+  }
+  return nullptr;
+}
+
+// Sets the value for the given key, adding the key-value pair if
+// the key is not in the collection. Returns true if the pair was
+// added and false if an existing value was replaced.
+template<typename K, typename V, typename Hash>
+bool HashMap<K,V,Hash>::insert_or_assign(const K& key, const V& value)
+{
+  return insert_unique(key, value, true);
+}
+
+// Adds the key-value pair if the key is not in the collection and
+// otherwise leaves the existing value alone. Returns true if the
+// pair was added.
+template<typename K, typename V, typename Hash>
+bool HashMap<K,V,Hash>::try_emplace(const K& key, const V& value)
+{
+  return insert_unique(key, value, false);
+}
+
+// Adds every key-value pair in pairs, sizing the table once.
+template<typename K, typename V, typename Hash>
+void HashMap<K,V,Hash>::insert_range(const ArraySeq<std::pair<K,V>>& pairs, int threads)
+{
+  int n = pairs.size();
+  if (n == 0)
+    return;
+
+  // grow once, and finish the move so every chain is in table
+  reserve(count + n);
+  migrate(old_capacity);
+
+  // the pool is not thread safe, so the nodes are allocated up front
+  Node** nodes = new Node*[n];
+  for (int i = 0; i < n; ++i)
+    nodes[i] = pool.alloc();
+
+  if (threads <= 1 or n < threads)
+  {
+    int counts[1];
+    fill_nodes(pairs, nodes, 0, n, 1, counts);
+    link_nodes(nodes, 0, n);
+  }
+  else
+  {
+    // A stable counting sort by bucket range: each thread fills an
+    // equal share of the nodes and counts them per range, the
+    // counts give every (share, range) pair its own slice of
+    // grouped, and each thread copies its share into those slices.
+    // Then each thread links only the nodes of its own range, so no
+    // two threads write the same chain and none scans the others'
+    // nodes. Within a range the input order is kept, so the chains
+    // come out as with one thread.
+    Node** grouped = new Node*[n];
+    int* counts = new int[threads * threads];
+    int* starts = new int[threads + 1];
+    std::thread* workers = new std::thread[threads];
+    for (int t = 0; t < threads; ++t)
+      workers[t] = std::thread(&HashMap::fill_nodes, this, std::cref(pairs), nodes,
+                               (long) n * t / threads, (long) n * (t + 1) / threads,
+                               threads, counts + t * threads);
+    for (int t = 0; t < threads; ++t)
+      workers[t].join();
+
+    // counts[t * threads + r] becomes where share t's nodes in range
+    // r start in grouped
+    int offset = 0;
+    for (int r = 0; r < threads; ++r)
+    {
+      starts[r] = offset;
+      for (int t = 0; t < threads; ++t)
+      {
+        int c = counts[t * threads + r];
+        counts[t * threads + r] = offset;
+        offset += c;
+      }
+    }
+    starts[threads] = n;
+
+    for (int t = 0; t < threads; ++t)
+      workers[t] = std::thread(&HashMap::group_nodes, this, nodes,
+                               (long) n * t / threads, (long) n * (t + 1) / threads,
+                               threads, counts + t * threads, grouped);
+    for (int t = 0; t < threads; ++t)
+      workers[t].join();
+    for (int r = 0; r < threads; ++r)
+      workers[r] = std::thread(&HashMap::link_nodes, this, grouped, starts[r], starts[r + 1]);
+    for (int r = 0; r < threads; ++r)
+      workers[r].join();
+    delete[] workers;
+    delete[] starts;
+    delete[] counts;
+    delete[] grouped;
+  }
+
+  delete[] nodes;
+  count += n;
+  index_valid = false;
+}
+
+// Adds the key-value pairs in [first, last), sizing the table once.
+template<typename K, typename V, typename Hash>
+template<typename Iter>
+void HashMap<K,V,Hash>::insert_range(Iter first, Iter last)
+{
+  reserve(count + std::distance(first, last));
+  for (; first != last; ++first)
+    insert(first->first, first->second);
+}
+
+// Looks up a batch of keys. Entry i of the result is true if
+// keys[i] is in the collection.
+template<typename K, typename V, typename Hash>
+ArraySeq<bool> HashMap<K,V,Hash>::contains_many(const ArraySeq<K>& keys) const
+{
+  Node** nodes = new Node*[keys.size()];
+  find_nodes(keys, nodes);
+  ArraySeq<bool> found;
+  for (int i = 0; i < keys.size(); ++i)
+    found.insert(nodes[i] != nullptr, found.size());
+  delete[] nodes;
+  return found;
+}
+
+// Looks up a batch of keys. Entry i of the result points to the
+// value for keys[i], or is nullptr if keys[i] is not in the
+// collection.
+template<typename K, typename V, typename Hash>
+ArraySeq<V*> HashMap<K,V,Hash>::find_many(const ArraySeq<K>& keys)
+{
+  Node** nodes = new Node*[keys.size()];
+  find_nodes(keys, nodes);
+  ArraySeq<V*> values;
+  for (int i = 0; i < keys.size(); ++i)
+  {
+    if (nodes[i] != nullptr)
+      values.insert(&nodes[i]->value, values.size());
+    else
+      values.insert(nullptr, values.size());
+  }
+  delete[] nodes;
+  return values;
+}
+
+// Looks up a batch of keys (const version)
+template<typename K, typename V, typename Hash>
+ArraySeq<const V*> HashMap<K,V,Hash>::find_many(const ArraySeq<K>& keys) const
+{
+  Node** nodes = new Node*[keys.size()];
+  find_nodes(keys, nodes);
+  ArraySeq<const V*> values;
+  for (int i = 0; i < keys.size(); ++i)
+  {
+    if (nodes[i] != nullptr)
+      values.insert(&nodes[i]->value, values.size());
+    else
+      values.insert(nullptr, values.size());
+  }
+  delete[] nodes;
+  return values;
+}
+
 // Returns the keys k in the collection such that k1 <= k <= k2
-template<typename K, typename V>
-ArraySeq<K> HashMap<K,V>::find_keys(const K& k1, const K& k2) const
+template<typename K, typename V, typename Hash>
+ArraySeq<K> HashMap<K,V,Hash>::find_keys(const K& k1, const K& k2) const
 {
   ArraySeq<K> keys;
-  for (int i = 0; i < capacity; ++i)
+  if (ordered)
+  {
+    update_index();
+    // binary search for the first key >= k1
+    int start = 0;
+    int end = index.size();
+    while (start < end)
+    {
+      int mid = (start + end) / 2;
+      if (index[mid] < k1)
+        start = mid + 1;
+      else
+        end = mid;
+    }
+    for (int i = start; i < index.size() and index[i] <= k2; ++i)
+      keys.insert(index[i], keys.size());
+    return keys;
+  }
+
+  for (int i = 0; i < capacity + old_capacity; ++i)
   {
-    Node* tmp = table[i];
+    Node* tmp = chain(i);
     while(tmp != nullptr)
     {
       if (tmp->key >= k1 and tmp->key <= k2)
@@ -340,34 +831,71 @@ ArraySeq<K> HashMap<K,V>::find_keys(const K& k1, const K& k2) const
 }
 
 // Returns the keys in the collection in ascending sorted order
-template<typename K, typename V>
-ArraySeq<K> HashMap<K,V>::sorted_keys() const
+template<typename K, typename V, typename Hash>
+ArraySeq<K> HashMap<K,V,Hash>::sorted_keys() const
 {
-  ArraySeq<K> keys;
-  for (int i = 0; i < capacity; ++i)
+  if (ordered)
   {
-    Node* tmp = table[i];
-    while (tmp != nullptr)
-    {
-      keys.insert(tmp->key, keys.size());
-      tmp = tmp->next;
-    }
+    update_index();
+    return index;
   }
+
+  ArraySeq<K> keys = all_keys();
+  keys.sort();
   return keys;
 }
+
+// Turns incremental resizing on or off.
+template<typename K, typename V, typename Hash>
+void HashMap<K,V,Hash>::incremental_resize(bool enabled)
+{
+  incremental = enabled;
+  if (!incremental)
+    migrate(old_capacity);
+}
+
+// Turns the ordered index on or off.
+template<typename K, typename V, typename Hash>
+void HashMap<K,V,Hash>::ordered_index(bool enabled)
+{
+  ordered = enabled;
+  if (!ordered)
+  {
+    index = ArraySeq<K>();
+    index_valid = false;
+  }
+}
+
+// Grows the table so that n key-value pairs fit without a resize.
+template<typename K, typename V, typename Hash>
+void HashMap<K,V,Hash>::reserve(int n)
+{
+  int new_capacity = capacity;
+  while ((n * 1.0) / (new_capacity * 1.0) >= load_factor_threshold)
+    new_capacity *= 2;
+  if (new_capacity > capacity)
+    resize_and_rehash(new_capacity);
+}
+
+// Turns shrinking on or off.
+template<typename K, typename V, typename Hash>
+void HashMap<K,V,Hash>::shrink_on_erase(bool enabled)
+{
+  shrinking = enabled;
+}
 //}}}
 
 //{{{ statistics functions for the hash table implementation
-template<typename K, typename V>
-int HashMap<K,V>::min_chain_length() const
+template<typename K, typename V, typename Hash>
+int HashMap<K,V,Hash>::min_chain_length() const
 {
   int minChain = 1;
   if (count == 0)
     return 0;
 
-  for (int i = 0; i < capacity; ++i)
+  for (int i = 0; i < capacity + old_capacity; ++i)
   {
-    Node* tmp = table[i];
+    Node* tmp = chain(i);
     int chainCount = 0;
     while (tmp != nullptr)
     {
@@ -380,16 +908,16 @@ int HashMap<K,V>::min_chain_length() const
   return minChain;
 }
 
-template<typename K, typename V>
-int HashMap<K,V>::max_chain_length() const
+template<typename K, typename V, typename Hash>
+int HashMap<K,V,Hash>::max_chain_length() const
 {
   int maxChain = 0;
   if (count == 0)
     return 0;
 
-  for (int i = 0; i < capacity; ++i)
+  for (int i = 0; i < capacity + old_capacity; ++i)
   {
-    Node* tmp = table[i];
+    Node* tmp = chain(i);
     int chainCount = 0;
     while (tmp != nullptr)
     {
@@ -402,8 +930,8 @@ int HashMap<K,V>::max_chain_length() const
   return maxChain;
 }
 
-template<typename K, typename V>
-double HashMap<K,V>::avg_chain_length() const
+template<typename K, typename V, typename Hash>
+double HashMap<K,V,Hash>::avg_chain_length() const
 {
   int totalChains = 0;
   double avgChain = 0.0;
@@ -413,9 +941,9 @@ double HashMap<K,V>::avg_chain_length() const
   if (count == 0)
     return 0.0;
 
-  for (int i = 0; i < capacity; ++i)
+  for (int i = 0; i < capacity + old_capacity; ++i)
   {
-    Node* tmp = table[i];
+    Node* tmp = chain(i);
     if (tmp != nullptr)
     {
       totalChains++;
@@ -431,83 +959,432 @@ double HashMap<K,V>::avg_chain_length() const
   avgChain = (chainNumTotal * 1.0) / (totalChains * 1.0);
   return avgChain;
 }
+
+template<typename K, typename V, typename Hash>
+int HashMap<K,V,Hash>::bucket_count() const
+{
+  return capacity;
+}
+
+template<typename K, typename V, typename Hash>
+bool HashMap<K,V,Hash>::resizing() const
+{
+  return old_table != nullptr;
+}
+
+template<typename K, typename V, typename Hash>
+const Hash& HashMap<K,V,Hash>::hash_function() const
+{
+  return hasher;
+}
+//}}}
+
+//{{{ const_iterator
+// iterator to the first key
+template<typename K, typename V, typename Hash>
+typename HashMap<K,V,Hash>::const_iterator HashMap<K,V,Hash>::begin() const
+{
+  const_iterator it(this, -1, nullptr);
+  it.next_chain();
+  return it;
+}
+
+// iterator to one past the last key
+template<typename K, typename V, typename Hash>
+typename HashMap<K,V,Hash>::const_iterator HashMap<K,V,Hash>::end() const
+{
+  return const_iterator(this, capacity + old_capacity, nullptr);
+}
+
+template<typename K, typename V, typename Hash>
+HashMap<K,V,Hash>::const_iterator::const_iterator()
+{
+}
+
+template<typename K, typename V, typename Hash>
+HashMap<K,V,Hash>::const_iterator::const_iterator(const HashMap* map, int index, const Node* node)
+  : map(map), index(index), node(node)
+{
+}
+
+template<typename K, typename V, typename Hash>
+const K& HashMap<K,V,Hash>::const_iterator::operator*() const
+{
+  return node->key;
+}
+
+template<typename K, typename V, typename Hash>
+const K* HashMap<K,V,Hash>::const_iterator::operator->() const
+{
+  return &node->key;
+}
+
+// the value for the current key
+template<typename K, typename V, typename Hash>
+const V& HashMap<K,V,Hash>::const_iterator::value() const
+{
+  return node->value;
+}
+
+// move to the next key
+template<typename K, typename V, typename Hash>
+typename HashMap<K,V,Hash>::const_iterator& HashMap<K,V,Hash>::const_iterator::operator++()
+{
+  node = node->next;
+  if (node == nullptr)
+    next_chain();
+  return *this;
+}
+
+template<typename K, typename V, typename Hash>
+typename HashMap<K,V,Hash>::const_iterator HashMap<K,V,Hash>::const_iterator::operator++(int)
+{
+  const_iterator tmp = *this;
+  ++(*this);
+  return tmp;
+}
+
+template<typename K, typename V, typename Hash>
+bool HashMap<K,V,Hash>::const_iterator::operator==(const const_iterator& rhs) const
+{
+  return node == rhs.node;
+}
+
+template<typename K, typename V, typename Hash>
+bool HashMap<K,V,Hash>::const_iterator::operator!=(const const_iterator& rhs) const
+{
+  return node != rhs.node;
+}
+
+// move to the first node of the next non-empty chain (or the end)
+template<typename K, typename V, typename Hash>
+void HashMap<K,V,Hash>::const_iterator::next_chain()
+{
+  int chains = map->capacity + map->old_capacity;
+  node = nullptr;
+  while (node == nullptr and ++index < chains)
+    node = map->chain(index);
+}
 //}}}
 
 //{{{ private functions
 // the hash function
-template<typename K, typename V>
-int HashMap<K,V>::hash(const K& key) const
+template<typename K, typename V, typename Hash>
+std::size_t HashMap<K,V,Hash>::hash(const K& key) const
 {
-  std::hash<K> hash_fun;
-  int index = hash_fun(key);
-  return index;
+  return mix_hash(hasher(key));
 }
 
-// resize and rehash the table
-template<typename K, typename V>
-void HashMap<K,V>::resize_and_rehash()
+// returns the chain holding (or that would hold) a key with the
+// given hash value
+template<typename K, typename V, typename Hash>
+typename HashMap<K,V,Hash>::Node*& HashMap<K,V,Hash>::bucket(std::size_t h)
 {
-  Node** table2 = new Node*[capacity * 2];
-  for (int i = 0; i < capacity * 2; ++i)
+  if (old_table != nullptr)
   {
-    table2[i] = nullptr;
+    int old_index = h & (old_capacity - 1);
+    if (old_index >= migrate_index)
+      return old_table[old_index];
   }
-  
-  for (int i = 0; i < capacity; ++i)
+  return table[h & (capacity - 1)];
+}
+
+// returns the chain for the given hash value (const version)
+template<typename K, typename V, typename Hash>
+typename HashMap<K,V,Hash>::Node* HashMap<K,V,Hash>::bucket(std::size_t h) const
+{
+  if (old_table != nullptr)
   {
-    //go through old table and rehash all values into new slots.
-    Node* tmp = table[i];
-    while (table[i] != nullptr)
+    int old_index = h & (old_capacity - 1);
+    if (old_index >= migrate_index)
+      return old_table[old_index];
+  }
+  return table[h & (capacity - 1)];
+}
+
+// returns the address of the table slot for the given hash value
+template<typename K, typename V, typename Hash>
+typename HashMap<K,V,Hash>::Node* const* HashMap<K,V,Hash>::bucket_slot(std::size_t h) const
+{
+  if (old_table != nullptr)
+  {
+    int old_index = h & (old_capacity - 1);
+    if (old_index >= migrate_index)
+      return &old_table[old_index];
+  }
+  return &table[h & (capacity - 1)];
+}
+
+// returns the i-th chain across table and the unmigrated part of
+// old_table
+template<typename K, typename V, typename Hash>
+typename HashMap<K,V,Hash>::Node* HashMap<K,V,Hash>::chain(int i) const
+{
+  if (i < capacity)
+    return table[i];
+  i -= capacity;
+  if (i < migrate_index)
+    return nullptr;
+  return old_table[i];
+}
+
+// resize and rehash the table to the given number of buckets
+template<typename K, typename V, typename Hash>
+void HashMap<K,V,Hash>::resize_and_rehash(int new_capacity)
+{
+  // a previous resize must be drained before starting another
+  migrate(old_capacity);
+
+  old_table = table;
+  old_capacity = capacity;
+  migrate_index = 0;
+  capacity = new_capacity;
+  table = new Node*[capacity];
+  init_table();
+
+  if (!incremental)
+    migrate(old_capacity);
+}
+
+// move up to the given number of old_table buckets into table
+template<typename K, typename V, typename Hash>
+void HashMap<K,V,Hash>::migrate(int buckets)
+{
+  if (old_table == nullptr)
+    return;
+
+  for (int n = 0; n < buckets and migrate_index < old_capacity; ++n)
+  {
+    //go through old bucket and rehash all values into new slots.
+    while (old_table[migrate_index] != nullptr)
     {
-      Node* tmp = table[i];
-      int rehashIndex = hash(table[i]->key) % (capacity * 2);
-      if (table2[rehashIndex] == nullptr)
-      {
-        table2[rehashIndex] = table[i];
-        table2[rehashIndex]->next = nullptr;
-        table[i] = table[i]->next;
-      }
-      else
-      {
-        table[i] = table[i]->next;
-        tmp->next = table2[rehashIndex];
-        table2[rehashIndex] = tmp;
-      }
+      Node* tmp = old_table[migrate_index];
+      old_table[migrate_index] = tmp->next;
+      int rehashIndex = tmp->hash & (capacity - 1);
+      tmp->next = table[rehashIndex];
+      table[rehashIndex] = tmp;
     }
+    migrate_index++;
   }
-  init_table();
-  delete[] table;
-  capacity *= 2;
-  table = table2;
+
+  if (migrate_index == old_capacity)
+  {
+    delete[] old_table;
+    old_table = nullptr;
+    old_capacity = 0;
+    migrate_index = 0;
+  }
+}
+
+// insert_or_assign and try_emplace helper
+template<typename K, typename V, typename Hash>
+bool HashMap<K,V,Hash>::insert_unique(const K& key, const V& value, bool assign)
+{
+  migrate(migrate_step);
+  std::size_t h = hash(key);
+  Node*& head = bucket(h);
+  Node* tmp = head;
+  while (tmp != nullptr)
+  {
+    if (tmp->hash == h and tmp->key == key)
+    {
+      if (assign)
+        tmp->value = value;
+      return false;
+    }
+    tmp = tmp->next;
+  }
+
+  Node* in = pool.alloc();
+  in->key = key;
+  in->value = value;
+  in->hash = h;
+  in->next = head;
+  head = in;
+  count++;
+  index_valid = false;
+  if ((count * 1.0) / (capacity * 1.0) >= load_factor_threshold)
+    resize_and_rehash(capacity * 2);
+  return true;
+}
+
+// copy the chains of rhs into this (empty, initialized) table
+template<typename K, typename V, typename Hash>
+void HashMap<K,V,Hash>::copy(const HashMap& rhs)
+{
+  // chains still in rhs's old table are rehashed into the copy, so
+  // the copy never starts out mid-resize
+  for (int i = 0; i < rhs.capacity + rhs.old_capacity; ++i)
+  {
+    Node* tmp = rhs.chain(i);
+    while (tmp != nullptr)
+    {
+      int index = i;
+      if (i >= capacity)
+        index = tmp->hash & (capacity - 1);
+      Node* cpy = pool.alloc();
+      cpy->key = tmp->key;
+      cpy->value = tmp->value;
+      cpy->hash = tmp->hash;
+      cpy->next = table[index];
+      table[index] = cpy;
+      tmp = tmp->next;
+    }
+  }
+}
+
+// insert_range helper, copies pairs[start..end-1] into nodes and
+// counts them by bucket range
+template<typename K, typename V, typename Hash>
+void HashMap<K,V,Hash>::fill_nodes(const ArraySeq<std::pair<K,V>>& pairs, Node** nodes, int start, int end,
+                                   int parts, int* counts)
+{
+  for (int r = 0; r < parts; ++r)
+    counts[r] = 0;
+  for (int i = start; i < end; ++i)
+  {
+    nodes[i]->key = pairs[i].first;
+    nodes[i]->value = pairs[i].second;
+    nodes[i]->hash = hash(pairs[i].first);
+    counts[part(nodes[i]->hash, parts)]++;
+  }
+}
+
+// insert_range helper, copies nodes[start..end-1] into grouped by
+// bucket range
+template<typename K, typename V, typename Hash>
+void HashMap<K,V,Hash>::group_nodes(Node** nodes, int start, int end, int parts, int* offsets,
+                                    Node** grouped)
+{
+  for (int i = start; i < end; ++i)
+    grouped[offsets[part(nodes[i]->hash, parts)]++] = nodes[i];
+}
+
+// insert_range helper, links nodes[start..end-1]
+template<typename K, typename V, typename Hash>
+void HashMap<K,V,Hash>::link_nodes(Node** nodes, int start, int end)
+{
+  for (int i = start; i < end; ++i)
+  {
+    int index = nodes[i]->hash & (capacity - 1);
+    nodes[i]->next = table[index];
+    table[index] = nodes[i];
+  }
+}
+
+// the bucket range the hash falls in
+template<typename K, typename V, typename Hash>
+int HashMap<K,V,Hash>::part(std::size_t h, int parts) const
+{
+  return (long) (h & (capacity - 1)) * parts / capacity;
+}
+
+// batch lookup helper
+template<typename K, typename V, typename Hash>
+void HashMap<K,V,Hash>::find_nodes(const ArraySeq<K>& keys, Node** nodes) const
+{
+  // Group prefetching: a scalar lookup stalls on the table slot and
+  // then on the first node. Here each group of keys is hashed and
+  // its slots prefetched, then its chain heads are loaded and
+  // prefetched, and only then are the chains walked, so the cache
+  // misses within a group overlap instead of happening one by one.
+  Node* const* slots[PREFETCH_GROUP];
+  std::size_t hashes[PREFETCH_GROUP];
+  for (int start = 0; start < keys.size(); start += PREFETCH_GROUP)
+  {
+    int end = start + PREFETCH_GROUP;
+    if (end > keys.size())
+      end = keys.size();
+
+    for (int i = start; i < end; ++i)
+    {
+      hashes[i - start] = hash(keys[i]);
+      slots[i - start] = bucket_slot(hashes[i - start]);
+      __builtin_prefetch(slots[i - start]);
+    }
+
+    for (int i = start; i < end; ++i)
+    {
+      nodes[i] = *slots[i - start];
+      if (nodes[i] != nullptr)
+        __builtin_prefetch(nodes[i]);
+    }
+
+    for (int i = start; i < end; ++i)
+    {
+      Node* tmp = nodes[i];
+      while (tmp != nullptr and !(tmp->hash == hashes[i - start] and tmp->key == keys[i]))
+        tmp = tmp->next;
+      nodes[i] = tmp;
+    }
+  }
+}
+
+// collect every key, in bucket order
+template<typename K, typename V, typename Hash>
+ArraySeq<K> HashMap<K,V,Hash>::all_keys() const
+{
+  ArraySeq<K> keys;
+  for (int i = 0; i < capacity + old_capacity; ++i)
+  {
+    Node* tmp = chain(i);
+    while (tmp != nullptr)
+    {
+      keys.insert(tmp->key, keys.size());
+      tmp = tmp->next;
+    }
+  }
+  return keys;
+}
+
+// rebuild the sorted key index if the map changed since the last
+// rebuild
+template<typename K, typename V, typename Hash>
+void HashMap<K,V,Hash>::update_index() const
+{
+  if (index_valid)
+    return;
+  index = all_keys();
+  index.sort();
+  index_valid = true;
 }
 
 // initialize the table to all nullptr
-template<typename K, typename V>
-void HashMap<K,V>::init_table()
+template<typename K, typename V, typename Hash>
+void HashMap<K,V,Hash>::init_table()
 {
   for (int i = 0; i < capacity; ++i)
     table[i] = nullptr;
 }
   
 // clean up the table and reset member variables
-template<typename K, typename V>
-void HashMap<K,V>::make_empty()
+template<typename K, typename V, typename Hash>
+void HashMap<K,V,Hash>::make_empty()
 {
-  for (int i = 0; i < capacity; ++i)
+  // the pool releases node memory a slab at a time, so the chains
+  // only need walking when the nodes have destructors to run
+  if (!std::is_trivially_destructible<Node>::value)
   {
-    if (table[i] != nullptr)
+    for (int i = 0; i < capacity + old_capacity; ++i)
     {
+      Node* del = chain(i);
       //clean linked list
-      while (table[i] != nullptr)
+      while (del != nullptr)
       {
-        Node* del = table[i];
-        table[i] = table[i]->next;
-        delete del;
-        del = nullptr;
+        Node* next = del->next;
+        del->~Node();
+        del = next;
       }
     }
   }
+  pool.clear();
   delete[] table;
+  delete[] old_table;
+  table = nullptr;
+  old_table = nullptr;
+  old_capacity = 0;
+  migrate_index = 0;
+  index_valid = false;
 }
 //}}}
 
@@ -0,0 +1,242 @@
+//---------------------------------------------------------------------------
+// NAME: Adam Huonder
+// FILE: hashmap_bench.cpp
+// DATE: Fall 2021
+// DESC: benchmarks for HashMap
+//
+//       g++ -std=c++17 -O2 hashmap_bench.cpp -o hashmap_bench
+//       ./hashmap_bench [keys]
+//---------------------------------------------------------------------------
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include "hashmap.h"
+
+using namespace std;
+
+
+//----------------------------------------------------------------------
+// Allocation counting
+//----------------------------------------------------------------------
+
+// number of calls to operator new since the last reset
+static long allocations = 0;
+
+void* operator new(size_t size)
+{
+  allocations++;
+  void* ptr = malloc(size == 0 ? 1 : size);
+  if (ptr == nullptr)
+    throw bad_alloc();
+  return ptr;
+}
+
+void operator delete(void* ptr) noexcept
+{
+  free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept
+{
+  free(ptr);
+}
+
+// milliseconds since start
+double elapsed_ms(chrono::steady_clock::time_point start)
+{
+  chrono::duration<double, milli> d = chrono::steady_clock::now() - start;
+  return d.count();
+}
+
+
+//----------------------------------------------------------------------
+// Node pool: allocations and time for insert, erase/reinsert churn,
+// copy, and destruction. std::unordered_map allocates one node per
+// entry, as HashMap did before its nodes came from a NodePool.
+//----------------------------------------------------------------------
+
+template<typename M>
+void pool_run(const string& name, int n)
+{
+  allocations = 0;
+  auto start = chrono::steady_clock::now();
+  M* map = new M;
+  for (int i = 0; i < n; ++i)
+    map->insert({i, i});
+  long insert_allocs = allocations;
+  double insert_ms = elapsed_ms(start);
+
+  // erase and reinsert half the keys, freed nodes should be reused
+  allocations = 0;
+  start = chrono::steady_clock::now();
+  for (int i = 0; i < n; i += 2)
+    map->erase(i);
+  for (int i = 0; i < n; i += 2)
+    map->insert({i, i});
+  long churn_allocs = allocations;
+  double churn_ms = elapsed_ms(start);
+
+  allocations = 0;
+  start = chrono::steady_clock::now();
+  M* copy = new M(*map);
+  long copy_allocs = allocations;
+  double copy_ms = elapsed_ms(start);
+
+  start = chrono::steady_clock::now();
+  delete map;
+  delete copy;
+  double destroy_ms = elapsed_ms(start);
+
+  cout << name << ": insert " << insert_allocs << " allocs / " << insert_ms
+       << " ms, churn " << churn_allocs << " allocs / " << churn_ms
+       << " ms, copy " << copy_allocs << " allocs / " << copy_ms
+       << " ms, destroy (both) " << destroy_ms << " ms" << endl;
+}
+
+// adapts HashMap to the calls pool_run makes
+struct PooledHashMap {
+  HashMap<int,int> map;
+  void insert(const pair<int,int>& p) { map.insert(p.first, p.second); }
+  void erase(int key) { map.erase(key); }
+};
+
+void pool_bench(int n)
+{
+  cout << "-- node pool, " << n << " int keys" << endl;
+  pool_run<PooledHashMap>("HashMap (pool)          ", n);
+  pool_run<unordered_map<int,int>>("unordered_map (per node)", n);
+}
+
+
+//----------------------------------------------------------------------
+// Batch lookup: the scalar contains() loop against contains_many and
+// find_many over random probes, about half of them hits. The table
+// should be well past the cache size for prefetching to matter.
+//----------------------------------------------------------------------
+
+void batch_bench(int n)
+{
+  HashMap<long,long> map;
+  map.reserve(n);
+  for (int i = 0; i < n; ++i)
+    map.insert(2L * i, i);
+
+  // batches of 4096 probes, half even (hits) and half odd (misses)
+  const int batch_size = 4096;
+  const int batches = 256;
+  mt19937_64 gen(7);
+  ArraySeq<ArraySeq<long>*> probes;
+  for (int b = 0; b < batches; ++b)
+  {
+    ArraySeq<long>* batch = new ArraySeq<long>;
+    for (int i = 0; i < batch_size; ++i)
+      batch->insert(gen() % (2L * n), i);
+    probes.insert(batch, b);
+  }
+
+  long found = 0;
+  auto start = chrono::steady_clock::now();
+  for (int b = 0; b < batches; ++b)
+  {
+    const ArraySeq<long>& batch = *probes[b];
+    for (int i = 0; i < batch.size(); ++i)
+      found += map.contains(batch[i]);
+  }
+  double scalar_ms = elapsed_ms(start);
+
+  start = chrono::steady_clock::now();
+  for (int b = 0; b < batches; ++b)
+  {
+    ArraySeq<bool> result = map.contains_many(*probes[b]);
+    for (int i = 0; i < result.size(); ++i)
+      found += result[i];
+  }
+  double contains_many_ms = elapsed_ms(start);
+
+  start = chrono::steady_clock::now();
+  for (int b = 0; b < batches; ++b)
+  {
+    ArraySeq<long*> result = map.find_many(*probes[b]);
+    for (int i = 0; i < result.size(); ++i)
+      found += result[i] != nullptr;
+  }
+  double find_many_ms = elapsed_ms(start);
+
+  for (int b = 0; b < batches; ++b)
+    delete probes[b];
+
+  cout << "-- batch lookup, " << n << " keys, " << batches * batch_size
+       << " probes in batches of " << batch_size << endl;
+  cout << "contains loop " << scalar_ms << " ms, contains_many "
+       << contains_many_ms << " ms, find_many " << find_many_ms
+       << " ms (" << found << " found)" << endl;
+}
+
+
+//----------------------------------------------------------------------
+// Long string keys: insert, then three scans of hit and miss lookups.
+// Hashing and comparing a long key is what dominates, so this is where
+// the hash cached in each node pays off (during resizes, and by
+// skipping operator== on keys whose hashes differ).
+//----------------------------------------------------------------------
+
+// a 70 character key that only differs from its neighbors at the end
+string long_key(int i)
+{
+  return string(60, 'k') + to_string(1000000000 + i);
+}
+
+void string_bench(int n)
+{
+  ArraySeq<string> keys;
+  ArraySeq<string> misses;
+  for (int i = 0; i < n; ++i)
+  {
+    keys.insert(long_key(2 * i), i);
+    misses.insert(long_key(2 * i + 1), i);
+  }
+
+  HashMap<string,int> map;
+  auto start = chrono::steady_clock::now();
+  for (int i = 0; i < n; ++i)
+    map.insert(keys[i], i);
+  double insert_ms = elapsed_ms(start);
+
+  long found = 0;
+  start = chrono::steady_clock::now();
+  for (int pass = 0; pass < 3; ++pass)
+  {
+    for (int i = 0; i < n; ++i)
+    {
+      found += map.contains(keys[i]);
+      found += map.contains(misses[i]);
+    }
+  }
+  double scan_ms = elapsed_ms(start);
+
+  cout << "-- long string keys, " << n << " keys of " << keys[0].size()
+       << " chars" << endl;
+  cout << "insert " << insert_ms << " ms, 3x hit+miss scans " << scan_ms
+       << " ms (" << found << " found)" << endl;
+}
+
+
+//----------------------------------------------------------------------
+// Main
+//----------------------------------------------------------------------
+
+int main(int argc, char* argv[])
+{
+  int n = 1000000;
+  if (argc > 1)
+    n = atoi(argv[1]);
+
+  pool_bench(n);
+  batch_bench(16 * n);
+  string_bench(n);
+}
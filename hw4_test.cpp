@@ -3,14 +3,34 @@
 // FILE: hw4_test.cpp
 // DATE: Fall 2021
 // DESC: tests the merge sort and quick sort implementations
-//       on LinkedSeq and ArraySeq
+//       on LinkedSeq and ArraySeq, and the map implementations
 //---------------------------------------------------------------------------
 
+#include <cmath>
 #include <iostream>
+#include <map>
+#include <random>
 #include <string>
+#include <thread>
+#include <vector>
 #include <gtest/gtest.h>
 #include "linkedseq.h"
 #include "arrayseq.h"
+#include "arraymap.h"
+#include "linkedmap.h"
+#include "binsearchmap.h"
+#include "bstmap.h"
+#include "avlmap.h"
+#include "concurrenthashmap.h"
+#include "persistentavlmap.h"
+#include "hashmap.h"
+#include "robinhoodmap.h"
+#include "swissmap.h"
+#include "cuckoomap.h"
+#include "frozenmap.h"
+#include "bloommap.h"
+#include "lrucache.h"
+#include "shardedmap.h"
 
 using namespace std;
 
@@ -685,6 +705,2239 @@ TEST(BasicLinkedSeqTests, FuncitonalityAfterQuickSort)
 
 
 
+//----------------------------------------------------------------------
+// ArraySeq sort and Move Assignment Tests
+//----------------------------------------------------------------------
+
+TEST(BasicArraySeqTests, EmptySeqSort)
+{
+  ArraySeq<int> seq;
+  seq.sort();
+  ASSERT_EQ(true, seq.empty());
+}
+
+TEST(BasicArraySeqTests, OneElemSort)
+{
+  ArraySeq<int> seq;
+  seq.insert(7, 0);
+  seq.sort();
+  ASSERT_EQ(1, seq.size());
+  ASSERT_EQ(7, seq[0]);
+}
+
+TEST(BasicArraySeqTests, ManyElemSort)
+{
+  ArraySeq<int> seq;
+  int vals[] = {5, -3, 9, 0, 5, 12, -8, 1, 1, 30, 2};
+  for (int v : vals)
+    seq.insert(v, seq.size());
+  seq.sort();
+  ASSERT_EQ(11, seq.size());
+  for (int i = 1; i < seq.size(); ++i)
+    ASSERT_LE(seq[i-1], seq[i]);
+  ASSERT_EQ(-8, seq[0]);
+  ASSERT_EQ(30, seq[10]);
+
+  // already sorted and reversed input
+  ArraySeq<int> seq2;
+  for (int i = 0; i < 100; ++i)
+    seq2.insert(100 - i, i);
+  seq2.sort();
+  for (int i = 0; i < 100; ++i)
+    ASSERT_EQ(i + 1, seq2[i]);
+  seq2.sort();
+  for (int i = 0; i < 100; ++i)
+    ASSERT_EQ(i + 1, seq2[i]);
+}
+
+// element ordered by key only, tag records the original position
+struct SortItem {
+  int key;
+  int tag;
+  bool operator==(const SortItem& rhs) const { return key == rhs.key and tag == rhs.tag; }
+  bool operator<(const SortItem& rhs) const { return key < rhs.key; }
+  bool operator<=(const SortItem& rhs) const { return key <= rhs.key; }
+};
+
+TEST(BasicArraySeqTests, SortIsStable)
+{
+  ArraySeq<SortItem> seq;
+  int keys[] = {3, 1, 3, 2, 1, 3, 2, 1};
+  for (int i = 0; i < 8; ++i)
+    seq.insert(SortItem {keys[i], i}, i);
+  seq.sort();
+  // equal keys must keep their original (tag) order
+  for (int i = 1; i < seq.size(); ++i)
+  {
+    ASSERT_LE(seq[i-1].key, seq[i].key);
+    if (seq[i-1].key == seq[i].key)
+    {
+      ASSERT_LT(seq[i-1].tag, seq[i].tag);
+    }
+  }
+  ASSERT_EQ(1, seq[0].tag);
+  ASSERT_EQ(7, seq[2].tag);
+  ASSERT_EQ(5, seq[7].tag);
+}
+
+TEST(BasicArraySeqTests, MoveAssignment)
+{
+  ArraySeq<int> seq1;
+  ArraySeq<int> seq2;
+  for (int i = 0; i < 10; ++i)
+  {
+    seq1.insert(i, i);
+    seq2.insert(i * 10, i);
+  }
+  // the old array of seq1 is released (checked by the leak sanitizer)
+  // and the assignment returns seq1 itself
+  ArraySeq<int>& result = (seq1 = std::move(seq2));
+  ASSERT_EQ(&seq1, &result);
+  ASSERT_EQ(10, seq1.size());
+  for (int i = 0; i < 10; ++i)
+    ASSERT_EQ(i * 10, seq1[i]);
+  ASSERT_EQ(0, seq2.size());
+
+  // the moved-from sequence is still usable
+  seq2.insert(1, 0);
+  ASSERT_EQ(1, seq2[0]);
+
+  // chained assignment uses the returned reference
+  ArraySeq<int> seq3;
+  ArraySeq<int> seq4;
+  seq4 = (seq3 = std::move(seq1));
+  ASSERT_EQ(10, seq4.size());
+  ASSERT_EQ(90, seq4[9]);
+}
+
+
+//----------------------------------------------------------------------
+// Map find, insert_or_assign, and try_emplace Tests
+//----------------------------------------------------------------------
+
+// find returns a pointer to the value (usable to update it), or
+// nullptr if the key is missing
+template<typename M>
+void find_tests()
+{
+  M map;
+  ASSERT_EQ(nullptr, map.find(10));
+  map.insert(10, 100);
+  map.insert(20, 200);
+  map.insert(5, 50);
+  ASSERT_NE(nullptr, map.find(10));
+  ASSERT_EQ(100, *map.find(10));
+  ASSERT_EQ(200, *map.find(20));
+  ASSERT_EQ(50, *map.find(5));
+  ASSERT_EQ(nullptr, map.find(15));
+  *map.find(20) = 201;
+  ASSERT_EQ(201, map[20]);
+  const M& const_map = map;
+  ASSERT_EQ(201, *const_map.find(20));
+  ASSERT_EQ(nullptr, const_map.find(0));
+  map.erase(10);
+  ASSERT_EQ(nullptr, map.find(10));
+}
+
+// insert_or_assign adds missing keys and overwrites existing ones
+template<typename M>
+void insert_or_assign_tests()
+{
+  M map;
+  ASSERT_EQ(true, map.insert_or_assign(10, 100));
+  ASSERT_EQ(true, map.insert_or_assign(20, 200));
+  ASSERT_EQ(2, map.size());
+  ASSERT_EQ(false, map.insert_or_assign(10, 101));
+  ASSERT_EQ(2, map.size());
+  ASSERT_EQ(101, map[10]);
+  ASSERT_EQ(200, map[20]);
+  for (int i = 0; i < 50; ++i)
+    map.insert_or_assign(i, i * 2);
+  ASSERT_EQ(50, map.size());
+  for (int i = 0; i < 50; ++i)
+    ASSERT_EQ(i * 2, map[i]);
+}
+
+// try_emplace adds missing keys and leaves existing ones alone
+template<typename M>
+void try_emplace_tests()
+{
+  M map;
+  ASSERT_EQ(true, map.try_emplace(10, 100));
+  ASSERT_EQ(true, map.try_emplace(20, 200));
+  ASSERT_EQ(false, map.try_emplace(10, 101));
+  ASSERT_EQ(2, map.size());
+  ASSERT_EQ(100, map[10]);
+  for (int i = 0; i < 50; ++i)
+    map.try_emplace(i, i * 2);
+  ASSERT_EQ(50, map.size());
+  for (int i = 0; i < 50; ++i)
+  {
+    int expected = i * 2;
+    if (i == 10)
+      expected = 100;
+    else if (i == 20)
+      expected = 200;
+    ASSERT_EQ(expected, map[i]);
+  }
+}
+
+TEST(ArrayMapTests, Find) { find_tests<ArrayMap<int,int>>(); }
+TEST(ArrayMapTests, InsertOrAssign) { insert_or_assign_tests<ArrayMap<int,int>>(); }
+TEST(ArrayMapTests, TryEmplace) { try_emplace_tests<ArrayMap<int,int>>(); }
+
+TEST(LinkedMapTests, Find) { find_tests<LinkedMap<int,int>>(); }
+TEST(LinkedMapTests, InsertOrAssign) { insert_or_assign_tests<LinkedMap<int,int>>(); }
+TEST(LinkedMapTests, TryEmplace) { try_emplace_tests<LinkedMap<int,int>>(); }
+
+TEST(BinSearchMapTests, Find) { find_tests<BinSearchMap<int,int>>(); }
+TEST(BinSearchMapTests, InsertOrAssign) { insert_or_assign_tests<BinSearchMap<int,int>>(); }
+TEST(BinSearchMapTests, TryEmplace) { try_emplace_tests<BinSearchMap<int,int>>(); }
+
+TEST(BSTMapTests, Find) { find_tests<BSTMap<int,int>>(); }
+TEST(BSTMapTests, InsertOrAssign) { insert_or_assign_tests<BSTMap<int,int>>(); }
+TEST(BSTMapTests, TryEmplace) { try_emplace_tests<BSTMap<int,int>>(); }
+
+TEST(AVLMapTests, Find) { find_tests<AVLMap<int,int>>(); }
+TEST(AVLMapTests, InsertOrAssign) { insert_or_assign_tests<AVLMap<int,int>>(); }
+TEST(AVLMapTests, TryEmplace) { try_emplace_tests<AVLMap<int,int>>(); }
+
+TEST(HashMapTests, Find) { find_tests<HashMap<int,int>>(); }
+TEST(HashMapTests, InsertOrAssign) { insert_or_assign_tests<HashMap<int,int>>(); }
+TEST(HashMapTests, TryEmplace) { try_emplace_tests<HashMap<int,int>>(); }
+
+TEST(RobinHoodMapTests, Find) { find_tests<RobinHoodMap<int,int>>(); }
+TEST(RobinHoodMapTests, InsertOrAssign) { insert_or_assign_tests<RobinHoodMap<int,int>>(); }
+TEST(RobinHoodMapTests, TryEmplace) { try_emplace_tests<RobinHoodMap<int,int>>(); }
+
+TEST(SwissMapTests, Find) { find_tests<SwissMap<int,int>>(); }
+TEST(SwissMapTests, InsertOrAssign) { insert_or_assign_tests<SwissMap<int,int>>(); }
+TEST(SwissMapTests, TryEmplace) { try_emplace_tests<SwissMap<int,int>>(); }
+
+TEST(CuckooMapTests, Find) { find_tests<CuckooMap<int,int>>(); }
+TEST(CuckooMapTests, InsertOrAssign) { insert_or_assign_tests<CuckooMap<int,int>>(); }
+TEST(CuckooMapTests, TryEmplace) { try_emplace_tests<CuckooMap<int,int>>(); }
+
+// erasing nodes with two children must move the successor's key and
+// value into place and keep every other pair intact
+template<typename M>
+void two_child_erase_tests()
+{
+  M map;
+  int keys[] = {50, 30, 70, 20, 40, 60, 80, 35, 45, 65};
+  for (int k : keys)
+    map.insert(k, k * 10);
+
+  // 50 (the root) and 30 both have two children
+  map.erase(50);
+  map.erase(30);
+  ASSERT_EQ(8, map.size());
+  ASSERT_EQ(false, map.contains(50));
+  ASSERT_EQ(false, map.contains(30));
+  for (int k : keys)
+  {
+    if (k != 50 and k != 30)
+    {
+      ASSERT_EQ(k * 10, map[k]);
+    }
+  }
+
+  // keep erasing two-child nodes until none are left
+  map.erase(60);
+  map.erase(40);
+  for (int k : {20, 35, 45, 65, 70, 80})
+    ASSERT_EQ(k * 10, map[k]);
+  ArraySeq<int> sorted = map.sorted_keys();
+  ASSERT_EQ(6, sorted.size());
+  ASSERT_EQ(20, sorted[0]);
+  ASSERT_EQ(80, sorted[5]);
+}
+
+TEST(BSTMapTests, TwoChildErase) { two_child_erase_tests<BSTMap<int,int>>(); }
+TEST(AVLMapTests, TwoChildErase) { two_child_erase_tests<AVLMap<int,int>>(); }
+
+
+//----------------------------------------------------------------------
+// HashMap insert_range Tests
+//----------------------------------------------------------------------
+
+// building with four threads must give the same map as with one,
+// down to the order of every chain (and so the iteration order)
+TEST(HashMapTests, ThreadedInsertRange)
+{
+  ArraySeq<pair<int,int>> pairs;
+  for (int i = 0; i < 20000; ++i)
+    pairs.insert({i * 7919 % 1000003, i}, i);
+
+  HashMap<int,int> one;
+  HashMap<int,int> four;
+  for (int k = -5; k < 0; ++k)
+  {
+    one.insert(k, k);
+    four.insert(k, k);
+  }
+  one.insert_range(pairs, 1);
+  four.insert_range(pairs, 4);
+
+  ASSERT_EQ(20005, one.size());
+  ASSERT_EQ(one.size(), four.size());
+  for (int i = 0; i < pairs.size(); ++i)
+    ASSERT_EQ(i, four[pairs[i].first]);
+  for (int k = -5; k < 0; ++k)
+    ASSERT_EQ(k, four[k]);
+  ASSERT_EQ(false, four.contains(1000003));
+  auto it = one.begin();
+  for (int k : four)
+  {
+    ASSERT_EQ(*it, k);
+    ++it;
+  }
+  ASSERT_EQ(true, it == one.end());
+
+  // fewer pairs than threads falls back to one thread
+  HashMap<int,int> small;
+  ArraySeq<pair<int,int>> few;
+  few.insert({1, 10}, 0);
+  few.insert({2, 20}, 1);
+  small.insert_range(few, 4);
+  ASSERT_EQ(2, small.size());
+  ASSERT_EQ(20, small[2]);
+}
+
+
+//----------------------------------------------------------------------
+// AVLMap Invariant Tests
+//----------------------------------------------------------------------
+
+// the AVL height bound for n keys
+bool avl_height_ok(int height, int n)
+{
+  return height <= 1.44 * log2(n + 2);
+}
+
+// the map and the reference hold the same pairs, in the same order
+void same_as_reference(const AVLMap<int,int>& map, const std::map<int,int>& ref)
+{
+  ASSERT_EQ((int) ref.size(), map.size());
+  ArraySeq<int> keys = map.sorted_keys();
+  ASSERT_EQ((int) ref.size(), keys.size());
+  int i = 0;
+  for (const auto& p : ref)
+  {
+    ASSERT_EQ(p.first, keys[i]);
+    ASSERT_EQ(p.second, map[p.first]);
+    ++i;
+  }
+}
+
+// random inserts and erases, checking after each step that the tree
+// is ordered and balanced and its size fields are right
+TEST(AVLMapTests, RandomInsertEraseInvariants)
+{
+  mt19937 gen(18);
+  AVLMap<int,int> map;
+  std::map<int,int> ref;
+  for (int step = 0; step < 20000; ++step)
+  {
+    int key = gen() % 1000;
+    if (ref.count(key) == 0 and gen() % 3 != 0)
+    {
+      map.insert(key, step);
+      ref[key] = step;
+    }
+    else if (ref.count(key) == 1)
+    {
+      map.erase(key);
+      ref.erase(key);
+    }
+    ASSERT_EQ(true, map.is_valid());
+    ASSERT_EQ(true, avl_height_ok(map.height(), map.size()));
+    if (step % 1000 == 0)
+      same_as_reference(map, ref);
+  }
+  same_as_reference(map, ref);
+
+  // drain it
+  while (!ref.empty())
+  {
+    map.erase(ref.begin()->first);
+    ref.erase(ref.begin());
+    ASSERT_EQ(true, map.is_valid());
+  }
+  ASSERT_EQ(0, map.height());
+}
+
+// ascending inserts are the worst case for an unbalanced tree, and
+// the bulk-loading constructor builds the tree directly
+TEST(AVLMapTests, SortedAndBulkLoadInvariants)
+{
+  AVLMap<int,int> map;
+  std::map<int,int> ref;
+  for (int i = 0; i < 5000; ++i)
+  {
+    map.insert(i, -i);
+    ref[i] = -i;
+  }
+  ASSERT_EQ(true, map.is_valid());
+  ASSERT_EQ(true, avl_height_ok(map.height(), map.size()));
+  same_as_reference(map, ref);
+
+  ArraySeq<pair<int,int>> pairs;
+  for (int i = 0; i < 10000; ++i)
+    pairs.insert({2 * i, i}, i);
+  for (int threads : {1, 4})
+  {
+    AVLMap<int,int> loaded(pairs, threads);
+    ASSERT_EQ(true, loaded.is_valid());
+    ASSERT_EQ(true, avl_height_ok(loaded.height(), loaded.size()));
+    for (int i = 0; i < 10000; i += 3)
+      loaded.erase(2 * i);
+    loaded.insert(1, 1);
+    ASSERT_EQ(true, loaded.is_valid());
+  }
+}
+
+
+//----------------------------------------------------------------------
+// AVLMap rank, select, and count_range Tests
+//----------------------------------------------------------------------
+
+// select and rank are inverses, and select matches sorted order
+TEST(AVLMapTests, RankSelect)
+{
+  mt19937 gen(21);
+  AVLMap<int,int> map;
+  for (int i = 0; i < 3000; ++i)
+  {
+    int key = gen() % 100000;
+    if (!map.contains(key))
+      map.insert(key, i);
+  }
+  for (int i = 0; i < 500; ++i)
+  {
+    int key = gen() % 100000;
+    if (map.contains(key))
+      map.erase(key);
+  }
+  ArraySeq<int> keys = map.sorted_keys();
+  for (int i = 0; i < map.size(); ++i)
+  {
+    ASSERT_EQ(keys[i], map.select(i));
+    ASSERT_EQ(i, map.rank(map.select(i)));
+  }
+  // rank of a missing key counts the keys below it
+  ASSERT_EQ(0, map.rank(-1));
+  ASSERT_EQ(map.size(), map.rank(100000));
+}
+
+TEST(AVLMapTests, SelectOutOfRange)
+{
+  AVLMap<int,int> map;
+  ASSERT_THROW(map.select(0), out_of_range);
+  for (int i = 0; i < 10; ++i)
+    map.insert(i, i);
+  ASSERT_THROW(map.select(-1), out_of_range);
+  ASSERT_THROW(map.select(10), out_of_range);
+  ASSERT_EQ(9, map.select(9));
+}
+
+// count_range agrees with find_keys on random ranges, including
+// empty and reversed ones
+TEST(AVLMapTests, CountRange)
+{
+  mt19937 gen(12);
+  AVLMap<int,int> map;
+  for (int i = 0; i < 2000; ++i)
+  {
+    int key = gen() % 10000;
+    if (!map.contains(key))
+      map.insert(key, i);
+  }
+  for (int i = 0; i < 1000; ++i)
+  {
+    int k1 = int(gen() % 10200) - 100;
+    int k2 = k1 + int(gen() % 500) - 50;
+    ASSERT_EQ(map.find_keys(k1, k2).size(), map.count_range(k1, k2));
+  }
+  ASSERT_EQ(map.size(), map.count_range(-1, 10000));
+  AVLMap<int,int> empty;
+  ASSERT_EQ(0, empty.count_range(0, 10));
+}
+
+
+//----------------------------------------------------------------------
+// Map Iterator and Range Tests
+//----------------------------------------------------------------------
+
+// the iterators walk the keys in order with their values, the bounds
+// land on the right keys (present, missing, and off either end), and
+// range() gives the keys of find_keys
+template<typename M>
+void ordered_iterator_tests()
+{
+  M empty;
+  ASSERT_EQ(true, empty.begin() == empty.end());
+  ASSERT_EQ(true, empty.lower_bound(5) == empty.end());
+  ASSERT_EQ(true, empty.range(0, 10).empty());
+
+  // even keys 0..98, inserted out of order
+  M map;
+  for (int i = 0; i < 50; ++i)
+    map.insert(i * 37 % 50 * 2, i);
+  int expected = 0;
+  for (auto it = map.begin(); it != map.end(); ++it)
+  {
+    ASSERT_EQ(expected, *it);
+    ASSERT_EQ(map[expected], it.value());
+    expected += 2;
+  }
+  ASSERT_EQ(100, expected);
+
+  ASSERT_EQ(10, *map.lower_bound(10));
+  ASSERT_EQ(12, *map.upper_bound(10));
+  ASSERT_EQ(12, *map.lower_bound(11));
+  ASSERT_EQ(12, *map.upper_bound(11));
+  ASSERT_EQ(0, *map.lower_bound(-5));
+  ASSERT_EQ(true, map.lower_bound(99) == map.end());
+  ASSERT_EQ(true, map.upper_bound(98) == map.end());
+
+  // post-increment returns the old position
+  auto it = map.lower_bound(40);
+  auto old = it++;
+  ASSERT_EQ(40, *old);
+  ASSERT_EQ(42, *it);
+
+  int ranges[][2] = {{10, 20}, {11, 19}, {-10, 4}, {95, 200}, {13, 13}, {14, 14}, {20, 10}};
+  for (auto& r : ranges)
+  {
+    ArraySeq<int> keys = map.find_keys(r[0], r[1]);
+    int i = 0;
+    for (int k : map.range(r[0], r[1]))
+    {
+      ASSERT_EQ(true, i < keys.size());
+      ASSERT_EQ(keys[i], k);
+      ++i;
+    }
+    ASSERT_EQ(keys.size(), i);
+  }
+}
+
+TEST(BinSearchMapTests, IteratorsAndRanges) { ordered_iterator_tests<BinSearchMap<int,int>>(); }
+TEST(BSTMapTests, IteratorsAndRanges) { ordered_iterator_tests<BSTMap<int,int>>(); }
+TEST(AVLMapTests, IteratorsAndRanges) { ordered_iterator_tests<AVLMap<int,int>>(); }
+
+// descending inserts give a BST that is one chain of left children,
+// where every step used to search down from the root again
+TEST(BSTMapTests, IteratorOnDegenerateTree)
+{
+  BSTMap<int,int> map;
+  for (int i = 4999; i >= 0; --i)
+    map.insert(i, i);
+  int expected = 0;
+  for (int k : map)
+  {
+    ASSERT_EQ(expected, k);
+    ++expected;
+  }
+  ASSERT_EQ(5000, expected);
+  int i = 0;
+  for (int k : map.range(4990, 9000))
+  {
+    ASSERT_EQ(4990 + i, k);
+    ++i;
+  }
+  ASSERT_EQ(10, i);
+}
+
+// every key is visited once with its value, including in the middle
+// of an incremental resize
+TEST(HashMapTests, Iterator)
+{
+  HashMap<int,int> empty;
+  ASSERT_EQ(true, empty.begin() == empty.end());
+
+  for (bool incremental : {false, true})
+  {
+    HashMap<int,int> map;
+    map.incremental_resize(incremental);
+    for (int i = 0; i < 1000; ++i)
+      map.insert(i, -i);
+    ArraySeq<int> seen;
+    for (int i = 0; i < 1000; ++i)
+      seen.insert(0, i);
+    int visited = 0;
+    for (auto it = map.begin(); it != map.end(); ++it)
+    {
+      ASSERT_EQ(-*it, it.value());
+      seen[*it]++;
+      ++visited;
+    }
+    ASSERT_EQ(1000, visited);
+    for (int i = 0; i < 1000; ++i)
+      ASSERT_EQ(1, seen[i]);
+  }
+}
+
+
+//----------------------------------------------------------------------
+// AVLMap join and Set Operation Tests
+//----------------------------------------------------------------------
+
+// fills the map and its reference with n random keys below range,
+// each valued key * 10 + tag
+void random_avl(AVLMap<int,int>& map, std::map<int,int>& ref, mt19937& gen,
+                int n, int range, int tag)
+{
+  for (int i = 0; i < n; ++i)
+  {
+    int key = gen() % range;
+    if (map.try_emplace(key, key * 10 + tag))
+      ref[key] = key * 10 + tag;
+  }
+}
+
+// the result matches the reference and is balanced, and rhs was
+// left empty (and still usable)
+void check_set_result(const AVLMap<int,int>& map, const std::map<int,int>& expected,
+                      AVLMap<int,int>& rhs)
+{
+  ASSERT_EQ(true, map.is_valid());
+  ASSERT_EQ(true, avl_height_ok(map.height(), map.size()));
+  same_as_reference(map, expected);
+  ASSERT_EQ(0, rhs.size());
+  ASSERT_EQ(true, rhs.begin() == rhs.end());
+  rhs.insert(1, 1);
+  ASSERT_EQ(1, rhs.size());
+}
+
+// op 0 is union_with, 1 intersect_with, 2 difference_with. Sizes
+// range from small to well past the size where threads split the
+// work, and the key ranges from dense overlap to sparse.
+void set_operation_tests(int op, int threads)
+{
+  mt19937 gen(24 + op);
+  int sizes[][2] = {{0, 100}, {100, 0}, {3000, 3000}, {20000, 500}, {500, 20000}, {10000, 10000}};
+  for (auto& sz : sizes)
+  {
+    for (int range : {4000, 1000000})
+    {
+      AVLMap<int,int> lhs;
+      AVLMap<int,int> rhs;
+      std::map<int,int> lref;
+      std::map<int,int> rref;
+      random_avl(lhs, lref, gen, sz[0], range, 1);
+      random_avl(rhs, rref, gen, sz[1], range, 2);
+
+      std::map<int,int> expected;
+      if (op == 0)
+      {
+        expected = lref;
+        for (const auto& p : rref)
+          expected.insert(p);
+        lhs.union_with(std::move(rhs), threads);
+      }
+      else if (op == 1)
+      {
+        for (const auto& p : lref)
+        {
+          if (rref.count(p.first) == 1)
+            expected.insert(p);
+        }
+        lhs.intersect_with(std::move(rhs), threads);
+      }
+      else
+      {
+        for (const auto& p : lref)
+        {
+          if (rref.count(p.first) == 0)
+            expected.insert(p);
+        }
+        lhs.difference_with(std::move(rhs), threads);
+      }
+      check_set_result(lhs, expected, rhs);
+    }
+  }
+}
+
+TEST(AVLMapTests, UnionWith) { set_operation_tests(0, 1); }
+TEST(AVLMapTests, UnionWithThreads) { set_operation_tests(0, 4); }
+TEST(AVLMapTests, IntersectWith) { set_operation_tests(1, 1); }
+TEST(AVLMapTests, IntersectWithThreads) { set_operation_tests(1, 4); }
+TEST(AVLMapTests, DifferenceWith) { set_operation_tests(2, 1); }
+TEST(AVLMapTests, DifferenceWithThreads) { set_operation_tests(2, 4); }
+
+TEST(AVLMapTests, SetOperationsWithSelf)
+{
+  AVLMap<int,int> map;
+  for (int i = 0; i < 100; ++i)
+    map.insert(i, i);
+  map.union_with(std::move(map));
+  ASSERT_EQ(100, map.size());
+  map.intersect_with(std::move(map));
+  ASSERT_EQ(100, map.size());
+  map.difference_with(std::move(map));
+  ASSERT_EQ(0, map.size());
+}
+
+TEST(AVLMapTests, Join)
+{
+  mt19937 gen(124);
+  for (int round = 0; round < 20; ++round)
+  {
+    // lopsided sizes make join walk down the taller side
+    AVLMap<int,int> left;
+    AVLMap<int,int> right;
+    std::map<int,int> expected;
+    random_avl(left, expected, gen, round % 2 == 0 ? 5000 : 20, 100000, 1);
+    std::map<int,int> rref;
+    random_avl(right, rref, gen, round % 3 == 0 ? 30 : 5000, 100000, 2);
+    for (const auto& p : rref)
+      expected[p.first + 200001] = p.second;
+    AVLMap<int,int> shifted;
+    for (const auto& p : rref)
+      shifted.insert(p.first + 200001, p.second);
+
+    AVLMap<int,int> map;
+    map.insert(-1, -1);
+    map.join(std::move(left), 150000, 7, std::move(shifted));
+    expected[150000] = 7;
+    check_set_result(map, expected, left);
+    ASSERT_EQ(0, shifted.size());
+
+    // the map itself may be one side
+    AVLMap<int,int> more;
+    more.insert(999999, 9);
+    map.join(std::move(map), 500000, 5, std::move(more));
+    expected[500000] = 5;
+    expected[999999] = 9;
+    check_set_result(map, expected, more);
+  }
+}
+
+TEST(AVLMapTests, JoinOverlappingRanges)
+{
+  AVLMap<int,int> map;
+  AVLMap<int,int> left;
+  AVLMap<int,int> right;
+  left.insert(5, 5);
+  right.insert(3, 3);
+  ASSERT_THROW(map.join(std::move(left), 4, 4, std::move(right)), invalid_argument);
+  ASSERT_THROW(map.join(std::move(left), 5, 4, std::move(right)), invalid_argument);
+  ASSERT_THROW(map.join(std::move(right), 2, 4, std::move(left)), invalid_argument);
+  ASSERT_THROW(map.join(std::move(left), 7, 7, std::move(left)), invalid_argument);
+  // nothing moved
+  ASSERT_EQ(1, left.size());
+  ASSERT_EQ(1, right.size());
+  ASSERT_EQ(0, map.size());
+
+  map.join(std::move(right), 4, 4, std::move(left));
+  ASSERT_EQ(3, map.size());
+  ASSERT_EQ(true, map.is_valid());
+}
+
+
+//----------------------------------------------------------------------
+// PersistentAVLMap Snapshot Tests
+//----------------------------------------------------------------------
+
+// the version holds exactly the pairs of the reference
+void same_as_reference(const PersistentAVLMap<int,int>& map, const std::map<int,int>& ref)
+{
+  ASSERT_EQ((int) ref.size(), map.size());
+  ArraySeq<int> keys = map.sorted_keys();
+  ASSERT_EQ((int) ref.size(), keys.size());
+  int i = 0;
+  for (const auto& p : ref)
+  {
+    ASSERT_EQ(p.first, keys[i]);
+    ASSERT_EQ(p.second, map[p.first]);
+    ++i;
+  }
+  ASSERT_EQ(true, avl_height_ok(map.height(), map.size()));
+}
+
+// snapshots taken along a random sequence of insert, erase, and
+// operator[] writes keep their contents while the map moves on
+TEST(PersistentAVLMapTests, SnapshotsKeepOldContents)
+{
+  mt19937 gen(25);
+  PersistentAVLMap<int,int> map;
+  std::map<int,int> ref;
+  // (ArraySeq needs ==, which maps do not have)
+  vector<PersistentAVLMap<int,int>> snapshots;
+  vector<std::map<int,int>> expected;
+  for (int step = 0; step < 6000; ++step)
+  {
+    int key = gen() % 500;
+    int action = gen() % 3;
+    if (ref.count(key) == 0)
+    {
+      map.insert(key, step);
+      ref[key] = step;
+    }
+    else if (action == 0)
+    {
+      map.erase(key);
+      ref.erase(key);
+    }
+    else if (action == 1)
+    {
+      map[key] = -step;
+      ref[key] = -step;
+    }
+    else
+    {
+      map.insert_or_assign(key, step);
+      ref[key] = step;
+    }
+    if (step % 200 == 0)
+    {
+      snapshots.push_back(map.snapshot());
+      expected.push_back(ref);
+    }
+  }
+  same_as_reference(map, ref);
+  for (int i = 0; i < (int) snapshots.size(); ++i)
+    same_as_reference(snapshots[i], expected[i]);
+
+  // changing a snapshot leaves the map and the other snapshots alone
+  snapshots[3].insert(1000, 1);
+  snapshots[3][1000] = 2;
+  ASSERT_EQ(false, map.contains(1000));
+  ASSERT_EQ(false, snapshots[4].contains(1000));
+  same_as_reference(snapshots[2], expected[2]);
+
+  // dropping the map keeps every snapshot intact
+  map = PersistentAVLMap<int,int>();
+  ASSERT_EQ(0, map.size());
+  for (int i = 0; i < (int) snapshots.size(); ++i)
+  {
+    if (i != 3)
+      same_as_reference(snapshots[i], expected[i]);
+  }
+}
+
+TEST(PersistentAVLMapTests, CopyAndMoveAssignment)
+{
+  PersistentAVLMap<int,int> map;
+  std::map<int,int> ref;
+  for (int i = 0; i < 100; ++i)
+  {
+    map.insert(i, i);
+    ref[i] = i;
+  }
+
+  // self-assignment (through a reference so it is not flagged)
+  PersistentAVLMap<int,int>& alias = map;
+  map = alias;
+  same_as_reference(map, ref);
+  map = std::move(alias);
+  same_as_reference(map, ref);
+
+  // a moved-to map takes over the version, the moved-from one is empty
+  PersistentAVLMap<int,int> snap = map.snapshot();
+  PersistentAVLMap<int,int> moved(std::move(snap));
+  ASSERT_EQ(0, snap.size());
+  ASSERT_EQ(true, snap.empty());
+  map.erase(50);
+  map[10] = -10;
+  same_as_reference(moved, ref);
+
+  // move assignment releases the old contents and keeps the version
+  PersistentAVLMap<int,int> other;
+  other.insert(-1, -1);
+  PersistentAVLMap<int,int> before = map.snapshot();
+  other = std::move(before);
+  ASSERT_EQ(0, before.size());
+  map.insert(500, 500);
+  ASSERT_EQ(false, other.contains(500));
+  ASSERT_EQ(false, other.contains(-1));
+  ASSERT_EQ(99, other.size());
+  ASSERT_EQ(-10, other[10]);
+
+  // copy assignment shares, then the two diverge
+  PersistentAVLMap<int,int> copy;
+  copy = moved;
+  copy.erase(0);
+  ASSERT_EQ(true, moved.contains(0));
+  same_as_reference(moved, ref);
+
+  // moved-from maps are still usable
+  snap.insert(7, 7);
+  ASSERT_EQ(1, snap.size());
+}
+
+
+//----------------------------------------------------------------------
+// Open Addressing Erase Tests
+//----------------------------------------------------------------------
+
+// the map holds exactly the pairs of the reference
+template<typename M>
+void same_pairs(const M& map, const std::map<int,int>& ref)
+{
+  ASSERT_EQ((int) ref.size(), map.size());
+  ArraySeq<int> keys = map.sorted_keys();
+  ASSERT_EQ((int) ref.size(), keys.size());
+  int i = 0;
+  for (const auto& p : ref)
+  {
+    ASSERT_EQ(p.first, keys[i]);
+    ASSERT_EQ(p.second, map[p.first]);
+    ++i;
+  }
+}
+
+// random erase-heavy churn against a reference: the map grows, is
+// mostly emptied, and then churns at a steady size so erased slots
+// are reused over and over
+template<typename M>
+void erase_heavy_tests(int seed)
+{
+  mt19937 gen(seed);
+  M map;
+  std::map<int,int> ref;
+  for (int phase = 0; phase < 3; ++phase)
+  {
+    // percent of steps that erase: grow, drain, then hold steady
+    int erase_percent = phase == 0 ? 30 : (phase == 1 ? 80 : 50);
+    for (int step = 0; step < 20000; ++step)
+    {
+      int key = gen() % 5000;
+      bool erase = int(gen() % 100) < erase_percent;
+      if (erase and ref.count(key) == 1)
+      {
+        map.erase(key);
+        ref.erase(key);
+        ASSERT_EQ(false, map.contains(key));
+      }
+      else if (!erase and ref.count(key) == 0)
+      {
+        if (step % 2 == 0)
+          map.insert(key, step);
+        else
+          ASSERT_EQ(true, map.try_emplace(key, step));
+        ref[key] = step;
+      }
+      else if (!erase)
+      {
+        ASSERT_EQ(false, map.insert_or_assign(key, -step));
+        ref[key] = -step;
+      }
+      else
+      {
+        ASSERT_THROW(map.erase(key), out_of_range);
+      }
+      if (step % 2000 == 0)
+        same_pairs(map, ref);
+    }
+    same_pairs(map, ref);
+  }
+
+  // every key that is not in the reference must be missing
+  for (int key = 0; key < 5000; ++key)
+    ASSERT_EQ(ref.count(key) == 1, map.contains(key));
+
+  // and erasing everything leaves an empty, reusable map
+  while (!ref.empty())
+  {
+    map.erase(ref.begin()->first);
+    ref.erase(ref.begin());
+  }
+  ASSERT_EQ(0, map.size());
+  ASSERT_EQ(0, map.max_chain_length());
+  map.insert(42, 42);
+  ASSERT_EQ(42, map[42]);
+}
+
+TEST(RobinHoodMapTests, EraseHeavy) { erase_heavy_tests<RobinHoodMap<int,int>>(1); }
+
+// backward-shift erase must close every gap, so a key whose probe run
+// passed through an erased slot is still found
+TEST(RobinHoodMapTests, BackwardShiftKeepsRuns)
+{
+  RobinHoodMap<int,int> map;
+  for (int i = 0; i < 600; ++i)
+    map.insert(i, i);
+  for (int i = 0; i < 600; i += 3)
+    map.erase(i);
+  for (int i = 0; i < 600; ++i)
+  {
+    if (i % 3 == 0)
+    {
+      ASSERT_EQ(false, map.contains(i));
+    }
+    else
+    {
+      ASSERT_EQ(i, map[i]);
+    }
+  }
+  ASSERT_EQ(400, map.size());
+}
+
+
+TEST(SwissMapTests, EraseHeavy) { erase_heavy_tests<SwissMap<int,int>>(2); }
+
+// sends every key to the same group and tag, so groups fill up,
+// erases leave tombstones, and churn at a steady size triggers the
+// same-capacity rehash that clears them
+struct CollidingHash {
+  int seed = 7;
+  size_t operator()(int) const { return seed; }
+};
+
+TEST(SwissMapTests, TombstonesAndInPlaceRehash)
+{
+  mt19937 gen(3);
+  SwissMap<int,int,CollidingHash> map;
+  std::map<int,int> ref;
+  // 112 keys fill seven of the eight groups of a 128 slot table
+  // (the 7/8 load limit), so erasing leaves tombstones
+  for (int i = 0; i < 112; ++i)
+  {
+    map.insert(i, i);
+    ref[i] = i;
+  }
+  for (int i = 0; i < 112; i += 2)
+  {
+    map.erase(i);
+    ref.erase(i);
+  }
+  same_pairs(map, ref);
+
+  // the table is at its limit but half empty, so this insert rehashes
+  // in place instead of growing
+  map.insert(1000, 1000);
+  ref[1000] = 1000;
+  same_pairs(map, ref);
+
+  // hold the size near 50 while keys come and go
+  for (int step = 0; step < 3000; ++step)
+  {
+    int key = gen() % 200;
+    if (ref.count(key) == 1)
+    {
+      map.erase(key);
+      ref.erase(key);
+    }
+    else if (ref.size() < 60)
+    {
+      ASSERT_EQ(true, map.try_emplace(key, step));
+      ref[key] = step;
+    }
+    if (step % 100 == 0)
+      same_pairs(map, ref);
+  }
+  same_pairs(map, ref);
+  for (int key = 0; key < 200; ++key)
+    ASSERT_EQ(ref.count(key) == 1, map.contains(key));
+
+  // copies and moves keep the hasher
+  SwissMap<int,int,CollidingHash> copy(map);
+  same_pairs(copy, ref);
+  SwissMap<int,int,CollidingHash> moved(std::move(copy));
+  same_pairs(moved, ref);
+  ASSERT_EQ(0, copy.size());
+}
+
+
+//----------------------------------------------------------------------
+// HashMap Incremental Resize Tests
+//----------------------------------------------------------------------
+
+// puts the map in the middle of an incremental resize, with keys 0
+// up to n - 1 valued -key
+void start_resize(HashMap<int,int>& map, std::map<int,int>& ref, int n)
+{
+  map.incremental_resize(true);
+  for (int i = 0; i < n; ++i)
+  {
+    map.insert(i, -i);
+    ref[i] = -i;
+  }
+  ASSERT_EQ(true, map.resizing());
+}
+
+// const lookups must see the keys in both tables without moving any
+TEST(HashMapTests, ConstLookupsMidResize)
+{
+  HashMap<int,int> map;
+  std::map<int,int> ref;
+  start_resize(map, ref, 1000);
+  const HashMap<int,int>& cmap = map;
+  for (int i = 0; i < 1000; ++i)
+  {
+    ASSERT_EQ(true, cmap.contains(i));
+    ASSERT_EQ(-i, cmap[i]);
+    ASSERT_EQ(-i, *cmap.find(i));
+  }
+  ASSERT_EQ(false, cmap.contains(1000));
+  ASSERT_EQ(nullptr, cmap.find(-1));
+  ASSERT_EQ(100, cmap.find_keys(100, 199).size());
+  same_pairs(cmap, ref);
+  ASSERT_EQ(true, map.resizing());
+}
+
+// inserts and erases keep working while buckets move, until the old
+// table is drained
+TEST(HashMapTests, UpdatesMidResize)
+{
+  HashMap<int,int> map;
+  std::map<int,int> ref;
+  start_resize(map, ref, 1000);
+  int step = 0;
+  while (map.resizing())
+  {
+    if (step % 3 == 0)
+    {
+      map.erase(step);
+      ref.erase(step);
+    }
+    else
+    {
+      map.insert(5000 + step, step);
+      ref[5000 + step] = step;
+    }
+    ASSERT_EQ((int) ref.size(), map.size());
+    ++step;
+  }
+  ASSERT_EQ(true, step > 1);
+  same_pairs(map, ref);
+  for (const auto& p : ref)
+    ASSERT_EQ(p.second, *map.find(p.first));
+}
+
+// a copy taken mid-resize holds every pair and is independent
+TEST(HashMapTests, CopyMidResize)
+{
+  HashMap<int,int> map;
+  std::map<int,int> ref;
+  start_resize(map, ref, 1000);
+  HashMap<int,int> copy(map);
+  same_pairs(copy, ref);
+  HashMap<int,int> assigned;
+  assigned.insert(-5, 5);
+  assigned = map;
+  same_pairs(assigned, ref);
+
+  map.erase(10);
+  map[11] = 99;
+  copy.insert(2000, 1);
+  ASSERT_EQ(true, copy.contains(10));
+  ASSERT_EQ(-11, copy[11]);
+  ASSERT_EQ(false, map.contains(2000));
+  same_pairs(assigned, ref);
+}
+
+// turning the mode off finishes the pending resize at once
+TEST(HashMapTests, DisableIncrementalMidResize)
+{
+  HashMap<int,int> map;
+  std::map<int,int> ref;
+  start_resize(map, ref, 1000);
+  map.incremental_resize(false);
+  ASSERT_EQ(false, map.resizing());
+  same_pairs(map, ref);
+
+  // and later resizes happen all at once
+  for (int i = 1000; i < 5000; ++i)
+  {
+    map.insert(i, -i);
+    ref[i] = -i;
+    ASSERT_EQ(false, map.resizing());
+  }
+  same_pairs(map, ref);
+}
+
+
+//----------------------------------------------------------------------
+// HashMap Move Tests
+//----------------------------------------------------------------------
+
+// a moved-from map with an ordered index must not keep answering
+// range queries from the index of the keys it gave away
+void moved_from_ordered_checks(HashMap<int,int>& from, HashMap<int,int>& to)
+{
+  ASSERT_EQ(0, from.size());
+  ASSERT_EQ(0, from.sorted_keys().size());
+  ASSERT_EQ(0, from.find_keys(0, 10).size());
+  ASSERT_EQ(false, from.contains(2));
+
+  // still usable, and its index follows its new keys
+  from.insert(7, 7);
+  ArraySeq<int> keys = from.sorted_keys();
+  ASSERT_EQ(1, keys.size());
+  ASSERT_EQ(7, keys[0]);
+
+  keys = to.sorted_keys();
+  ASSERT_EQ(5, keys.size());
+  for (int i = 0; i < 5; ++i)
+    ASSERT_EQ(i, keys[i]);
+  to.insert(-1, -1);
+  ASSERT_EQ(-1, to.sorted_keys()[0]);
+  ASSERT_EQ(3, to.find_keys(-1, 1).size());
+}
+
+TEST(HashMapTests, MoveConstructOrdered)
+{
+  HashMap<int,int> map;
+  map.ordered_index(true);
+  for (int i = 0; i < 5; ++i)
+    map.insert(i, i);
+  ASSERT_EQ(5, map.sorted_keys().size());
+  HashMap<int,int> moved(std::move(map));
+  moved_from_ordered_checks(map, moved);
+}
+
+TEST(HashMapTests, MoveAssignOrdered)
+{
+  HashMap<int,int> map;
+  map.ordered_index(true);
+  for (int i = 0; i < 5; ++i)
+    map.insert(i, i);
+  ASSERT_EQ(5, map.sorted_keys().size());
+  HashMap<int,int> moved;
+  moved.ordered_index(true);
+  moved.insert(100, 100);
+  ASSERT_EQ(1, moved.sorted_keys().size());
+  moved = std::move(map);
+  moved_from_ordered_checks(map, moved);
+  ASSERT_EQ(false, moved.contains(100));
+}
+
+
+//----------------------------------------------------------------------
+// ConcurrentHashMap Tests
+//----------------------------------------------------------------------
+
+// Four threads each insert, find, and erase their own keys while all
+// of them race to add the same shared keys. The map starts at 64
+// buckets, so all of this runs across many resizes.
+TEST(ConcurrentHashMapTests, DisjointAndSharedKeys)
+{
+  const int threads = 4;
+  const int own = 5000;
+  const int shared = 2000;
+  ConcurrentHashMap<int,int> map;
+  vector<thread> workers;
+  vector<int> bad(threads, 0);
+  for (int t = 0; t < threads; ++t)
+  {
+    workers.push_back(thread([&map, &bad, t, own, shared]() {
+      for (int i = 0; i < own; ++i)
+      {
+        int key = 100000 * (t + 1) + i;
+        map.insert(key, i);
+        int value = -1;
+        if (!map.find(key, value) or value != i)
+          bad[t]++;
+        if (i % 3 == 0)
+          map.erase(key);
+        else if (i % 3 == 1)
+          map.insert_or_assign(key, -i);
+
+        // every thread adds the shared keys, only the first one wins
+        int s = (i * 7 + t) % shared;
+        map.try_emplace(s, s * 10 + t);
+        map.contains(100000 * ((t + 1) % threads + 1) + i);
+      }
+    }));
+  }
+  for (thread& w : workers)
+    w.join();
+
+  for (int t = 0; t < threads; ++t)
+    ASSERT_EQ(0, bad[t]);
+  int own_left = own - (own + 2) / 3;
+  ASSERT_EQ(threads * own_left + shared, map.size());
+  for (int t = 0; t < threads; ++t)
+  {
+    for (int i = 0; i < own; ++i)
+    {
+      int key = 100000 * (t + 1) + i;
+      int value = 0;
+      if (i % 3 == 0)
+      {
+        ASSERT_EQ(false, map.find(key, value));
+      }
+      else
+      {
+        ASSERT_EQ(true, map.find(key, value));
+        ASSERT_EQ(i % 3 == 1 ? -i : i, value);
+      }
+    }
+  }
+  for (int s = 0; s < shared; ++s)
+  {
+    int value = 0;
+    ASSERT_EQ(true, map.find(s, value));
+    ASSERT_EQ(s, value / 10);
+  }
+
+  // erasing a missing key still throws
+  ASSERT_THROW(map.erase(100000), out_of_range);
+}
+
+
+//----------------------------------------------------------------------
+// CuckooMap Tests
+//----------------------------------------------------------------------
+
+// keys whose mixed hashes put both candidate buckets at bucket 0 of
+// a 4-bucket table, but which spread out once the table grows
+ArraySeq<int> bucket_zero_keys(int n)
+{
+  ArraySeq<int> keys;
+  for (int key = 0; keys.size() < n; ++key)
+  {
+    std::size_t h = mix_hash(std::hash<int>()(key));
+    if ((h & 3) == 0 and ((h >> 32) & 3) == 0)
+      keys.insert(key, keys.size());
+  }
+  return keys;
+}
+
+TEST(CuckooMapTests, RandomAgainstReference)
+{
+  mt19937 gen(4);
+  CuckooMap<int,int> map;
+  std::map<int,int> ref;
+  for (int step = 0; step < 100000; ++step)
+  {
+    int key = gen() % 20000;
+    int op = gen() % 4;
+    if (op == 0 and ref.count(key) == 1)
+    {
+      map.erase(key);
+      ref.erase(key);
+      ASSERT_EQ(false, map.contains(key));
+    }
+    else if (op == 0)
+    {
+      ASSERT_THROW(map.erase(key), out_of_range);
+    }
+    else if (op == 1 and ref.count(key) == 0)
+    {
+      map.insert(key, step);
+      ref[key] = step;
+    }
+    else if (op == 1)
+    {
+      ASSERT_EQ(false, map.try_emplace(key, -1));
+    }
+    else if (op == 2)
+    {
+      ASSERT_EQ(ref.count(key) == 0, map.insert_or_assign(key, step));
+      ref[key] = step;
+    }
+    else
+    {
+      const int* value = map.find(key);
+      ASSERT_EQ(ref.count(key) == 1, value != nullptr);
+      if (value != nullptr)
+      {
+        ASSERT_EQ(ref[key], *value);
+      }
+    }
+    ASSERT_GT(map.occupancy(), 0.0 - 1e-9);
+    ASSERT_LE(map.occupancy(), 0.9 + 1e-9);
+    if (step % 10000 == 0)
+      same_pairs(map, ref);
+  }
+  same_pairs(map, ref);
+  // at a 0.9 load factor with four slots per bucket, filling the
+  // table has to displace residents
+  ASSERT_GT(map.kick_count(), 0);
+  for (int key = 0; key < 20000; ++key)
+    ASSERT_EQ(ref.count(key) == 1, map.contains(key));
+}
+
+TEST(CuckooMapTests, CollisionsUseStash)
+{
+  // every key has the same two buckets, so past 2 * 4 pairs (or 4 if
+  // the buckets coincide) inserts give up kicking and use the stash
+  CuckooMap<int,int,CollidingHash> map;
+  std::map<int,int> ref;
+  for (int i = 0; i < 12; ++i)
+  {
+    if (i % 2 == 0)
+      map.insert(i, i);
+    else
+      ASSERT_EQ(true, map.try_emplace(i, i));
+    ref[i] = i;
+  }
+  ASSERT_EQ(12, map.size());
+  ASSERT_GE(map.stash_size(), 4);
+  ASSERT_GT(map.kick_count(), 0);
+  same_pairs(map, ref);
+
+  // updates and lookups reach pairs in the stash
+  for (int i = 0; i < 12; ++i)
+  {
+    ASSERT_EQ(false, map.insert_or_assign(i, -i));
+    ASSERT_EQ(false, map.try_emplace(i, 100));
+    ref[i] = -i;
+  }
+  same_pairs(map, ref);
+  ASSERT_EQ(nullptr, map.find(12));
+
+  // erase every key, stash or table, and then refill
+  for (int i = 11; i >= 0; i -= 2)
+  {
+    map.erase(i);
+    ref.erase(i);
+    ASSERT_EQ(false, map.contains(i));
+    same_pairs(map, ref);
+  }
+  for (int i = 10; i >= 0; i -= 2)
+  {
+    map.erase(i);
+    ref.erase(i);
+  }
+  ASSERT_EQ(0, map.size());
+  ASSERT_EQ(0, map.stash_size());
+  ASSERT_THROW(map.erase(0), out_of_range);
+  for (int i = 0; i < 12; ++i)
+    ASSERT_EQ(true, map.insert_or_assign(i, i));
+  ASSERT_EQ(12, map.size());
+  ASSERT_EQ(7, map[7]);
+}
+
+TEST(CuckooMapTests, StashOverflowGrows)
+{
+  // 4 keys fill bucket 0, the next 8 fill the stash, and the 13th
+  // overflows it (well before the load factor asks for a resize)
+  ArraySeq<int> keys = bucket_zero_keys(13);
+  CuckooMap<int,int> map;
+  for (int i = 0; i < 12; ++i)
+    map.insert(keys[i], i);
+  ASSERT_EQ(8, map.stash_size());
+  ASSERT_DOUBLE_EQ(4.0 / 16, map.occupancy());
+  ASSERT_EQ(true, map.try_emplace(keys[12], 12));
+  ASSERT_LT(map.stash_size(), 8);
+  ASSERT_EQ(13, map.size());
+  ASSERT_DOUBLE_EQ((13.0 - map.stash_size()) / 32, map.occupancy());
+  for (int i = 0; i < 13; ++i)
+    ASSERT_EQ(i, map[keys[i]]);
+}
+
+TEST(CuckooMapTests, CopyAndMove)
+{
+  ArraySeq<int> keys = bucket_zero_keys(10);
+  CuckooMap<int,int> map;
+  for (int i = 0; i < 10; ++i)
+    map.insert(keys[i], i);
+  ASSERT_EQ(6, map.stash_size());
+
+  CuckooMap<int,int> copy(map);
+  copy.erase(keys[9]);
+  copy[keys[0]] = 100;
+  ASSERT_EQ(9, copy.size());
+  ASSERT_EQ(10, map.size());
+  ASSERT_EQ(9, map[keys[9]]);
+  ASSERT_EQ(0, map[keys[0]]);
+
+  CuckooMap<int,int> moved(std::move(copy));
+  ASSERT_EQ(9, moved.size());
+  ASSERT_EQ(100, moved[keys[0]]);
+  ASSERT_EQ(0, copy.size());
+  ASSERT_EQ(0, copy.stash_size());
+  ASSERT_EQ(false, copy.contains(keys[0]));
+  copy.insert(1, 1);
+  ASSERT_EQ(1, copy[1]);
+
+  CuckooMap<int,int> assigned;
+  assigned = map;
+  ASSERT_EQ(10, assigned.size());
+  ASSERT_EQ(6, assigned.stash_size());
+  assigned = std::move(moved);
+  ASSERT_EQ(9, assigned.size());
+  ASSERT_EQ(false, assigned.contains(keys[9]));
+  ASSERT_EQ(0, moved.size());
+}
+
+
+//----------------------------------------------------------------------
+// FrozenMap Tests
+//----------------------------------------------------------------------
+
+// a stateful hasher that counts its calls through a pointer
+struct CountingHash {
+  int* calls = nullptr;
+  size_t operator()(int key) const
+  {
+    if (calls != nullptr)
+      ++*calls;
+    return key;
+  }
+};
+
+// the frozen map holds exactly the pairs of the reference, and keys
+// around them are missing
+template<typename M>
+void frozen_same_pairs(const M& map, const std::map<int,int>& ref, int key_range)
+{
+  same_pairs(map, ref);
+  for (int key = -1; key <= key_range; ++key)
+  {
+    bool present = ref.count(key) == 1;
+    ASSERT_EQ(present, map.contains(key));
+    ASSERT_EQ(present, map.find(key) != nullptr);
+    if (!present)
+    {
+      ASSERT_THROW(map[key], out_of_range);
+    }
+  }
+}
+
+TEST(FrozenMapTests, FreezeHashMap)
+{
+  mt19937 gen(5);
+  HashMap<int,int> map;
+  std::map<int,int> ref;
+  for (int i = 0; i < 10000; ++i)
+  {
+    int key = gen() % 30000;
+    map.insert_or_assign(key, i);
+    ref[key] = i;
+  }
+  FrozenMap<int,int> frozen = freeze(map);
+  frozen_same_pairs(frozen, ref, 30000);
+
+  // values can change, the key set cannot
+  frozen[ref.begin()->first] = -1;
+  ASSERT_EQ(-1, *frozen.find(ref.begin()->first));
+  ASSERT_THROW(frozen.insert(-5, 0), logic_error);
+  ASSERT_THROW(frozen.insert(ref.begin()->first, 0), logic_error);
+  ASSERT_THROW(frozen.erase(ref.begin()->first), logic_error);
+  ASSERT_THROW(frozen.erase(-5), logic_error);
+  ASSERT_EQ((int) ref.size(), frozen.size());
+
+  ArraySeq<int> keys = frozen.find_keys(100, 200);
+  keys.sort();
+  int i = 0;
+  for (auto it = ref.lower_bound(100); it != ref.upper_bound(200); ++it)
+    ASSERT_EQ(it->first, keys[i++]);
+  ASSERT_EQ(i, keys.size());
+}
+
+TEST(FrozenMapTests, FreezeTreeMap)
+{
+  AVLMap<int,int> map;
+  std::map<int,int> ref;
+  for (int i = 0; i < 1000; ++i)
+  {
+    map.insert(3 * i, i);
+    ref[3 * i] = i;
+  }
+  FrozenMap<int,int> frozen = freeze(map);
+  frozen_same_pairs(frozen, ref, 3000);
+  ASSERT_THROW(frozen.insert(1, 1), logic_error);
+  ASSERT_THROW(frozen.erase(3), logic_error);
+  ASSERT_EQ(1, frozen[3]);
+}
+
+TEST(FrozenMapTests, EmptyAndOneKey)
+{
+  FrozenMap<int,int> empty;
+  ASSERT_EQ(true, empty.empty());
+  ASSERT_EQ(false, empty.contains(0));
+  ASSERT_EQ(nullptr, empty.find(0));
+  ASSERT_THROW(empty[0], out_of_range);
+  ASSERT_EQ(0, empty.sorted_keys().size());
+  ASSERT_THROW(empty.insert(0, 0), logic_error);
+
+  AVLMap<int,int> none;
+  FrozenMap<int,int> frozen_none = freeze(none);
+  ASSERT_EQ(0, frozen_none.size());
+  ASSERT_EQ(false, frozen_none.contains(0));
+
+  HashMap<int,int> one;
+  one.insert(7, 70);
+  FrozenMap<int,int> frozen_one = freeze(one);
+  std::map<int,int> ref {{7, 70}};
+  frozen_same_pairs(frozen_one, ref, 20);
+  ASSERT_THROW(frozen_one.erase(7), logic_error);
+}
+
+TEST(FrozenMapTests, CopyAndMove)
+{
+  BSTMap<int,int> map;
+  std::map<int,int> ref;
+  for (int i = 0; i < 100; ++i)
+  {
+    map.insert((i * 37) % 101, i);
+    ref[(i * 37) % 101] = i;
+  }
+  FrozenMap<int,int> frozen(map);
+  FrozenMap<int,int> copy(frozen);
+  copy[0] = -1;
+  ASSERT_EQ(0, frozen[0]);
+  frozen_same_pairs(frozen, ref, 101);
+
+  FrozenMap<int,int> moved(std::move(copy));
+  ASSERT_EQ(-1, moved[0]);
+  ASSERT_EQ(0, copy.size());
+  ASSERT_EQ(false, copy.contains(0));
+
+  FrozenMap<int,int> assigned;
+  assigned = frozen;
+  frozen_same_pairs(assigned, ref, 101);
+  assigned = std::move(moved);
+  ASSERT_EQ(-1, assigned[0]);
+  ASSERT_EQ(0, moved.size());
+}
+
+TEST(FrozenMapTests, FreezeKeepsHasherState)
+{
+  int calls = 0;
+  HashMap<int,int,CountingHash> map(CountingHash {&calls});
+  for (int i = 0; i < 50; ++i)
+    map.insert(i, i);
+  ASSERT_GT(calls, 0);
+
+  // the frozen map hashes with a copy of the map's hasher, pointer
+  // included
+  FrozenMap<int,int,CountingHash> frozen = freeze(map);
+  calls = 0;
+  ASSERT_EQ(true, frozen.contains(10));
+  ASSERT_EQ(false, frozen.contains(60));
+  ASSERT_EQ(2, calls);
+
+  // and so do its copies
+  FrozenMap<int,int,CountingHash> copy(frozen);
+  ASSERT_EQ(10, copy[10]);
+  ASSERT_EQ(3, calls);
+
+  // a map built through the Map constructor default-constructs it
+  // (reading the pairs out of map still calls map's hasher)
+  FrozenMap<int,int,CountingHash> plain(map);
+  calls = 0;
+  ASSERT_EQ(10, plain[10]);
+  ASSERT_EQ(0, calls);
+}
+
+
+//----------------------------------------------------------------------
+// HashMap Reserve and Shrink Tests
+//----------------------------------------------------------------------
+
+TEST(HashMapTests, ReserveAvoidsResize)
+{
+  for (int incremental = 0; incremental < 2; ++incremental)
+  {
+    HashMap<int,int> map;
+    map.incremental_resize(incremental == 1);
+    map.insert(-1, -1);
+    map.reserve(1000);
+    int buckets = map.bucket_count();
+    ASSERT_GE(buckets * 0.75, 1000.0);
+    ASSERT_EQ(-1, map[-1]);
+    for (int i = 0; i < 999; ++i)
+    {
+      if (i % 2 == 0)
+        map.insert(i, i);
+      else
+        ASSERT_EQ(true, map.insert_or_assign(i, i));
+      ASSERT_EQ(buckets, map.bucket_count());
+    }
+    // (an incremental reserve drains its own small old table along
+    // the way)
+    ASSERT_EQ(false, map.resizing());
+    ASSERT_EQ(1000, map.size());
+
+    // smaller (or equal) reservations never shrink the table
+    map.reserve(1000);
+    map.reserve(10);
+    map.reserve(0);
+    ASSERT_EQ(buckets, map.bucket_count());
+
+    // filling the table to the load factor grows it as usual
+    int key = 999;
+    while (map.size() < buckets * 3 / 4)
+    {
+      map.insert(key, key);
+      ++key;
+    }
+    ASSERT_EQ(2 * buckets, map.bucket_count());
+    for (int i = -1; i < key; ++i)
+      ASSERT_EQ(i, map[i]);
+  }
+}
+
+TEST(HashMapTests, ShrinkOnErase)
+{
+  for (int incremental = 0; incremental < 2; ++incremental)
+  {
+    HashMap<int,int> map;
+    map.incremental_resize(incremental == 1);
+    map.shrink_on_erase(true);
+    std::map<int,int> ref;
+    for (int i = 0; i < 2000; ++i)
+    {
+      map.insert(i, -i);
+      ref[i] = -i;
+    }
+    int peak = map.bucket_count();
+
+    // erase down to 20 keys, checking the contents as the table shrinks
+    int last_buckets = peak;
+    for (int i = 0; i < 1980; ++i)
+    {
+      int key = (i * 7) % 2000;
+      while (ref.count(key) == 0)
+        key = (key + 1) % 2000;
+      map.erase(key);
+      ref.erase(key);
+      if (map.bucket_count() != last_buckets)
+      {
+        ASSERT_EQ(last_buckets / 2, map.bucket_count());
+        last_buckets = map.bucket_count();
+        same_pairs(map, ref);
+      }
+    }
+    ASSERT_LT(map.bucket_count(), peak);
+    same_pairs(map, ref);
+    for (int key = 0; key < 2000; ++key)
+      ASSERT_EQ(ref.count(key) == 1, map.contains(key));
+
+    // shrinking stops at 16 buckets
+    while (!ref.empty())
+    {
+      map.erase(ref.begin()->first);
+      ref.erase(ref.begin());
+    }
+    ASSERT_EQ(16, map.bucket_count());
+    for (int round = 0; round < 3; ++round)
+    {
+      map.insert(round, round);
+      map.erase(round);
+      ASSERT_EQ(16, map.bucket_count());
+    }
+    ASSERT_EQ(0, map.size());
+
+    // and the shrunken map grows again
+    for (int i = 0; i < 100; ++i)
+      map.insert(i, i);
+    ASSERT_EQ(99, map[99]);
+    ASSERT_GT(map.bucket_count(), 16);
+  }
+
+  // without shrink_on_erase the table keeps its peak size
+  HashMap<int,int> map;
+  for (int i = 0; i < 2000; ++i)
+    map.insert(i, i);
+  int peak = map.bucket_count();
+  for (int i = 0; i < 2000; ++i)
+    map.erase(i);
+  ASSERT_EQ(peak, map.bucket_count());
+}
+
+
+//----------------------------------------------------------------------
+// BloomMap Tests
+//----------------------------------------------------------------------
+
+typedef BloomMap<int,int,AVLMap<int,int>> AVLBloomMap;
+
+// fraction of the keys k in [first, last) (stepping by step) whose
+// lookup the filter rejects, checking that none are in the map
+double filtered_fraction(const AVLBloomMap& map, int first, int last, int step)
+{
+  long filtered = map.filtered_lookups();
+  long passed = map.passed_lookups();
+  long false_pos = map.false_positives();
+  int lookups = 0;
+  for (int key = first; key < last; key += step)
+  {
+    EXPECT_EQ(false, map.contains(key));
+    lookups++;
+  }
+  // every passed lookup was a miss
+  EXPECT_EQ(lookups, map.filtered_lookups() - filtered + map.passed_lookups() - passed);
+  EXPECT_EQ(map.passed_lookups() - passed, map.false_positives() - false_pos);
+  return (map.filtered_lookups() - filtered) * 1.0 / lookups;
+}
+
+TEST(BloomMapTests, FilterAndCounters)
+{
+  ASSERT_THROW(AVLBloomMap(0.0), invalid_argument);
+  ASSERT_THROW(AVLBloomMap(1.0), invalid_argument);
+
+  AVLBloomMap map;
+  for (int i = 0; i < 500; ++i)
+    map.insert(2 * i, i);
+
+  // present keys always pass and are never false positives
+  for (int i = 0; i < 500; ++i)
+  {
+    ASSERT_EQ(true, map.contains(2 * i));
+    ASSERT_EQ(i, map[2 * i]);
+    ASSERT_EQ(i, *map.find(2 * i));
+  }
+  ASSERT_EQ(0, map.filtered_lookups());
+  ASSERT_EQ(1500, map.passed_lookups());
+  ASSERT_EQ(0, map.false_positives());
+
+  // absent keys are nearly all rejected by the filter
+  ASSERT_GT(filtered_fraction(map, 1, 20000, 2), 0.95);
+
+  // find a key the filter lets through
+  long false_pos = map.false_positives();
+  int fp_key = 1;
+  while (true)
+  {
+    ASSERT_EQ(false, map.contains(fp_key));
+    if (map.false_positives() > false_pos)
+      break;
+    fp_key += 2;
+  }
+  false_pos = map.false_positives();
+
+  // operator[], erase, and find on it count a false positive each
+  ASSERT_THROW(map[fp_key], out_of_range);
+  const AVLBloomMap& cmap = map;
+  ASSERT_THROW(cmap[fp_key], out_of_range);
+  ASSERT_THROW(map.erase(fp_key), out_of_range);
+  ASSERT_EQ(nullptr, map.find(fp_key));
+  ASSERT_EQ(false_pos + 4, map.false_positives());
+  ASSERT_EQ(500, map.size());
+
+  // insert_or_assign and try_emplace are not counted as lookups
+  long filtered = map.filtered_lookups();
+  long passed = map.passed_lookups();
+  ASSERT_EQ(false, map.insert_or_assign(0, -1));
+  ASSERT_EQ(false, map.try_emplace(0, -2));
+  ASSERT_EQ(true, map.try_emplace(fp_key, 7));
+  ASSERT_EQ(true, map.insert_or_assign(5001, 8));
+  ASSERT_EQ(false, map.insert_or_assign(fp_key, 9));
+  ASSERT_EQ(filtered, map.filtered_lookups());
+  ASSERT_EQ(passed, map.passed_lookups());
+  ASSERT_EQ(false_pos + 4, map.false_positives());
+  ASSERT_EQ(-1, map[0]);
+  ASSERT_EQ(9, map[fp_key]);
+  ASSERT_EQ(8, map[5001]);
+  ASSERT_EQ(502, map.size());
+}
+
+TEST(BloomMapTests, RebuildAfterGrowth)
+{
+  // far past the keys the filter starts out sized for
+  AVLBloomMap map;
+  for (int i = 0; i < 20000; ++i)
+  {
+    if (i % 2 == 0)
+      map.insert(2 * i, i);
+    else
+      ASSERT_EQ(true, map.try_emplace(2 * i, i));
+  }
+  for (int i = 0; i < 20000; ++i)
+    ASSERT_EQ(true, map.contains(2 * i));
+  ASSERT_EQ(20000, map.base().size());
+
+  // the filter grew with the map, so misses are still rejected
+  ASSERT_GT(filtered_fraction(map, 1, 40000, 2), 0.95);
+}
+
+TEST(BloomMapTests, RebuildAfterErasing)
+{
+  AVLBloomMap map;
+  for (int i = 0; i < 5000; ++i)
+    map.insert(i, i);
+  for (int i = 100; i < 5000; ++i)
+  {
+    map.erase(i);
+    ASSERT_THROW(map.erase(i), out_of_range);
+  }
+  ASSERT_EQ(100, map.size());
+  for (int i = 0; i < 100; ++i)
+    ASSERT_EQ(i, map[i]);
+
+  // rebuilds dropped the erased keys from the filter, so looking them
+  // up again mostly stops at the filter
+  ASSERT_GT(filtered_fraction(map, 100, 5000, 1), 0.9);
+
+  // and the map keeps working after the rebuilds
+  for (int i = 100; i < 200; ++i)
+    ASSERT_EQ(true, map.insert_or_assign(i, -i));
+  for (int i = 0; i < 200; ++i)
+    ASSERT_EQ(i < 100 ? i : -i, map[i]);
+}
+
+TEST(BloomMapTests, CopyAndMove)
+{
+  AVLBloomMap map;
+  for (int i = 0; i < 100; ++i)
+    map.insert(i, i);
+  map.contains(1000);
+
+  AVLBloomMap copy(map);
+  ASSERT_EQ(map.filtered_lookups() + map.passed_lookups(),
+            copy.filtered_lookups() + copy.passed_lookups());
+  copy.erase(5);
+  ASSERT_EQ(false, copy.contains(5));
+  ASSERT_EQ(5, map[5]);
+
+  AVLBloomMap moved(std::move(copy));
+  ASSERT_EQ(99, moved.size());
+  ASSERT_EQ(0, copy.size());
+  ASSERT_EQ(false, copy.contains(6));
+  copy.insert(6, 6);
+  ASSERT_EQ(6, copy[6]);
+
+  AVLBloomMap assigned;
+  assigned = map;
+  ASSERT_EQ(100, assigned.size());
+  assigned = std::move(moved);
+  ASSERT_EQ(99, assigned.size());
+  ASSERT_EQ(false, assigned.contains(5));
+}
+
+
+//----------------------------------------------------------------------
+// LRUCache Tests
+//----------------------------------------------------------------------
+
+TEST(LRUCacheTests, EvictionOrderAfterGet)
+{
+  ASSERT_THROW((LRUCache<int,int>(-1)), invalid_argument);
+
+  LRUCache<int,int> cache(3);
+  cache.put(1, 10);
+  cache.put(2, 20);
+  cache.put(3, 30);
+  ASSERT_EQ(3, cache.size());
+
+  // get makes 1 the most recently used, so 2 goes first
+  ASSERT_EQ(10, *cache.get(1));
+  cache.put(4, 40);
+  ASSERT_EQ(3, cache.size());
+  ASSERT_EQ(false, cache.contains(2));
+  ASSERT_EQ(true, cache.contains(1));
+  ASSERT_EQ(1, cache.evictions());
+
+  // order is now 4, 1, 3 (most to least recent)
+  *cache.get(3) = 31;
+  cache.put(5, 50);
+  ASSERT_EQ(false, cache.contains(1));
+  ASSERT_EQ(31, *cache.get(3));
+
+  // contains does not touch the order: 4 is still the oldest
+  ASSERT_EQ(true, cache.contains(4));
+  cache.put(6, 60);
+  ASSERT_EQ(false, cache.contains(4));
+  ASSERT_EQ(true, cache.contains(5));
+  ASSERT_EQ(true, cache.contains(3));
+  ASSERT_EQ(3, cache.evictions());
+}
+
+TEST(LRUCacheTests, EntryLimit)
+{
+  LRUCache<int,int> cache(100);
+  for (int i = 0; i < 1000; ++i)
+  {
+    cache.put(i, i);
+    ASSERT_EQ(i < 100 ? i + 1 : 100, cache.size());
+  }
+  ASSERT_EQ(900, cache.evictions());
+  for (int i = 0; i < 1000; ++i)
+    ASSERT_EQ(i >= 900, cache.contains(i));
+  ASSERT_EQ(100 * (sizeof(int) + sizeof(int)), cache.bytes());
+}
+
+TEST(LRUCacheTests, ByteLimit)
+{
+  LRUCache<int,int> cache(0, 100);
+  cache.put(1, 1, 40);
+  cache.put(2, 2, 40);
+  ASSERT_EQ(80u, cache.bytes());
+  cache.put(3, 3, 40);
+  ASSERT_EQ(80u, cache.bytes());
+  ASSERT_EQ(false, cache.contains(1));
+  ASSERT_EQ(1, cache.evictions());
+
+  // an entry over the whole limit evicts everything else but is kept
+  cache.put(4, 4, 500);
+  ASSERT_EQ(1, cache.size());
+  ASSERT_EQ(500u, cache.bytes());
+  ASSERT_EQ(4, *cache.get(4));
+  ASSERT_EQ(3, cache.evictions());
+
+  // and is itself evicted by the next put
+  cache.put(5, 5, 10);
+  ASSERT_EQ(false, cache.contains(4));
+  ASSERT_EQ(10u, cache.bytes());
+
+  // bytes of 0 charges sizeof(K) + sizeof(V)
+  cache.put(6, 6);
+  ASSERT_EQ(10 + sizeof(int) + sizeof(int), cache.bytes());
+
+  // both limits at once
+  LRUCache<int,int> both(3, 100);
+  for (int i = 0; i < 4; ++i)
+    both.put(i, i, 10);
+  ASSERT_EQ(3, both.size());
+  both.put(9, 9, 90);
+  ASSERT_EQ(2, both.size());
+  ASSERT_EQ(100u, both.bytes());
+}
+
+TEST(LRUCacheTests, PutReplaces)
+{
+  LRUCache<int,int> cache(2, 100);
+  cache.put(1, 10, 20);
+  cache.put(2, 20, 20);
+  cache.put(1, 11, 50);
+  ASSERT_EQ(2, cache.size());
+  ASSERT_EQ(70u, cache.bytes());
+  ASSERT_EQ(0, cache.evictions());
+
+  // the replaced entry became the most recently used
+  cache.put(3, 30, 10);
+  ASSERT_EQ(false, cache.contains(2));
+  ASSERT_EQ(11, *cache.get(1));
+
+  // growing an entry evicts the others but keeps it
+  cache.put(1, 12, 95);
+  ASSERT_EQ(1, cache.size());
+  ASSERT_EQ(95u, cache.bytes());
+  ASSERT_EQ(12, *cache.get(1));
+}
+
+TEST(LRUCacheTests, Erase)
+{
+  LRUCache<int,int> cache(4);
+  for (int i = 1; i <= 4; ++i)
+    cache.put(i, i, 10);
+  ASSERT_THROW(cache.erase(5), out_of_range);
+
+  // erase the least, the most, and a middle entry
+  cache.erase(1);
+  cache.erase(4);
+  ASSERT_EQ(2, cache.size());
+  ASSERT_EQ(20u, cache.bytes());
+  ASSERT_EQ(false, cache.contains(1));
+  ASSERT_EQ(nullptr, cache.get(4));
+  ASSERT_THROW(cache.erase(4), out_of_range);
+  ASSERT_EQ(0, cache.evictions());
+
+  // the remaining order (3, 2) is intact
+  cache.put(5, 5, 10);
+  cache.put(6, 6, 10);
+  cache.put(7, 7, 10);
+  ASSERT_EQ(false, cache.contains(2));
+  ASSERT_EQ(true, cache.contains(3));
+  cache.erase(6);
+  cache.erase(3);
+  cache.erase(5);
+  cache.erase(7);
+  ASSERT_EQ(true, cache.empty());
+  ASSERT_EQ(0u, cache.bytes());
+  cache.put(8, 8);
+  ASSERT_EQ(8, *cache.get(8));
+}
+
+TEST(LRUCacheTests, Counters)
+{
+  LRUCache<std::string,int> cache(2);
+  ASSERT_EQ(nullptr, cache.get("a"));
+  cache.put("a", 1);
+  cache.put("b", 2);
+  ASSERT_EQ(1, *cache.get("a"));
+  ASSERT_EQ(1, *cache.get("a"));
+  ASSERT_EQ(nullptr, cache.get("c"));
+  cache.contains("b");
+  cache.contains("c");
+  ASSERT_EQ(2, cache.hits());
+  ASSERT_EQ(2, cache.misses());
+  ASSERT_EQ(0, cache.evictions());
+
+  cache.put("c", 3);
+  cache.put("d", 4);
+  ASSERT_EQ(2, cache.evictions());
+  ASSERT_EQ(nullptr, cache.get("a"));
+  ASSERT_EQ(nullptr, cache.get("b"));
+  ASSERT_EQ(4, *cache.get("d"));
+  ASSERT_EQ(3, cache.hits());
+  ASSERT_EQ(4, cache.misses());
+}
+
+
+//----------------------------------------------------------------------
+// ShardedMap Tests
+//----------------------------------------------------------------------
+
+TEST(ShardedMapTests, ShardRouting)
+{
+  ASSERT_THROW((ShardedMap<int,int>(0)), invalid_argument);
+
+  ShardedMap<int,int> map(7);
+  std::map<int,int> ref;
+  ASSERT_EQ(7, map.shard_count());
+  for (int i = 0; i < 5000; ++i)
+  {
+    if (i % 3 == 0)
+      map.insert(i, i);
+    else if (i % 3 == 1)
+      ASSERT_EQ(true, map.insert_or_assign(i, i));
+    else
+      ASSERT_EQ(true, map.try_emplace(i, i));
+    ref[i] = i;
+  }
+  for (int i = 0; i < 5000; i += 4)
+  {
+    map.erase(i);
+    ref.erase(i);
+  }
+
+  // every key is in its own shard and no other
+  for (int key = 0; key < 5000; ++key)
+  {
+    int s = map.shard_of(key);
+    ASSERT_GE(s, 0);
+    ASSERT_LT(s, 7);
+    ASSERT_EQ(s, map.shard_of(key));
+    for (int i = 0; i < 7; ++i)
+      ASSERT_EQ(i == s and ref.count(key) == 1, map.shard(i).contains(key));
+  }
+  same_pairs(map, ref);
+
+  // the shard sizes add up, and every shard got a fair share
+  ArraySeq<int> sizes = map.shard_sizes();
+  ASSERT_EQ(7, sizes.size());
+  int total = 0;
+  for (int i = 0; i < sizes.size(); ++i)
+  {
+    ASSERT_EQ(map.shard(i).size(), sizes[i]);
+    ASSERT_GT(sizes[i], map.size() / 7 / 2);
+    total += sizes[i];
+  }
+  ASSERT_EQ(map.size(), total);
+  ASSERT_EQ(7, map.shard_max_chain_lengths().size());
+  ASSERT_EQ(7, map.shard_avg_chain_lengths().size());
+
+  // a single shard holds everything
+  ShardedMap<int,int> one(1);
+  for (int i = 0; i < 100; ++i)
+  {
+    one.insert(i, i);
+    ASSERT_EQ(0, one.shard_of(i));
+  }
+  ASSERT_EQ(100, one.shard(0).size());
+}
+
+TEST(ShardedMapTests, PartitionAndShardBatches)
+{
+  const int n = 5;
+  ShardedMap<int,int> map(n);
+  ArraySeq<std::pair<int,int>> pairs;
+  for (int i = 0; i < 1000; ++i)
+    pairs.insert({i, -i}, i);
+
+  // each pair lands in its key's shard, in the original order
+  std::vector<ArraySeq<std::pair<int,int>>> pair_parts(n);
+  map.partition(pairs, pair_parts.data());
+  int total = 0;
+  for (int i = 0; i < n; ++i)
+  {
+    for (int j = 0; j < pair_parts[i].size(); ++j)
+    {
+      ASSERT_EQ(i, map.shard_of(pair_parts[i][j].first));
+      if (j > 0)
+      {
+        ASSERT_LT(pair_parts[i][j - 1].first, pair_parts[i][j].first);
+      }
+    }
+    total += pair_parts[i].size();
+  }
+  ASSERT_EQ(1000, total);
+
+  for (int i = 0; i < n; ++i)
+  {
+    map.insert_shard(i, pair_parts[i]);
+    ASSERT_EQ(pair_parts[i].size(), map.shard_sizes()[i]);
+  }
+  ASSERT_EQ(1000, map.size());
+
+  // batch lookups of keys 0..1999, half of them present
+  ArraySeq<int> keys;
+  for (int i = 0; i < 2000; ++i)
+    keys.insert(i, i);
+  std::vector<ArraySeq<int>> key_parts(n);
+  map.partition(keys, key_parts.data());
+  total = 0;
+  for (int i = 0; i < n; ++i)
+  {
+    ArraySeq<bool> found = map.contains_shard(i, key_parts[i]);
+    ArraySeq<const int*> values = map.find_shard(i, key_parts[i]);
+    ASSERT_EQ(key_parts[i].size(), found.size());
+    ASSERT_EQ(key_parts[i].size(), values.size());
+    for (int j = 0; j < key_parts[i].size(); ++j)
+    {
+      int key = key_parts[i][j];
+      ASSERT_EQ(i, map.shard_of(key));
+      ASSERT_EQ(key < 1000, found[j]);
+      ASSERT_EQ(key < 1000, values[j] != nullptr);
+      if (values[j] != nullptr)
+      {
+        ASSERT_EQ(-key, *values[j]);
+      }
+    }
+    total += key_parts[i].size();
+  }
+  ASSERT_EQ(2000, total);
+}
+
+TEST(ShardedMapTests, BadShardIndex)
+{
+  ShardedMap<int,int> map(4);
+  const ShardedMap<int,int>& cmap = map;
+  ArraySeq<int> keys;
+  ArraySeq<std::pair<int,int>> pairs;
+  for (int i : {-1, 4, 100})
+  {
+    ASSERT_THROW(map.shard(i), out_of_range);
+    ASSERT_THROW(cmap.shard(i), out_of_range);
+    ASSERT_THROW(map.insert_shard(i, pairs), out_of_range);
+    ASSERT_THROW(map.contains_shard(i, keys), out_of_range);
+    ASSERT_THROW(map.find_shard(i, keys), out_of_range);
+  }
+  for (int i = 0; i < 4; ++i)
+  {
+    map.insert_shard(i, pairs);
+    ASSERT_EQ(0, map.contains_shard(i, keys).size());
+    ASSERT_EQ(0, cmap.shard(i).size());
+  }
+  ASSERT_EQ(true, map.empty());
+}
+
+TEST(ShardedMapTests, CopyAndMove)
+{
+  ShardedMap<int,int> map(3);
+  for (int i = 0; i < 100; ++i)
+    map.insert(i, i);
+  ShardedMap<int,int> copy(map);
+  copy.erase(5);
+  ASSERT_EQ(99, copy.size());
+  ASSERT_EQ(5, map[5]);
+
+  ShardedMap<int,int> moved(std::move(copy));
+  ASSERT_EQ(99, moved.size());
+  ASSERT_EQ(0, copy.size());
+  ASSERT_EQ(3, copy.shard_count());
+  copy.insert(1, 1);
+  ASSERT_EQ(1, copy[1]);
+
+  ShardedMap<int,int> assigned(8);
+  assigned = map;
+  ASSERT_EQ(3, assigned.shard_count());
+  ASSERT_EQ(100, assigned.size());
+  assigned = std::move(moved);
+  ASSERT_EQ(99, assigned.size());
+  ASSERT_EQ(false, assigned.contains(5));
+}
+
+
 //----------------------------------------------------------------------
 // Main
 //----------------------------------------------------------------------
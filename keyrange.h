@@ -0,0 +1,64 @@
+//---------------------------------------------------------------------------
+// NAME: Adam Huonder
+// DATE: Fall 2021
+// DESC: Implements KeyRange, a view over the keys between two map
+//       iterators, so a range can be used in a range-based for loop
+//---------------------------------------------------------------------------
+
+#ifndef KEYRANGE_H
+#define KEYRANGE_H
+
+
+// Iter is a map's const_iterator. The view only holds the two
+// iterators, so it is invalidated by the same changes to the map.
+template<typename Iter>
+class KeyRange
+{
+public:
+
+  // the keys from first up to (not including) last
+  KeyRange(const Iter& first, const Iter& last);
+
+  // iterators to the first key and one past the last key
+  Iter begin() const;
+  Iter end() const;
+
+  // Tests if the range holds no keys
+  bool empty() const;
+
+private:
+
+  Iter first;
+  Iter last;
+};
+
+
+// the keys from first up to (not including) last
+template<typename Iter>
+KeyRange<Iter>::KeyRange(const Iter& first, const Iter& last)
+  : first(first), last(last)
+{
+}
+
+// iterator to the first key
+template<typename Iter>
+Iter KeyRange<Iter>::begin() const
+{
+  return first;
+}
+
+// iterator to one past the last key
+template<typename Iter>
+Iter KeyRange<Iter>::end() const
+{
+  return last;
+}
+
+// Tests if the range holds no keys
+template<typename Iter>
+bool KeyRange<Iter>::empty() const
+{
+  return first == last;
+}
+
+#endif
@@ -45,6 +45,21 @@ public:
   // otherwise.
   bool contains(const K& key) const;
 
+  // Returns a pointer to the value for the given key, or nullptr if
+  // the key is not in the collection.
+  V* find(const K& key);
+  const V* find(const K& key) const;
+
+  // Sets the value for the given key, adding the key-value pair if
+  // the key is not in the collection. Returns true if the pair was
+  // added and false if an existing value was replaced.
+  bool insert_or_assign(const K& key, const V& value);
+
+  // Adds the key-value pair if the key is not in the collection and
+  // otherwise leaves the existing value alone. Returns true if the
+  // pair was added.
+  bool try_emplace(const K& key, const V& value);
+
   // Returns the keys k in the collection such that k1 <= k <= k2
   ArraySeq<K> find_keys(const K& k1, const K& k2) const;
 
@@ -59,6 +74,10 @@ private:
   // implemented as a linked list of (key-value) pairs
   LinkedSeq<std::pair<K,V>> seq;
 
+  // insert_or_assign and try_emplace helper, searches for the key
+  // once and either adds the pair or (if assign) replaces the value
+  bool insert_unique(const K& key, const V& value, bool assign);
+
 };
 
 
@@ -155,6 +174,50 @@ bool LinkedMap<K,V>::contains(const K& key) const
   return false;
 }
 
+// Returns a pointer to the value for the given key, or nullptr if
+// the key is not in the collection.
+template<typename K, typename V>
+V* LinkedMap<K,V>::find(const K& key)
+{
+  for (int i = 0; i < seq.size(); ++i)
+  {
+    if (seq[i].first == key)
+      return &seq[i].second;
+  }
+  return nullptr;
+}
+
+// Returns a pointer to the value for the given key, or nullptr if
+// the key is not in the collection.
+template<typename K, typename V>
+const V* LinkedMap<K,V>::find(const K& key) const
+{
+  for (int i = 0; i < seq.size(); ++i)
+  {
+    if (seq[i].first == key)
+      return &seq[i].second;
+  }
+  return nullptr;
+}
+
+// Sets the value for the given key, adding the key-value pair if
+// the key is not in the collection. Returns true if the pair was
+// added and false if an existing value was replaced.
+template<typename K, typename V>
+bool LinkedMap<K,V>::insert_or_assign(const K& key, const V& value)
+{
+  return insert_unique(key, value, true);
+}
+
+// Adds the key-value pair if the key is not in the collection and
+// otherwise leaves the existing value alone. Returns true if the
+// pair was added.
+template<typename K, typename V>
+bool LinkedMap<K,V>::try_emplace(const K& key, const V& value)
+{
+  return insert_unique(key, value, false);
+}
+
 // Returns the keys k in the collection such that k1 <= k <= k2
 template<typename K, typename V>
 ArraySeq<K> LinkedMap<K,V>::find_keys(const K& k1, const K& k2) const 
@@ -196,4 +259,21 @@ ArraySeq<K> LinkedMap<K,V>::sorted_keys() const
   return tmp;
 }
 
+// insert_or_assign and try_emplace helper
+template<typename K, typename V>
+bool LinkedMap<K,V>::insert_unique(const K& key, const V& value, bool assign)
+{
+  for (int i = 0; i < seq.size(); ++i)
+  {
+    if (seq[i].first == key)
+    {
+      if (assign)
+        seq[i].second = value;
+      return false;
+    }
+  }
+  seq.insert(std::pair<K,V> {key, value}, seq.size());
+  return true;
+}
+
 #endif
@@ -0,0 +1,310 @@
+//---------------------------------------------------------------------------
+// NAME: Adam Huonder
+// DATE: Fall 2021
+// DESC: Implements a least recently used cache on top of HashMap
+//       with an intrusive recency list
+//---------------------------------------------------------------------------
+
+#ifndef LRUCACHE_H
+#define LRUCACHE_H
+
+#include <cstddef>
+#include <functional>
+#include <stdexcept>
+#include "hashmap.h"
+#include "nodepool.h"
+
+//{{{ Header
+// Each entry lives in a pool-allocated node that is also a link of a
+// doubly linked list ordered from most to least recently used, and
+// the HashMap maps a key to its node. A hit moves its node to the
+// front and an eviction unlinks the node at the back, both in O(1).
+template<typename K, typename V, typename Hash = std::hash<K>>
+class LRUCache
+{
+public:
+
+  // creates a cache holding at most max_entries entries and at most
+  // max_bytes bytes (as charged by put). A limit of 0 means no limit.
+  LRUCache(int max_entries, std::size_t max_bytes = 0);
+
+  // the map and list point into each other and are not copied
+  LRUCache(const LRUCache& rhs) = delete;
+  LRUCache& operator=(const LRUCache& rhs) = delete;
+
+  // destructor
+  ~LRUCache();
+
+  // Returns the number of entries in the cache
+  int size() const;
+
+  // Tests if the cache is empty
+  bool empty() const;
+
+  // Returns the bytes charged for the entries in the cache
+  std::size_t bytes() const;
+
+  // Returns a pointer to the value for the given key and marks it
+  // most recently used, or returns nullptr (a miss) if the key is
+  // not cached. The pointer is valid until the entry is evicted.
+  V* get(const K& key);
+
+  // Returns true if the key is cached. Does not change the recency
+  // order or the counters.
+  bool contains(const K& key) const;
+
+  // Adds or replaces the entry for the key, charged the given number
+  // of bytes (sizeof(K) + sizeof(V) if bytes is 0), and marks it most
+  // recently used. Least recently used entries are then evicted until
+  // the cache is back within its limits, except that the new entry
+  // is always kept.
+  void put(const K& key, const V& value, std::size_t bytes = 0);
+
+  // Removes the entry for the given key. Throws out_of_range if the
+  // key is not cached.
+  void erase(const K& key);
+
+  // counters for the cache: gets that found the key, gets that did
+  // not, and entries removed to make room
+  long hits() const;
+  long misses() const;
+  long evictions() const;
+
+private:
+
+  // a cached entry and its recency list links
+  struct Entry {
+    K key;
+    V value;
+    std::size_t bytes;
+    Entry* prev;
+    Entry* next;
+  };
+
+  // key to entry
+  HashMap<K,Entry*,Hash> entries;
+
+  // storage for the entries
+  NodePool<Entry> pool;
+
+  // most and least recently used entries
+  Entry* head = nullptr;
+  Entry* tail = nullptr;
+
+  // limits (0 for none)
+  int max_entries;
+  std::size_t max_bytes;
+
+  // bytes charged for the current entries
+  std::size_t used_bytes = 0;
+
+  // counters
+  long hit_count = 0;
+  long miss_count = 0;
+  long eviction_count = 0;
+
+  // remove the entry from the recency list
+  void unlink(Entry* entry);
+
+  // add the entry at the front of the recency list
+  void push_front(Entry* entry);
+
+  // remove the entry from the cache entirely
+  void remove(Entry* entry);
+
+  // true if the cache is over one of its limits
+  bool over_limit() const;
+};
+//}}}
+
+//{{{ public functions
+// creates a cache with the given limits
+template<typename K, typename V, typename Hash>
+LRUCache<K,V,Hash>::LRUCache(int max_entries, std::size_t max_bytes)
+  : max_entries(max_entries), max_bytes(max_bytes)
+{
+  if (max_entries < 0)
+    throw std::invalid_argument("LRUCache<K,V,Hash>::LRUCache(int max_entries, std::size_t max_bytes). Negative entry limit.");
+  if (max_entries > 0)
+    entries.reserve(max_entries);
+}
+
+// destructor
+template<typename K, typename V, typename Hash>
+LRUCache<K,V,Hash>::~LRUCache()
+{
+  // the pool does not destroy live objects, so run their destructors
+  Entry* tmp = head;
+  while (tmp != nullptr)
+  {
+    Entry* next = tmp->next;
+    pool.free(tmp);
+    tmp = next;
+  }
+}
+
+// Returns the number of entries in the cache
+template<typename K, typename V, typename Hash>
+int LRUCache<K,V,Hash>::size() const
+{
+  return entries.size();
+}
+
+// Tests if the cache is empty
+template<typename K, typename V, typename Hash>
+bool LRUCache<K,V,Hash>::empty() const
+{
+  return entries.empty();
+}
+
+// Returns the bytes charged for the entries in the cache
+template<typename K, typename V, typename Hash>
+std::size_t LRUCache<K,V,Hash>::bytes() const
+{
+  return used_bytes;
+}
+
+// Returns a pointer to the value for the given key and marks it
+// most recently used, or nullptr if the key is not cached.
+template<typename K, typename V, typename Hash>
+V* LRUCache<K,V,Hash>::get(const K& key)
+{
+  Entry** found = entries.find(key);
+  if (found == nullptr)
+  {
+    miss_count++;
+    return nullptr;
+  }
+  hit_count++;
+  Entry* entry = *found;
+  if (entry != head)
+  {
+    unlink(entry);
+    push_front(entry);
+  }
+  return &entry->value;
+}
+
+// Returns true if the key is cached.
+template<typename K, typename V, typename Hash>
+bool LRUCache<K,V,Hash>::contains(const K& key) const
+{
+  return entries.contains(key);
+}
+
+// Adds or replaces the entry for the key and evicts as needed.
+template<typename K, typename V, typename Hash>
+void LRUCache<K,V,Hash>::put(const K& key, const V& value, std::size_t bytes)
+{
+  if (bytes == 0)
+    bytes = sizeof(K) + sizeof(V);
+
+  Entry** found = entries.find(key);
+  Entry* entry = nullptr;
+  if (found != nullptr)
+  {
+    entry = *found;
+    used_bytes -= entry->bytes;
+    unlink(entry);
+  }
+  else
+  {
+    entry = pool.alloc();
+    entry->key = key;
+    entries.insert(key, entry);
+  }
+  entry->value = value;
+  entry->bytes = bytes;
+  used_bytes += bytes;
+  push_front(entry);
+
+  while (over_limit() and tail != head)
+  {
+    remove(tail);
+    eviction_count++;
+  }
+}
+
+// Removes the entry for the given key. Throws out_of_range if the
+// key is not cached.
+template<typename K, typename V, typename Hash>
+void LRUCache<K,V,Hash>::erase(const K& key)
+{
+  Entry** found = entries.find(key);
+  if (found == nullptr)
+    throw std::out_of_range("void LRUCache<K,V,Hash>::erase(const K& key). Key does not exist.");
+  remove(*found);
+}
+
+template<typename K, typename V, typename Hash>
+long LRUCache<K,V,Hash>::hits() const
+{
+  return hit_count;
+}
+
+template<typename K, typename V, typename Hash>
+long LRUCache<K,V,Hash>::misses() const
+{
+  return miss_count;
+}
+
+template<typename K, typename V, typename Hash>
+long LRUCache<K,V,Hash>::evictions() const
+{
+  return eviction_count;
+}
+//}}}
+
+//{{{ private functions
+// remove the entry from the recency list
+template<typename K, typename V, typename Hash>
+void LRUCache<K,V,Hash>::unlink(Entry* entry)
+{
+  if (entry->prev != nullptr)
+    entry->prev->next = entry->next;
+  else
+    head = entry->next;
+  if (entry->next != nullptr)
+    entry->next->prev = entry->prev;
+  else
+    tail = entry->prev;
+  entry->prev = nullptr;
+  entry->next = nullptr;
+}
+
+// add the entry at the front of the recency list
+template<typename K, typename V, typename Hash>
+void LRUCache<K,V,Hash>::push_front(Entry* entry)
+{
+  entry->prev = nullptr;
+  entry->next = head;
+  if (head != nullptr)
+    head->prev = entry;
+  head = entry;
+  if (tail == nullptr)
+    tail = entry;
+}
+
+// remove the entry from the cache entirely
+template<typename K, typename V, typename Hash>
+void LRUCache<K,V,Hash>::remove(Entry* entry)
+{
+  unlink(entry);
+  entries.erase(entry->key);
+  used_bytes -= entry->bytes;
+  pool.free(entry);
+}
+
+// true if the cache is over one of its limits
+template<typename K, typename V, typename Hash>
+bool LRUCache<K,V,Hash>::over_limit() const
+{
+  if (max_entries > 0 and entries.size() > max_entries)
+    return true;
+  if (max_bytes > 0 and used_bytes > max_bytes)
+    return true;
+  return false;
+}
+//}}}
+
+#endif
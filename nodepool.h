@@ -0,0 +1,227 @@
+//---------------------------------------------------------------------------
+// NAME: Adam Huonder
+// DATE: Fall 2021
+// DESC: Implements NodePool, a slab allocator for fixed-size nodes
+//       with a free list for recycled nodes
+//---------------------------------------------------------------------------
+
+#ifndef NODEPOOL_H
+#define NODEPOOL_H
+
+#include <new>
+#include <utility>
+
+
+template<typename T>
+class NodePool
+{
+public:
+
+  // default constructor
+  NodePool();
+
+  // pools are owned by a single container and are not copied
+  NodePool(const NodePool& rhs) = delete;
+  NodePool& operator=(const NodePool& rhs) = delete;
+
+  // move constructor
+  NodePool(NodePool&& rhs);
+
+  // move assignment
+  NodePool& operator=(NodePool&& rhs);
+
+  // destructor
+  ~NodePool();
+
+  // Returns a value-initialized object, reusing a freed slot if one
+  // is available and otherwise carving one out of the current slab
+  T* alloc();
+
+  // Destroys the object and puts its slot on the free list
+  void free(T* obj);
+
+  // Releases every slab at once. Objects still in use are not
+  // destroyed, so the caller must destroy them first unless T is
+  // trivially destructible.
+  void clear();
+
+  // Takes over every slab of rhs (and its free slots), leaving rhs
+  // empty. Objects allocated from rhs stay where they are and are now
+  // owned by this pool, so containers can merge their nodes without
+  // copying them.
+  void splice(NodePool& rhs);
+
+private:
+
+  // storage for one object, reused as a free list link when unused
+  union Slot {
+    Slot* next;
+    alignas(T) unsigned char storage[sizeof(T)];
+  };
+
+  // one contiguous block of slots
+  struct Slab {
+    Slot* slots;
+    int size;
+    Slab* next;
+  };
+
+  // smallest and largest number of slots in a slab
+  static const int MIN_SLAB_SIZE = 32;
+  static const int MAX_SLAB_SIZE = 4096;
+
+  // most recently allocated slab (head of the slab list)
+  Slab* slabs = nullptr;
+
+  // number of slots of the head slab handed out so far
+  int used = 0;
+
+  // freed slots available for reuse
+  Slot* free_list = nullptr;
+};
+
+
+// default constructor
+template<typename T>
+NodePool<T>::NodePool()
+{
+}
+
+// move constructor
+template<typename T>
+NodePool<T>::NodePool(NodePool&& rhs)
+{
+  slabs = rhs.slabs;
+  used = rhs.used;
+  free_list = rhs.free_list;
+  rhs.slabs = nullptr;
+  rhs.used = 0;
+  rhs.free_list = nullptr;
+}
+
+// move assignment
+template<typename T>
+NodePool<T>& NodePool<T>::operator=(NodePool&& rhs)
+{
+  if (this != &rhs)
+  {
+    clear();
+    slabs = rhs.slabs;
+    used = rhs.used;
+    free_list = rhs.free_list;
+    rhs.slabs = nullptr;
+    rhs.used = 0;
+    rhs.free_list = nullptr;
+  }
+  return *this;
+}
+
+// destructor
+template<typename T>
+NodePool<T>::~NodePool()
+{
+  clear();
+}
+
+// Returns a value-initialized object
+template<typename T>
+T* NodePool<T>::alloc()
+{
+  Slot* slot = nullptr;
+  if (free_list != nullptr)
+  {
+    slot = free_list;
+    free_list = free_list->next;
+  }
+  else
+  {
+    if (slabs == nullptr or used == slabs->size)
+    {
+      // each slab doubles the last one, up to MAX_SLAB_SIZE
+      int size = MIN_SLAB_SIZE;
+      if (slabs != nullptr and slabs->size < MAX_SLAB_SIZE)
+        size = slabs->size * 2;
+      else if (slabs != nullptr)
+        size = MAX_SLAB_SIZE;
+      Slab* slab = new Slab;
+      slab->slots = new Slot[size];
+      slab->size = size;
+      slab->next = slabs;
+      slabs = slab;
+      used = 0;
+    }
+    slot = &slabs->slots[used];
+    used++;
+  }
+  return new (slot->storage) T();
+}
+
+// Destroys the object and puts its slot on the free list
+template<typename T>
+void NodePool<T>::free(T* obj)
+{
+  obj->~T();
+  Slot* slot = reinterpret_cast<Slot*>(obj);
+  slot->next = free_list;
+  free_list = slot;
+}
+
+// Releases every slab at once
+template<typename T>
+void NodePool<T>::clear()
+{
+  while (slabs != nullptr)
+  {
+    Slab* del = slabs;
+    slabs = slabs->next;
+    delete[] del->slots;
+    delete del;
+  }
+  used = 0;
+  free_list = nullptr;
+}
+
+// Takes over every slab of rhs (and its free slots)
+template<typename T>
+void NodePool<T>::splice(NodePool& rhs)
+{
+  if (this == &rhs or rhs.slabs == nullptr)
+    return;
+
+  // the untouched end of rhs's newest slab and rhs's freed slots are
+  // all reused through the free list
+  for (int i = rhs.used; i < rhs.slabs->size; ++i)
+  {
+    Slot* slot = &rhs.slabs->slots[i];
+    slot->next = free_list;
+    free_list = slot;
+  }
+  while (rhs.free_list != nullptr)
+  {
+    Slot* slot = rhs.free_list;
+    rhs.free_list = slot->next;
+    slot->next = free_list;
+    free_list = slot;
+  }
+
+  // rhs's slabs go behind the head slab, which is still the one new
+  // objects are carved from
+  if (slabs == nullptr)
+  {
+    slabs = rhs.slabs;
+    used = slabs->size;
+  }
+  else
+  {
+    Slab* last = rhs.slabs;
+    while (last->next != nullptr)
+      last = last->next;
+    last->next = slabs->next;
+    slabs->next = rhs.slabs;
+  }
+
+  rhs.slabs = nullptr;
+  rhs.used = 0;
+}
+
+#endif
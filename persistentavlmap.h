@@ -0,0 +1,631 @@
+//---------------------------------------------------------------------------
+// NAME: Adam Huonder
+// DATE: Fall 2021
+// DESC: Implements a persistent AVL tree whose versions share nodes,
+//       so copies (snapshots) are O(1)
+//---------------------------------------------------------------------------
+
+#ifndef PERSISTENTAVLMAP_H
+#define PERSISTENTAVLMAP_H
+
+#include <atomic>
+#include "map.h"
+#include "arrayseq.h"
+
+
+// Every node carries an atomic count of the links (parent links and
+// map roots) that refer to it. Copying a map only adds a reference to
+// the root, and the two versions then share every node. An update
+// copies the nodes on its search path that are shared and modifies
+// the rest in place, so a map with no other versions alive updates
+// like a plain AVL tree and a snapshot is never changed by the map
+// it was taken from.
+//
+// A single map object is not safe to use from two threads at once,
+// but each thread may use its own snapshot freely (without locks)
+// while other versions are being changed.
+template<typename K, typename V>
+class PersistentAVLMap : public Map<K,V>
+{
+public:
+
+  // default constructor
+  PersistentAVLMap();
+
+  // copy constructor, shares rhs's nodes (O(1))
+  PersistentAVLMap(const PersistentAVLMap& rhs);
+
+  // move constructor
+  PersistentAVLMap(PersistentAVLMap&& rhs);
+
+  // copy assignment, shares rhs's nodes (O(1))
+  PersistentAVLMap& operator=(const PersistentAVLMap& rhs);
+
+  // move assignment
+  PersistentAVLMap& operator=(PersistentAVLMap&& rhs);
+
+  // destructor
+  ~PersistentAVLMap();
+
+  // Returns a version of the map that later changes to this map do
+  // not affect (the same as copying the map)
+  PersistentAVLMap snapshot() const;
+
+  // Returns the number of key-value pairs in the map
+  int size() const;
+
+  // Tests if the map is empty
+  bool empty() const;
+
+  // Allows values associated with a key to be updated. Throws
+  // out_of_range if the given key is not in the collection. Copies
+  // the search path first if it is shared with another version.
+  V& operator[](const K& key);
+
+  // Returns the value for a given key. Throws out_of_range if the
+  // given key is not in the collection.
+  const V& operator[](const K& key) const;
+
+  // Extends the collection by adding the given key-value
+  // pair. Assumes the key being added is not present in the
+  // collection (an existing key keeps its value).
+  void insert(const K& key, const V& value);
+
+  // Shrinks the collection by removing the key-value pair with the
+  // given key. Throws out_of_range if the given key is not in the
+  // collection.
+  void erase(const K& key);
+
+  // Returns true if the key is in the collection, and false otherwise.
+  bool contains(const K& key) const;
+
+  // Returns a pointer to the value for the given key, or nullptr if
+  // the key is not in the collection.
+  const V* find(const K& key) const;
+
+  // Sets the value for the given key, adding the key-value pair if
+  // the key is not in the collection. Returns true if the pair was
+  // added and false if an existing value was replaced.
+  bool insert_or_assign(const K& key, const V& value);
+
+  // Adds the key-value pair if the key is not in the collection and
+  // otherwise leaves the existing value alone. Returns true if the
+  // pair was added.
+  bool try_emplace(const K& key, const V& value);
+
+  // Returns the keys k in the collection such that k1 <= k <= k2
+  ArraySeq<K> find_keys(const K& k1, const K& k2) const;
+
+  // Returns the keys in the collection in ascending sorted order
+  ArraySeq<K> sorted_keys() const;
+
+  // Returns the height of the binary search tree
+  int height() const;
+
+private:
+
+  // node for the avl tree, shared between versions
+  struct Node {
+    K key;
+    V value;
+    Node* left;
+    Node* right;
+    int height;
+    std::atomic<int> refs;
+  };
+
+  // number of nodes
+  int count = 0;
+
+  // root node (this map's reference to it)
+  Node* root = nullptr;
+
+  // a new unshared node holding the pair
+  static Node* make_node(const K& key, const V& value);
+
+  // add a reference to a node (nullptr is ignored)
+  static Node* acquire(Node* st_root);
+
+  // drop a reference to a node, deleting it (and dropping its
+  // references to its children) when it was the last one
+  static void release(Node* st_root);
+
+  // Takes the caller's reference to st_root and returns a node the
+  // caller may modify: st_root itself if no other link refers to it,
+  // otherwise a copy (which shares st_root's children)
+  static Node* own(Node* st_root);
+
+  // Path-copying update helpers. Each takes the caller's reference to
+  // the subtree and returns the new (balanced) subtree root.
+  //   insert:     adds the pair, or (if assign) replaces the value of
+  //               an existing key; added tells which happened
+  //   erase:      removes key, which must be in the subtree
+  //   erase_min:  detaches the subtree's smallest node into min
+  //   touch:      makes the path to key (which must be in the
+  //               subtree) unshared and points value at its value
+  static Node* insert(Node* st_root, const K& key, const V& value,
+                      bool assign, bool& added);
+  static Node* erase(Node* st_root, const K& key);
+  static Node* erase_min(Node* st_root, Node*& min);
+  static Node* touch(Node* st_root, const K& key, V*& value);
+
+  // search helper, returns the node holding key or nullptr
+  const Node* find_node(const K& key) const;
+
+  // height of a subtree (0 if empty)
+  static int height(const Node* st_root);
+
+  // recompute an owned node's height from its children
+  static void update(Node* st_root);
+
+  // rotations and rebalancing of an owned node, making the child that
+  // moves up owned as well
+  static Node* right_rotate(Node* k2);
+  static Node* left_rotate(Node* k2);
+  static Node* rebalance(Node* st_root);
+
+  // find_keys helper
+  void find_keys(const K& k1, const K& k2, const Node* st_root,
+                 ArraySeq<K>& keys) const;
+
+  // sorted_keys helper
+  void sorted_keys(const Node* st_root, ArraySeq<K>& keys) const;
+};
+
+
+// default constructor
+template<typename K, typename V>
+PersistentAVLMap<K,V>::PersistentAVLMap()
+{
+}
+
+// copy constructor
+template<typename K, typename V>
+PersistentAVLMap<K,V>::PersistentAVLMap(const PersistentAVLMap& rhs)
+{
+  root = acquire(rhs.root);
+  count = rhs.count;
+}
+
+// move constructor
+template<typename K, typename V>
+PersistentAVLMap<K,V>::PersistentAVLMap(PersistentAVLMap&& rhs)
+{
+  root = rhs.root;
+  count = rhs.count;
+  rhs.root = nullptr;
+  rhs.count = 0;
+}
+
+// copy assignment
+template<typename K, typename V>
+PersistentAVLMap<K,V>& PersistentAVLMap<K,V>::operator=(const PersistentAVLMap& rhs)
+{
+  // acquire first so self-assignment keeps the root alive
+  Node* new_root = acquire(rhs.root);
+  release(root);
+  root = new_root;
+  count = rhs.count;
+  return *this;
+}
+
+// move assignment
+template<typename K, typename V>
+PersistentAVLMap<K,V>& PersistentAVLMap<K,V>::operator=(PersistentAVLMap&& rhs)
+{
+  if (this != &rhs)
+  {
+    release(root);
+    root = rhs.root;
+    count = rhs.count;
+    rhs.root = nullptr;
+    rhs.count = 0;
+  }
+  return *this;
+}
+
+// destructor
+template<typename K, typename V>
+PersistentAVLMap<K,V>::~PersistentAVLMap()
+{
+  release(root);
+}
+
+// Returns a version of the map that later changes do not affect
+template<typename K, typename V>
+PersistentAVLMap<K,V> PersistentAVLMap<K,V>::snapshot() const
+{
+  return PersistentAVLMap(*this);
+}
+
+// Returns the number of key-value pairs in the map
+template<typename K, typename V>
+int PersistentAVLMap<K,V>::size() const
+{
+  return count;
+}
+
+// Tests if the map is empty
+template<typename K, typename V>
+bool PersistentAVLMap<K,V>::empty() const
+{
+  return count == 0;
+}
+
+// Allows values associated with a key to be updated. Throws
+// out_of_range if the given key is not in the collection.
+template<typename K, typename V>
+V& PersistentAVLMap<K,V>::operator[](const K& key)
+{
+  // check first so a missing key copies nothing
+  if (find_node(key) == nullptr)
+    throw std::out_of_range("V& PersistentAVLMap<K,V>::operator[](const K& key). Key does not exist.");
+  V* value = nullptr;
+  root = touch(root, key, value);
+  return *value;
+}
+
+// Returns the value for a given key. Throws out_of_range if the
+// given key is not in the collection.
+template<typename K, typename V>
+const V& PersistentAVLMap<K,V>::operator[](const K& key) const
+{
+  const Node* ptr = find_node(key);
+  if (ptr == nullptr)
+    throw std::out_of_range("const V& PersistentAVLMap<K,V>::operator[](const K& key) const. Key does not exist.");
+  return ptr->value;
+}
+
+// Extends the collection by adding the given key-value pair.
+template<typename K, typename V>
+void PersistentAVLMap<K,V>::insert(const K& key, const V& value)
+{
+  try_emplace(key, value);
+}
+
+// Shrinks the collection by removing the key-value pair with the
+// given key. Throws out_of_range if the given key is not in the
+// collection.
+template<typename K, typename V>
+void PersistentAVLMap<K,V>::erase(const K& key)
+{
+  if (find_node(key) == nullptr)
+    throw std::out_of_range("void PersistentAVLMap<K,V>::erase(const K& key). Key does not exist.");
+  root = erase(root, key);
+  count--;
+}
+
+// Returns true if the key is in the collection, and false otherwise.
+template<typename K, typename V>
+bool PersistentAVLMap<K,V>::contains(const K& key) const
+{
+  return find_node(key) != nullptr;
+}
+
+// Returns a pointer to the value for the given key, or nullptr if
+// the key is not in the collection.
+template<typename K, typename V>
+const V* PersistentAVLMap<K,V>::find(const K& key) const
+{
+  const Node* ptr = find_node(key);
+  if (ptr == nullptr)
+    return nullptr;
+  return &ptr->value;
+}
+
+// Sets the value for the given key, adding the key-value pair if
+// the key is not in the collection.
+template<typename K, typename V>
+bool PersistentAVLMap<K,V>::insert_or_assign(const K& key, const V& value)
+{
+  bool added = false;
+  root = insert(root, key, value, true, added);
+  if (added)
+    count++;
+  return added;
+}
+
+// Adds the key-value pair if the key is not in the collection.
+template<typename K, typename V>
+bool PersistentAVLMap<K,V>::try_emplace(const K& key, const V& value)
+{
+  // an existing key would only copy the path for nothing
+  if (find_node(key) != nullptr)
+    return false;
+  bool added = false;
+  root = insert(root, key, value, false, added);
+  count++;
+  return true;
+}
+
+// Returns the keys k in the collection such that k1 <= k <= k2
+template<typename K, typename V>
+ArraySeq<K> PersistentAVLMap<K,V>::find_keys(const K& k1, const K& k2) const
+{
+  ArraySeq<K> keys;
+  find_keys(k1, k2, root, keys);
+  return keys;
+}
+
+// Returns the keys in the collection in ascending sorted order
+template<typename K, typename V>
+ArraySeq<K> PersistentAVLMap<K,V>::sorted_keys() const
+{
+  ArraySeq<K> keys;
+  sorted_keys(root, keys);
+  return keys;
+}
+
+// Returns the height of the binary search tree
+template<typename K, typename V>
+int PersistentAVLMap<K,V>::height() const
+{
+  return height(root);
+}
+
+// a new unshared node holding the pair
+template<typename K, typename V>
+typename PersistentAVLMap<K,V>::Node* PersistentAVLMap<K,V>::make_node(const K& key, const V& value)
+{
+  Node* ptr = new Node;
+  ptr->key = key;
+  ptr->value = value;
+  ptr->left = nullptr;
+  ptr->right = nullptr;
+  ptr->height = 1;
+  ptr->refs.store(1, std::memory_order_relaxed);
+  return ptr;
+}
+
+// add a reference to a node
+template<typename K, typename V>
+typename PersistentAVLMap<K,V>::Node* PersistentAVLMap<K,V>::acquire(Node* st_root)
+{
+  if (st_root != nullptr)
+    st_root->refs.fetch_add(1, std::memory_order_relaxed);
+  return st_root;
+}
+
+// drop a reference to a node
+template<typename K, typename V>
+void PersistentAVLMap<K,V>::release(Node* st_root)
+{
+  // the last reference (from any thread) deletes the node, and the
+  // acquire half makes the other threads' earlier reads of it happen
+  // before the delete
+  if (st_root != nullptr and st_root->refs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+  {
+    release(st_root->left);
+    release(st_root->right);
+    delete st_root;
+  }
+}
+
+// Returns a node the caller may modify in place of st_root
+template<typename K, typename V>
+typename PersistentAVLMap<K,V>::Node* PersistentAVLMap<K,V>::own(Node* st_root)
+{
+  // a count of one is the caller's own link, and no other thread can
+  // add a link to a node only this version can reach
+  if (st_root->refs.load(std::memory_order_acquire) == 1)
+    return st_root;
+
+  Node* cpy = make_node(st_root->key, st_root->value);
+  cpy->left = acquire(st_root->left);
+  cpy->right = acquire(st_root->right);
+  cpy->height = st_root->height;
+  release(st_root);
+  return cpy;
+}
+
+// insert helper
+template<typename K, typename V>
+typename PersistentAVLMap<K,V>::Node* PersistentAVLMap<K,V>::insert(Node* st_root, const K& key, const V& value, bool assign, bool& added)
+{
+  if (st_root == nullptr)
+  {
+    added = true;
+    return make_node(key, value);
+  }
+
+  Node* ptr = own(st_root);
+  if (key < ptr->key)
+    ptr->left = insert(ptr->left, key, value, assign, added);
+  else if (ptr->key < key)
+    ptr->right = insert(ptr->right, key, value, assign, added);
+  else
+  {
+    added = false;
+    if (assign)
+      ptr->value = value;
+    return ptr;
+  }
+  update(ptr);
+  return rebalance(ptr);
+}
+
+// erase helper
+template<typename K, typename V>
+typename PersistentAVLMap<K,V>::Node* PersistentAVLMap<K,V>::erase(Node* st_root, const K& key)
+{
+  Node* ptr = own(st_root);
+  if (key < ptr->key)
+    ptr->left = erase(ptr->left, key);
+  else if (ptr->key < key)
+    ptr->right = erase(ptr->right, key);
+  else
+  {
+    Node* del = ptr;
+    if (ptr->left == nullptr or ptr->right == nullptr)
+    {
+      // hand the only child to the parent in place of this node
+      if (ptr->left == nullptr)
+        ptr = ptr->right;
+      else
+        ptr = ptr->left;
+      del->left = nullptr;
+      del->right = nullptr;
+      release(del);
+      return ptr;
+    }
+
+    // two children: the inorder successor's pair replaces this one
+    Node* min = nullptr;
+    ptr->right = erase_min(ptr->right, min);
+    ptr->key = min->key;
+    ptr->value = min->value;
+    release(min);
+  }
+  update(ptr);
+  return rebalance(ptr);
+}
+
+// detach the subtree's smallest node into min
+template<typename K, typename V>
+typename PersistentAVLMap<K,V>::Node* PersistentAVLMap<K,V>::erase_min(Node* st_root, Node*& min)
+{
+  Node* ptr = own(st_root);
+  if (ptr->left == nullptr)
+  {
+    Node* rest = ptr->right;
+    ptr->right = nullptr;
+    min = ptr;
+    return rest;
+  }
+  ptr->left = erase_min(ptr->left, min);
+  update(ptr);
+  return rebalance(ptr);
+}
+
+// make the path to key unshared
+template<typename K, typename V>
+typename PersistentAVLMap<K,V>::Node* PersistentAVLMap<K,V>::touch(Node* st_root, const K& key, V*& value)
+{
+  Node* ptr = own(st_root);
+  if (key < ptr->key)
+    ptr->left = touch(ptr->left, key, value);
+  else if (ptr->key < key)
+    ptr->right = touch(ptr->right, key, value);
+  else
+    value = &ptr->value;
+  return ptr;
+}
+
+// search helper
+template<typename K, typename V>
+const typename PersistentAVLMap<K,V>::Node* PersistentAVLMap<K,V>::find_node(const K& key) const
+{
+  const Node* ptr = root;
+  while (ptr != nullptr)
+  {
+    if (key < ptr->key)
+      ptr = ptr->left;
+    else if (ptr->key < key)
+      ptr = ptr->right;
+    else
+      return ptr;
+  }
+  return nullptr;
+}
+
+// height of a subtree (0 if empty)
+template<typename K, typename V>
+int PersistentAVLMap<K,V>::height(const Node* st_root)
+{
+  if (st_root == nullptr)
+    return 0;
+  return st_root->height;
+}
+
+// recompute an owned node's height from its children
+template<typename K, typename V>
+void PersistentAVLMap<K,V>::update(Node* st_root)
+{
+  int left_height = height(st_root->left);
+  int right_height = height(st_root->right);
+  if (left_height > right_height)
+    st_root->height = left_height + 1;
+  else
+    st_root->height = right_height + 1;
+}
+
+// rotate right
+template<typename K, typename V>
+typename PersistentAVLMap<K,V>::Node* PersistentAVLMap<K,V>::right_rotate(Node* k2)
+{
+  Node* k1 = own(k2->left);
+  k2->left = k1->right;
+  k1->right = k2;
+  update(k2);
+  update(k1);
+  return k1;
+}
+
+// rotate left
+template<typename K, typename V>
+typename PersistentAVLMap<K,V>::Node* PersistentAVLMap<K,V>::left_rotate(Node* k2)
+{
+  Node* k1 = own(k2->right);
+  k2->right = k1->left;
+  k1->left = k2;
+  update(k2);
+  update(k1);
+  return k1;
+}
+
+// rebalance
+template<typename K, typename V>
+typename PersistentAVLMap<K,V>::Node* PersistentAVLMap<K,V>::rebalance(Node* st_root)
+{
+  int BF = height(st_root->left) - height(st_root->right);
+
+  if (BF > 1) //left heavy
+  {
+    //check for double
+    Node* lptr = st_root->left;
+    if (height(lptr->right) > height(lptr->left))
+      st_root->left = left_rotate(own(lptr));
+    st_root = right_rotate(st_root);
+  }
+  else if (BF < -1) //right heavy
+  {
+    //check for double
+    Node* rptr = st_root->right;
+    if (height(rptr->left) > height(rptr->right))
+      st_root->right = right_rotate(own(rptr));
+    st_root = left_rotate(st_root);
+  }
+  return st_root;
+}
+
+// find_keys helper
+template<typename K, typename V>
+void PersistentAVLMap<K,V>::find_keys(const K& k1, const K& k2, const Node* st_root, ArraySeq<K>& keys) const
+{
+  if (st_root == nullptr)
+    return;
+
+  // only subtrees that can hold keys in [k1, k2] are visited
+  if (k1 < st_root->key)
+    find_keys(k1, k2, st_root->left, keys);
+
+  if (st_root->key >= k1 and st_root->key <= k2)
+    keys.insert(st_root->key, keys.size());
+
+  if (st_root->key < k2)
+    find_keys(k1, k2, st_root->right, keys);
+}
+
+// sorted_keys helper
+template<typename K, typename V>
+void PersistentAVLMap<K,V>::sorted_keys(const Node* st_root, ArraySeq<K>& keys) const
+{
+  if (st_root == nullptr)
+    return;
+
+  sorted_keys(st_root->left, keys);
+  keys.insert(st_root->key, keys.size());
+  sorted_keys(st_root->right, keys);
+}
+
+#endif
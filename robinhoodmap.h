@@ -0,0 +1,527 @@
+//---------------------------------------------------------------------------
+// NAME: Adam Huonder
+// DATE: Fall 2021
+// DESC: Implements an open-addressing hash map using Robin Hood
+//       probing with backward-shift deletion
+//---------------------------------------------------------------------------
+
+#ifndef ROBINHOODMAP_H
+#define ROBINHOODMAP_H
+
+#include <functional>
+#include <utility>
+#include "map.h"
+#include "arrayseq.h"
+#include "hashmap.h"
+
+//{{{ Header
+// Hash is the hasher for K, std::hash<K> unless a custom one is given
+template<typename K, typename V, typename Hash = std::hash<K>>
+class RobinHoodMap : public Map<K,V>
+{
+public:
+
+  // default constructor
+  RobinHoodMap();
+
+  // copy constructor
+  RobinHoodMap(const RobinHoodMap& rhs);
+
+  // move constructor
+  RobinHoodMap(RobinHoodMap&& rhs);
+
+  // copy assignment
+  RobinHoodMap& operator=(const RobinHoodMap& rhs);
+
+  // move assignment
+  RobinHoodMap& operator=(RobinHoodMap&& rhs);
+
+  // destructor
+  ~RobinHoodMap();
+
+  // Returns the number of key-value pairs in the map
+  int size() const;
+
+  // Tests if the map is empty
+  bool empty() const;
+
+  // Allows values associated with a key to be updated. Throws
+  // out_of_range if the given key is not in the collection.
+  V& operator[](const K& key);
+
+  // Returns the value for a given key. Throws out_of_range if the
+  // given key is not in the collection.
+  const V& operator[](const K& key) const;
+
+  // Extends the collection by adding the given key-value
+  // pair. Assumes the key being added is not present in the
+  // collection. Insert does not check if the key is present.
+  void insert(const K& key, const V& value);
+
+  // Shrinks the collection by removing the key-value pair with the
+  // given key. Does not modify the collection if the collection does
+  // not contain the key. Throws out_of_range if the given key is not
+  // in the collection.
+  void erase(const K& key);
+
+  // Returns true if the key is in the collection, and false otherwise.
+  bool contains(const K& key) const;
+
+  // Returns a pointer to the value for the given key, or nullptr if
+  // the key is not in the collection.
+  V* find(const K& key);
+  const V* find(const K& key) const;
+
+  // Sets the value for the given key, adding the key-value pair if
+  // the key is not in the collection. Returns true if the pair was
+  // added and false if an existing value was replaced.
+  bool insert_or_assign(const K& key, const V& value);
+
+  // Adds the key-value pair if the key is not in the collection and
+  // otherwise leaves the existing value alone. Returns true if the
+  // pair was added.
+  bool try_emplace(const K& key, const V& value);
+
+  // Returns the keys k in the collection such that k1 <= k <= k2
+  ArraySeq<K> find_keys(const K& k1, const K& k2) const;
+
+  // Returns the keys in the collection in ascending sorted order
+  ArraySeq<K> sorted_keys() const;
+
+  // statistics functions for the hash table implementation. A
+  // "chain" here is the probe sequence walked to reach a key, so
+  // the length of an entry's chain is its distance from its home
+  // slot plus one.
+  int min_chain_length() const;
+  int max_chain_length() const;
+  double avg_chain_length() const;
+
+private:
+
+  // table slot, key and value are stored inline. dist is the
+  // distance from the key's home slot, or -1 if the slot is empty.
+  struct Slot {
+    K key;
+    V value;
+    int dist = -1;
+  };
+
+  // number of key-value pairs in map
+  int count = 0;
+
+  // max size of the (array) table, always a power of two
+  int capacity = 16;
+
+  // threshold for resize and rehash (robin hood keeps probe
+  // sequences short even at high load)
+  const double load_factor_threshold = 0.9;
+
+  // flat array of slots
+  Slot* table = nullptr;
+
+  // the user supplied hasher
+  Hash hasher;
+
+  // the hash function (hasher output run through mix_hash, so keys
+  // that differ only in high bits still get different home slots)
+  std::size_t hash(const K& key) const;
+
+  // returns the index of the slot holding key, or -1 if not found
+  int find_index(const K& key) const;
+
+  // insert_or_assign and try_emplace helper, searches for the key
+  // once and either adds the pair or (if assign) replaces the value
+  bool insert_unique(const K& key, const V& value, bool assign);
+
+  // places the pair without checking the load factor, probing from
+  // index where the pair is dist slots from home
+  void place(K key, V value, int index, int dist);
+
+  // resize and rehash the table
+  void resize_and_rehash();
+
+  // clean up the table and reset member variables
+  void make_empty();
+};
+//}}}
+
+//{{{ public functions / essential operators
+// default constructor
+template<typename K, typename V, typename Hash>
+RobinHoodMap<K,V,Hash>::RobinHoodMap()
+{
+  table = new Slot[capacity];
+}
+
+// copy constructor
+template<typename K, typename V, typename Hash>
+RobinHoodMap<K,V,Hash>::RobinHoodMap(const RobinHoodMap& rhs)
+{
+  count = rhs.count;
+  capacity = rhs.capacity;
+  hasher = rhs.hasher;
+  table = new Slot[capacity];
+  for (int i = 0; i < capacity; ++i)
+    table[i] = rhs.table[i];
+}
+
+// move constructor
+template<typename K, typename V, typename Hash>
+RobinHoodMap<K,V,Hash>::RobinHoodMap(RobinHoodMap&& rhs)
+{
+  count = rhs.count;
+  capacity = rhs.capacity;
+  hasher = rhs.hasher;
+  table = rhs.table;
+  rhs.count = 0;
+  rhs.capacity = 16;
+  rhs.table = new Slot[rhs.capacity];
+}
+
+// copy assignment
+template<typename K, typename V, typename Hash>
+RobinHoodMap<K,V,Hash>& RobinHoodMap<K,V,Hash>::operator=(const RobinHoodMap& rhs)
+{
+  if (this != &rhs)
+  {
+    make_empty();
+    count = rhs.count;
+    capacity = rhs.capacity;
+    hasher = rhs.hasher;
+    table = new Slot[capacity];
+    for (int i = 0; i < capacity; ++i)
+      table[i] = rhs.table[i];
+  }
+  return *this;
+}
+
+// move assignment
+template<typename K, typename V, typename Hash>
+RobinHoodMap<K,V,Hash>& RobinHoodMap<K,V,Hash>::operator=(RobinHoodMap&& rhs)
+{
+  if (this != &rhs)
+  {
+    make_empty();
+    count = rhs.count;
+    capacity = rhs.capacity;
+    hasher = rhs.hasher;
+    table = rhs.table;
+    rhs.count = 0;
+    rhs.capacity = 16;
+    rhs.table = new Slot[rhs.capacity];
+  }
+  return *this;
+}
+
+// destructor
+template<typename K, typename V, typename Hash>
+RobinHoodMap<K,V,Hash>::~RobinHoodMap()
+{
+  make_empty();
+}
+
+// Returns the number of key-value pairs in the map
+template<typename K, typename V, typename Hash>
+int RobinHoodMap<K,V,Hash>::size() const
+{
+  return count;
+}
+
+// Tests if the map is empty
+template<typename K, typename V, typename Hash>
+bool RobinHoodMap<K,V,Hash>::empty() const
+{
+  return count == 0;
+}
+
+// Allows values associated with a key to be updated. Throws
+// out_of_range if the given key is not in the collection.
+template<typename K, typename V, typename Hash>
+V& RobinHoodMap<K,V,Hash>::operator[](const K& key)
+{
+  int index = find_index(key);
+  if (index == -1)
+    throw std::out_of_range("V& RobinHoodMap<K,V,Hash>::operator[](const K& key). Key does not exist.");
+  return table[index].value;
+}
+
+// Returns the value for a given key. Throws out_of_range if the
+// given key is not in the collection.
+template<typename K, typename V, typename Hash>
+const V& RobinHoodMap<K,V,Hash>::operator[](const K& key) const
+{
+  int index = find_index(key);
+  if (index == -1)
+    throw std::out_of_range("const V& RobinHoodMap<K,V,Hash>::operator[](const K& key) const. Key does not exist.");
+  return table[index].value;
+}
+
+// Extends the collection by adding the given key-value
+// pair. Assumes the key being added is not present in the
+// collection. Insert does not check if the key is present.
+template<typename K, typename V, typename Hash>
+void RobinHoodMap<K,V,Hash>::insert(const K& key, const V& value)
+{
+  if ((count + 1) * 1.0 > capacity * load_factor_threshold)
+    resize_and_rehash();
+  place(key, value, hash(key) & (capacity - 1), 0);
+  count++;
+}
+
+// Shrinks the collection by removing the key-value pair with the
+// given key. Does not modify the collection if the collection does
+// not contain the key. Throws out_of_range if the given key is not
+// in the collection.
+template<typename K, typename V, typename Hash>
+void RobinHoodMap<K,V,Hash>::erase(const K& key)
+{
+  int index = find_index(key);
+  if (index == -1)
+    throw std::out_of_range("void RobinHoodMap<K,V,Hash>::erase(const K& key). Key does not exist.");
+
+  // backward shift: pull each displaced successor one slot closer
+  // to home until we hit an empty slot or an entry already at home
+  int mask = capacity - 1;
+  int next = (index + 1) & mask;
+  while (table[next].dist > 0)
+  {
+    table[index].key = std::move(table[next].key);
+    table[index].value = std::move(table[next].value);
+    table[index].dist = table[next].dist - 1;
+    index = next;
+    next = (next + 1) & mask;
+  }
+  table[index].key = K();
+  table[index].value = V();
+  table[index].dist = -1;
+  count--;
+}
+
+// Returns true if the key is in the collection, and false otherwise.
+template<typename K, typename V, typename Hash>
+bool RobinHoodMap<K,V,Hash>::contains(const K& key) const
+{
+  return find_index(key) != -1;
+}
+
+// Returns a pointer to the value for the given key, or nullptr if
+// the key is not in the collection.
+template<typename K, typename V, typename Hash>
+V* RobinHoodMap<K,V,Hash>::find(const K& key)
+{
+  int index = find_index(key);
+  if (index == -1)
+    return nullptr;
+  return &table[index].value;
+}
+
+// Returns a pointer to the value for the given key, or nullptr if
+// the key is not in the collection.
+template<typename K, typename V, typename Hash>
+const V* RobinHoodMap<K,V,Hash>::find(const K& key) const
+{
+  int index = find_index(key);
+  if (index == -1)
+    return nullptr;
+  return &table[index].value;
+}
+
+// Sets the value for the given key, adding the key-value pair if
+// the key is not in the collection. Returns true if the pair was
+// added and false if an existing value was replaced.
+template<typename K, typename V, typename Hash>
+bool RobinHoodMap<K,V,Hash>::insert_or_assign(const K& key, const V& value)
+{
+  return insert_unique(key, value, true);
+}
+
+// Adds the key-value pair if the key is not in the collection and
+// otherwise leaves the existing value alone. Returns true if the
+// pair was added.
+template<typename K, typename V, typename Hash>
+bool RobinHoodMap<K,V,Hash>::try_emplace(const K& key, const V& value)
+{
+  return insert_unique(key, value, false);
+}
+
+// Returns the keys k in the collection such that k1 <= k <= k2
+template<typename K, typename V, typename Hash>
+ArraySeq<K> RobinHoodMap<K,V,Hash>::find_keys(const K& k1, const K& k2) const
+{
+  ArraySeq<K> keys;
+  for (int i = 0; i < capacity; ++i)
+  {
+    if (table[i].dist != -1 and table[i].key >= k1 and table[i].key <= k2)
+      keys.insert(table[i].key, keys.size());
+  }
+  return keys;
+}
+
+// Returns the keys in the collection in ascending sorted order
+template<typename K, typename V, typename Hash>
+ArraySeq<K> RobinHoodMap<K,V,Hash>::sorted_keys() const
+{
+  ArraySeq<K> keys;
+  for (int i = 0; i < capacity; ++i)
+  {
+    if (table[i].dist != -1)
+      keys.insert(table[i].key, keys.size());
+  }
+  keys.sort();
+  return keys;
+}
+//}}}
+
+//{{{ statistics functions for the hash table implementation
+template<typename K, typename V, typename Hash>
+int RobinHoodMap<K,V,Hash>::min_chain_length() const
+{
+  if (count == 0)
+    return 0;
+
+  int minChain = capacity;
+  for (int i = 0; i < capacity; ++i)
+  {
+    if (table[i].dist != -1 and table[i].dist + 1 < minChain)
+      minChain = table[i].dist + 1;
+  }
+  return minChain;
+}
+
+template<typename K, typename V, typename Hash>
+int RobinHoodMap<K,V,Hash>::max_chain_length() const
+{
+  int maxChain = 0;
+  for (int i = 0; i < capacity; ++i)
+  {
+    if (table[i].dist + 1 > maxChain)
+      maxChain = table[i].dist + 1;
+  }
+  return maxChain;
+}
+
+template<typename K, typename V, typename Hash>
+double RobinHoodMap<K,V,Hash>::avg_chain_length() const
+{
+  if (count == 0)
+    return 0.0;
+
+  long total = 0;
+  for (int i = 0; i < capacity; ++i)
+  {
+    if (table[i].dist != -1)
+      total += table[i].dist + 1;
+  }
+  return (total * 1.0) / (count * 1.0);
+}
+//}}}
+
+//{{{ private functions
+// the hash function
+template<typename K, typename V, typename Hash>
+std::size_t RobinHoodMap<K,V,Hash>::hash(const K& key) const
+{
+  return mix_hash(hasher(key));
+}
+
+// returns the index of the slot holding key, or -1 if not found
+template<typename K, typename V, typename Hash>
+int RobinHoodMap<K,V,Hash>::find_index(const K& key) const
+{
+  int mask = capacity - 1;
+  int index = hash(key) & mask;
+  int dist = 0;
+  // once we pass an entry closer to its home than we are to ours,
+  // the key cannot be further along (robin hood invariant)
+  while (table[index].dist >= dist)
+  {
+    if (table[index].key == key)
+      return index;
+    index = (index + 1) & mask;
+    dist++;
+  }
+  return -1;
+}
+
+// insert_or_assign and try_emplace helper
+template<typename K, typename V, typename Hash>
+bool RobinHoodMap<K,V,Hash>::insert_unique(const K& key, const V& value, bool assign)
+{
+  if ((count + 1) * 1.0 > capacity * load_factor_threshold)
+    resize_and_rehash();
+
+  int mask = capacity - 1;
+  int index = hash(key) & mask;
+  int dist = 0;
+  while (table[index].dist >= dist)
+  {
+    if (table[index].key == key)
+    {
+      if (assign)
+        table[index].value = value;
+      return false;
+    }
+    index = (index + 1) & mask;
+    dist++;
+  }
+
+  // the lookup stopped exactly where a robin hood insert would
+  // start displacing entries, so continue the insert from here
+  place(key, value, index, dist);
+  count++;
+  return true;
+}
+
+// places the pair without checking the load factor
+template<typename K, typename V, typename Hash>
+void RobinHoodMap<K,V,Hash>::place(K key, V value, int index, int dist)
+{
+  int mask = capacity - 1;
+  while (table[index].dist != -1)
+  {
+    // take from the rich: the resident is closer to home than we
+    // are, so it gives up its slot and continues probing instead
+    if (table[index].dist < dist)
+    {
+      std::swap(key, table[index].key);
+      std::swap(value, table[index].value);
+      std::swap(dist, table[index].dist);
+    }
+    index = (index + 1) & mask;
+    dist++;
+  }
+  table[index].key = std::move(key);
+  table[index].value = std::move(value);
+  table[index].dist = dist;
+}
+
+// resize and rehash the table
+template<typename K, typename V, typename Hash>
+void RobinHoodMap<K,V,Hash>::resize_and_rehash()
+{
+  Slot* old = table;
+  int old_capacity = capacity;
+  capacity *= 2;
+  table = new Slot[capacity];
+  for (int i = 0; i < old_capacity; ++i)
+  {
+    if (old[i].dist != -1)
+    {
+      int index = hash(old[i].key) & (capacity - 1);
+      place(std::move(old[i].key), std::move(old[i].value), index, 0);
+    }
+  }
+  delete[] old;
+}
+
+// clean up the table and reset member variables
+template<typename K, typename V, typename Hash>
+void RobinHoodMap<K,V,Hash>::make_empty()
+{
+  delete[] table;
+  table = nullptr;
+  count = 0;
+}
+//}}}
+
+#endif
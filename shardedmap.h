@@ -0,0 +1,457 @@
+//---------------------------------------------------------------------------
+// NAME: Adam Huonder
+// DATE: Fall 2021
+// DESC: Implements a map split into independent HashMap shards,
+//       chosen by the high bits of each key's hash
+//---------------------------------------------------------------------------
+
+#ifndef SHARDEDMAP_H
+#define SHARDEDMAP_H
+
+#include <cstdint>
+#include <functional>
+#include <stdexcept>
+#include <utility>
+#include "map.h"
+#include "arrayseq.h"
+#include "hashmap.h"
+
+//{{{ Header
+// A key always lives in shard shard_of(key), picked from the high 32
+// bits of its hash (the shard's own HashMap uses the low bits to pick
+// a bucket). The shards share no state, so different threads may
+// work on different shards at the same time through shard(i) and
+// the per-shard batch functions, as long as no thread is using a
+// whole-map function (insert, size, sorted_keys, ...) meanwhile.
+template<typename K, typename V, typename Hash = std::hash<K>>
+class ShardedMap : public Map<K,V>
+{
+public:
+
+  // creates a map with the given number of shards (at least 1)
+  ShardedMap(int shards = 16);
+
+  // copy constructor
+  ShardedMap(const ShardedMap& rhs);
+
+  // move constructor
+  ShardedMap(ShardedMap&& rhs);
+
+  // copy assignment
+  ShardedMap& operator=(const ShardedMap& rhs);
+
+  // move assignment
+  ShardedMap& operator=(ShardedMap&& rhs);
+
+  // destructor
+  ~ShardedMap();
+
+  // Returns the number of key-value pairs in the map
+  int size() const;
+
+  // Tests if the map is empty
+  bool empty() const;
+
+  // Allows values associated with a key to be updated. Throws
+  // out_of_range if the given key is not in the collection.
+  V& operator[](const K& key);
+
+  // Returns the value for a given key. Throws out_of_range if the
+  // given key is not in the collection.
+  const V& operator[](const K& key) const;
+
+  // Extends the collection by adding the given key-value
+  // pair. Assumes the key being added is not present in the
+  // collection. Insert does not check if the key is present.
+  void insert(const K& key, const V& value);
+
+  // Shrinks the collection by removing the key-value pair with the
+  // given key. Throws out_of_range if the given key is not in the
+  // collection.
+  void erase(const K& key);
+
+  // Returns true if the key is in the collection, and false otherwise.
+  bool contains(const K& key) const;
+
+  // Returns a pointer to the value for the given key, or nullptr if
+  // the key is not in the collection.
+  V* find(const K& key);
+  const V* find(const K& key) const;
+
+  // Sets the value for the given key, adding the key-value pair if
+  // the key is not in the collection. Returns true if the pair was
+  // added and false if an existing value was replaced.
+  bool insert_or_assign(const K& key, const V& value);
+
+  // Adds the key-value pair if the key is not in the collection and
+  // otherwise leaves the existing value alone. Returns true if the
+  // pair was added.
+  bool try_emplace(const K& key, const V& value);
+
+  // Returns the keys k in the collection such that k1 <= k <= k2
+  // (grouped by shard, not sorted)
+  ArraySeq<K> find_keys(const K& k1, const K& k2) const;
+
+  // Returns the keys in the collection in ascending sorted order
+  ArraySeq<K> sorted_keys() const;
+
+  // Returns the number of shards
+  int shard_count() const;
+
+  // Returns the shard the key belongs to
+  int shard_of(const K& key) const;
+
+  // Returns the given shard
+  HashMap<K,V,Hash>& shard(int i);
+  const HashMap<K,V,Hash>& shard(int i) const;
+
+  // Splits a batch of keys (or pairs) by shard. parts must point to
+  // shard_count() sequences, and each item is appended (in its
+  // original order) to parts[i] for the shard i it belongs to.
+  void partition(const ArraySeq<K>& keys, ArraySeq<K>* parts) const;
+  void partition(const ArraySeq<std::pair<K,V>>& pairs, ArraySeq<std::pair<K,V>>* parts) const;
+
+  // Batch operations on one shard. Every key must belong to shard i
+  // (see partition). They touch only that shard, so a thread can
+  // work through a whole shard without contending with other shards.
+  void insert_shard(int i, const ArraySeq<std::pair<K,V>>& pairs);
+  ArraySeq<bool> contains_shard(int i, const ArraySeq<K>& keys) const;
+  ArraySeq<const V*> find_shard(int i, const ArraySeq<K>& keys) const;
+
+  // statistics functions for the shards, entry i is for shard i
+  ArraySeq<int> shard_sizes() const;
+  ArraySeq<int> shard_max_chain_lengths() const;
+  ArraySeq<double> shard_avg_chain_lengths() const;
+
+private:
+
+  // number of shards
+  int nshards;
+
+  // the shards
+  HashMap<K,V,Hash>* shards = nullptr;
+
+  // the user supplied hasher
+  Hash hasher;
+
+  // throws out_of_range if i is not a shard index
+  void check_shard(int i) const;
+};
+//}}}
+
+//{{{ public functions / essential operators
+// creates a map with the given number of shards
+template<typename K, typename V, typename Hash>
+ShardedMap<K,V,Hash>::ShardedMap(int shards)
+{
+  if (shards < 1)
+    throw std::invalid_argument("ShardedMap<K,V,Hash>::ShardedMap(int shards). Need at least one shard.");
+  nshards = shards;
+  this->shards = new HashMap<K,V,Hash>[nshards];
+}
+
+// copy constructor
+template<typename K, typename V, typename Hash>
+ShardedMap<K,V,Hash>::ShardedMap(const ShardedMap& rhs)
+{
+  nshards = rhs.nshards;
+  hasher = rhs.hasher;
+  shards = new HashMap<K,V,Hash>[nshards];
+  for (int i = 0; i < nshards; ++i)
+    shards[i] = rhs.shards[i];
+}
+
+// move constructor
+template<typename K, typename V, typename Hash>
+ShardedMap<K,V,Hash>::ShardedMap(ShardedMap&& rhs)
+{
+  nshards = rhs.nshards;
+  hasher = rhs.hasher;
+  shards = rhs.shards;
+  rhs.shards = new HashMap<K,V,Hash>[rhs.nshards];
+}
+
+// copy assignment
+template<typename K, typename V, typename Hash>
+ShardedMap<K,V,Hash>& ShardedMap<K,V,Hash>::operator=(const ShardedMap& rhs)
+{
+  if (this != &rhs)
+  {
+    delete[] shards;
+    nshards = rhs.nshards;
+    hasher = rhs.hasher;
+    shards = new HashMap<K,V,Hash>[nshards];
+    for (int i = 0; i < nshards; ++i)
+      shards[i] = rhs.shards[i];
+  }
+  return *this;
+}
+
+// move assignment
+template<typename K, typename V, typename Hash>
+ShardedMap<K,V,Hash>& ShardedMap<K,V,Hash>::operator=(ShardedMap&& rhs)
+{
+  if (this != &rhs)
+  {
+    delete[] shards;
+    nshards = rhs.nshards;
+    hasher = rhs.hasher;
+    shards = rhs.shards;
+    rhs.shards = new HashMap<K,V,Hash>[rhs.nshards];
+  }
+  return *this;
+}
+
+// destructor
+template<typename K, typename V, typename Hash>
+ShardedMap<K,V,Hash>::~ShardedMap()
+{
+  delete[] shards;
+}
+
+// Returns the number of key-value pairs in the map
+template<typename K, typename V, typename Hash>
+int ShardedMap<K,V,Hash>::size() const
+{
+  int count = 0;
+  for (int i = 0; i < nshards; ++i)
+    count += shards[i].size();
+  return count;
+}
+
+// Tests if the map is empty
+template<typename K, typename V, typename Hash>
+bool ShardedMap<K,V,Hash>::empty() const
+{
+  for (int i = 0; i < nshards; ++i)
+  {
+    if (!shards[i].empty())
+      return false;
+  }
+  return true;
+}
+
+// Allows values associated with a key to be updated. Throws
+// out_of_range if the given key is not in the collection.
+template<typename K, typename V, typename Hash>
+V& ShardedMap<K,V,Hash>::operator[](const K& key)
+{
+  return shards[shard_of(key)][key];
+}
+
+// Returns the value for a given key. Throws out_of_range if the
+// given key is not in the collection.
+template<typename K, typename V, typename Hash>
+const V& ShardedMap<K,V,Hash>::operator[](const K& key) const
+{
+  const HashMap<K,V,Hash>& s = shards[shard_of(key)];
+  return s[key];
+}
+
+// Extends the collection by adding the given key-value
+// pair. Assumes the key being added is not present in the
+// collection. Insert does not check if the key is present.
+template<typename K, typename V, typename Hash>
+void ShardedMap<K,V,Hash>::insert(const K& key, const V& value)
+{
+  shards[shard_of(key)].insert(key, value);
+}
+
+// Shrinks the collection by removing the key-value pair with the
+// given key. Throws out_of_range if the given key is not in the
+// collection.
+template<typename K, typename V, typename Hash>
+void ShardedMap<K,V,Hash>::erase(const K& key)
+{
+  shards[shard_of(key)].erase(key);
+}
+
+// Returns true if the key is in the collection, and false otherwise.
+template<typename K, typename V, typename Hash>
+bool ShardedMap<K,V,Hash>::contains(const K& key) const
+{
+  return shards[shard_of(key)].contains(key);
+}
+
+// Returns a pointer to the value for the given key, or nullptr if
+// the key is not in the collection.
+template<typename K, typename V, typename Hash>
+V* ShardedMap<K,V,Hash>::find(const K& key)
+{
+  return shards[shard_of(key)].find(key);
+}
+
+// Returns a pointer to the value for the given key, or nullptr if
+// the key is not in the collection.
+template<typename K, typename V, typename Hash>
+const V* ShardedMap<K,V,Hash>::find(const K& key) const
+{
+  const HashMap<K,V,Hash>& s = shards[shard_of(key)];
+  return s.find(key);
+}
+
+// Sets the value for the given key, adding the key-value pair if
+// the key is not in the collection.
+template<typename K, typename V, typename Hash>
+bool ShardedMap<K,V,Hash>::insert_or_assign(const K& key, const V& value)
+{
+  return shards[shard_of(key)].insert_or_assign(key, value);
+}
+
+// Adds the key-value pair if the key is not in the collection.
+template<typename K, typename V, typename Hash>
+bool ShardedMap<K,V,Hash>::try_emplace(const K& key, const V& value)
+{
+  return shards[shard_of(key)].try_emplace(key, value);
+}
+
+// Returns the keys k in the collection such that k1 <= k <= k2
+template<typename K, typename V, typename Hash>
+ArraySeq<K> ShardedMap<K,V,Hash>::find_keys(const K& k1, const K& k2) const
+{
+  ArraySeq<K> keys;
+  for (int i = 0; i < nshards; ++i)
+  {
+    ArraySeq<K> part = shards[i].find_keys(k1, k2);
+    for (int j = 0; j < part.size(); ++j)
+      keys.insert(part[j], keys.size());
+  }
+  return keys;
+}
+
+// Returns the keys in the collection in ascending sorted order
+template<typename K, typename V, typename Hash>
+ArraySeq<K> ShardedMap<K,V,Hash>::sorted_keys() const
+{
+  ArraySeq<K> keys;
+  for (int i = 0; i < nshards; ++i)
+  {
+    ArraySeq<K> part = shards[i].sorted_keys();
+    for (int j = 0; j < part.size(); ++j)
+      keys.insert(part[j], keys.size());
+  }
+  if (nshards > 1)
+    keys.sort();
+  return keys;
+}
+
+// Returns the number of shards
+template<typename K, typename V, typename Hash>
+int ShardedMap<K,V,Hash>::shard_count() const
+{
+  return nshards;
+}
+
+// Returns the shard the key belongs to. The high 32 bits of the hash
+// are scaled to [0, nshards) with a multiply instead of a division.
+template<typename K, typename V, typename Hash>
+int ShardedMap<K,V,Hash>::shard_of(const K& key) const
+{
+  std::uint64_t high = mix_hash(hasher(key)) >> 32;
+  return (high * nshards) >> 32;
+}
+
+// Returns the given shard
+template<typename K, typename V, typename Hash>
+HashMap<K,V,Hash>& ShardedMap<K,V,Hash>::shard(int i)
+{
+  check_shard(i);
+  return shards[i];
+}
+
+// Returns the given shard
+template<typename K, typename V, typename Hash>
+const HashMap<K,V,Hash>& ShardedMap<K,V,Hash>::shard(int i) const
+{
+  check_shard(i);
+  return shards[i];
+}
+
+// Splits a batch of keys by shard
+template<typename K, typename V, typename Hash>
+void ShardedMap<K,V,Hash>::partition(const ArraySeq<K>& keys, ArraySeq<K>* parts) const
+{
+  for (int i = 0; i < keys.size(); ++i)
+  {
+    ArraySeq<K>& part = parts[shard_of(keys[i])];
+    part.insert(keys[i], part.size());
+  }
+}
+
+// Splits a batch of pairs by shard
+template<typename K, typename V, typename Hash>
+void ShardedMap<K,V,Hash>::partition(const ArraySeq<std::pair<K,V>>& pairs, ArraySeq<std::pair<K,V>>* parts) const
+{
+  for (int i = 0; i < pairs.size(); ++i)
+  {
+    ArraySeq<std::pair<K,V>>& part = parts[shard_of(pairs[i].first)];
+    part.insert(pairs[i], part.size());
+  }
+}
+
+// Adds a batch of pairs that all belong to shard i
+template<typename K, typename V, typename Hash>
+void ShardedMap<K,V,Hash>::insert_shard(int i, const ArraySeq<std::pair<K,V>>& pairs)
+{
+  check_shard(i);
+  shards[i].insert_range(pairs);
+}
+
+// Looks up a batch of keys that all belong to shard i
+template<typename K, typename V, typename Hash>
+ArraySeq<bool> ShardedMap<K,V,Hash>::contains_shard(int i, const ArraySeq<K>& keys) const
+{
+  check_shard(i);
+  return shards[i].contains_many(keys);
+}
+
+// Looks up a batch of keys that all belong to shard i
+template<typename K, typename V, typename Hash>
+ArraySeq<const V*> ShardedMap<K,V,Hash>::find_shard(int i, const ArraySeq<K>& keys) const
+{
+  check_shard(i);
+  const HashMap<K,V,Hash>& s = shards[i];
+  return s.find_many(keys);
+}
+//}}}
+
+//{{{ statistics functions for the shards
+template<typename K, typename V, typename Hash>
+ArraySeq<int> ShardedMap<K,V,Hash>::shard_sizes() const
+{
+  ArraySeq<int> sizes;
+  for (int i = 0; i < nshards; ++i)
+    sizes.insert(shards[i].size(), sizes.size());
+  return sizes;
+}
+
+template<typename K, typename V, typename Hash>
+ArraySeq<int> ShardedMap<K,V,Hash>::shard_max_chain_lengths() const
+{
+  ArraySeq<int> lengths;
+  for (int i = 0; i < nshards; ++i)
+    lengths.insert(shards[i].max_chain_length(), lengths.size());
+  return lengths;
+}
+
+template<typename K, typename V, typename Hash>
+ArraySeq<double> ShardedMap<K,V,Hash>::shard_avg_chain_lengths() const
+{
+  ArraySeq<double> lengths;
+  for (int i = 0; i < nshards; ++i)
+    lengths.insert(shards[i].avg_chain_length(), lengths.size());
+  return lengths;
+}
+//}}}
+
+//{{{ private functions
+// throws out_of_range if i is not a shard index
+template<typename K, typename V, typename Hash>
+void ShardedMap<K,V,Hash>::check_shard(int i) const
+{
+  if (i < 0 or i >= nshards)
+    throw std::out_of_range("ShardedMap<K,V,Hash>::check_shard(int i). Invalid shard index.");
+}
+//}}}
+
+#endif
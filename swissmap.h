@@ -0,0 +1,687 @@
+//---------------------------------------------------------------------------
+// NAME: Adam Huonder
+// DATE: Fall 2021
+// DESC: Implements an open-addressing hash map using Swiss-table
+//       style control bytes probed sixteen slots at a time
+//---------------------------------------------------------------------------
+
+#ifndef SWISSMAP_H
+#define SWISSMAP_H
+
+#include <functional>
+#include <cstdint>
+#include <utility>
+#include "map.h"
+#include "arrayseq.h"
+#include "hashmap.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+//{{{ Header
+// Hash is the hasher for K, std::hash<K> unless a custom one is given
+template<typename K, typename V, typename Hash = std::hash<K>>
+class SwissMap : public Map<K,V>
+{
+public:
+
+  // default constructor
+  SwissMap();
+
+  // copy constructor
+  SwissMap(const SwissMap& rhs);
+
+  // move constructor
+  SwissMap(SwissMap&& rhs);
+
+  // copy assignment
+  SwissMap& operator=(const SwissMap& rhs);
+
+  // move assignment
+  SwissMap& operator=(SwissMap&& rhs);
+
+  // destructor
+  ~SwissMap();
+
+  // Returns the number of key-value pairs in the map
+  int size() const;
+
+  // Tests if the map is empty
+  bool empty() const;
+
+  // Allows values associated with a key to be updated. Throws
+  // out_of_range if the given key is not in the collection.
+  V& operator[](const K& key);
+
+  // Returns the value for a given key. Throws out_of_range if the
+  // given key is not in the collection.
+  const V& operator[](const K& key) const;
+
+  // Extends the collection by adding the given key-value
+  // pair. Assumes the key being added is not present in the
+  // collection. Insert does not check if the key is present.
+  void insert(const K& key, const V& value);
+
+  // Shrinks the collection by removing the key-value pair with the
+  // given key. Does not modify the collection if the collection does
+  // not contain the key. Throws out_of_range if the given key is not
+  // in the collection.
+  void erase(const K& key);
+
+  // Returns true if the key is in the collection, and false otherwise.
+  bool contains(const K& key) const;
+
+  // Returns a pointer to the value for the given key, or nullptr if
+  // the key is not in the collection.
+  V* find(const K& key);
+  const V* find(const K& key) const;
+
+  // Sets the value for the given key, adding the key-value pair if
+  // the key is not in the collection. Returns true if the pair was
+  // added and false if an existing value was replaced.
+  bool insert_or_assign(const K& key, const V& value);
+
+  // Adds the key-value pair if the key is not in the collection and
+  // otherwise leaves the existing value alone. Returns true if the
+  // pair was added.
+  bool try_emplace(const K& key, const V& value);
+
+  // Returns the keys k in the collection such that k1 <= k <= k2
+  ArraySeq<K> find_keys(const K& k1, const K& k2) const;
+
+  // Returns the keys in the collection in ascending sorted order
+  ArraySeq<K> sorted_keys() const;
+
+  // statistics functions for the hash table implementation. The
+  // length of an entry's chain is the number of groups probed to
+  // reach it.
+  int min_chain_length() const;
+  int max_chain_length() const;
+  double avg_chain_length() const;
+
+private:
+
+  // control byte states. A full slot holds the low 7 bits of the
+  // key's hash (0..127), so the high bit marks empty and deleted.
+  static const signed char EMPTY = -128;
+  static const signed char DELETED = -2;
+
+  // number of slots probed at once
+  static const int GROUP_WIDTH = 16;
+
+  // key-value storage for a slot
+  struct Slot {
+    K key;
+    V value;
+  };
+
+  // number of key-value pairs in map
+  int count = 0;
+
+  // number of deleted (tombstone) slots
+  int deleted = 0;
+
+  // number of slots, always a power of two multiple of GROUP_WIDTH
+  int capacity = GROUP_WIDTH;
+
+  // one control byte per slot
+  signed char* ctrl = nullptr;
+
+  // slot array parallel to ctrl
+  Slot* slots = nullptr;
+
+  // the user supplied hasher
+  Hash hasher;
+
+  // the hash function (hasher output run through mix_hash so the 7
+  // bit tag and the group index both depend on every input bit)
+  std::uint64_t hash(const K& key) const;
+
+  // bitmask of slots in the group starting at index whose control
+  // byte equals tag
+  int match(int index, signed char tag) const;
+
+  // bitmask of empty slots in the group starting at index
+  int match_empty(int index) const;
+
+  // bitmask of empty or deleted slots in the group starting at index
+  int match_free(int index) const;
+
+  // returns the slot index holding key, or -1 if not found
+  int find_index(const K& key) const;
+
+  // insert_or_assign and try_emplace helper, searches for the key
+  // once and either adds the pair or (if assign) replaces the value
+  bool insert_unique(const K& key, const V& value, bool assign);
+
+  // returns the number of groups probed to reach the slot at index
+  int probe_length(int index) const;
+
+  // places the pair in the first free slot along its probe sequence
+  void place(const K& key, const V& value);
+
+  // resize and rehash the table (also clears tombstones)
+  void resize_and_rehash(int new_capacity);
+
+  // allocate ctrl and slots for the current capacity
+  void init_table();
+
+  // clean up the table and reset member variables
+  void make_empty();
+};
+//}}}
+
+//{{{ public functions / essential operators
+// default constructor
+template<typename K, typename V, typename Hash>
+SwissMap<K,V,Hash>::SwissMap()
+{
+  init_table();
+}
+
+// copy constructor
+template<typename K, typename V, typename Hash>
+SwissMap<K,V,Hash>::SwissMap(const SwissMap& rhs)
+{
+  hasher = rhs.hasher;
+  count = rhs.count;
+  deleted = rhs.deleted;
+  capacity = rhs.capacity;
+  init_table();
+  for (int i = 0; i < capacity; ++i)
+  {
+    ctrl[i] = rhs.ctrl[i];
+    if (ctrl[i] >= 0)
+      slots[i] = rhs.slots[i];
+  }
+}
+
+// move constructor
+template<typename K, typename V, typename Hash>
+SwissMap<K,V,Hash>::SwissMap(SwissMap&& rhs)
+{
+  hasher = rhs.hasher;
+  count = rhs.count;
+  deleted = rhs.deleted;
+  capacity = rhs.capacity;
+  ctrl = rhs.ctrl;
+  slots = rhs.slots;
+  rhs.count = 0;
+  rhs.deleted = 0;
+  rhs.capacity = GROUP_WIDTH;
+  rhs.init_table();
+}
+
+// copy assignment
+template<typename K, typename V, typename Hash>
+SwissMap<K,V,Hash>& SwissMap<K,V,Hash>::operator=(const SwissMap& rhs)
+{
+  if (this != &rhs)
+  {
+    make_empty();
+    hasher = rhs.hasher;
+    count = rhs.count;
+    deleted = rhs.deleted;
+    capacity = rhs.capacity;
+    init_table();
+    for (int i = 0; i < capacity; ++i)
+    {
+      ctrl[i] = rhs.ctrl[i];
+      if (ctrl[i] >= 0)
+        slots[i] = rhs.slots[i];
+    }
+  }
+  return *this;
+}
+
+// move assignment
+template<typename K, typename V, typename Hash>
+SwissMap<K,V,Hash>& SwissMap<K,V,Hash>::operator=(SwissMap&& rhs)
+{
+  if (this != &rhs)
+  {
+    make_empty();
+    hasher = rhs.hasher;
+    count = rhs.count;
+    deleted = rhs.deleted;
+    capacity = rhs.capacity;
+    ctrl = rhs.ctrl;
+    slots = rhs.slots;
+    rhs.count = 0;
+    rhs.deleted = 0;
+    rhs.capacity = GROUP_WIDTH;
+    rhs.init_table();
+  }
+  return *this;
+}
+
+// destructor
+template<typename K, typename V, typename Hash>
+SwissMap<K,V,Hash>::~SwissMap()
+{
+  make_empty();
+}
+
+// Returns the number of key-value pairs in the map
+template<typename K, typename V, typename Hash>
+int SwissMap<K,V,Hash>::size() const
+{
+  return count;
+}
+
+// Tests if the map is empty
+template<typename K, typename V, typename Hash>
+bool SwissMap<K,V,Hash>::empty() const
+{
+  return count == 0;
+}
+
+// Allows values associated with a key to be updated. Throws
+// out_of_range if the given key is not in the collection.
+template<typename K, typename V, typename Hash>
+V& SwissMap<K,V,Hash>::operator[](const K& key)
+{
+  int index = find_index(key);
+  if (index == -1)
+    throw std::out_of_range("V& SwissMap<K,V,Hash>::operator[](const K& key). Key does not exist.");
+  return slots[index].value;
+}
+
+// Returns the value for a given key. Throws out_of_range if the
+// given key is not in the collection.
+template<typename K, typename V, typename Hash>
+const V& SwissMap<K,V,Hash>::operator[](const K& key) const
+{
+  int index = find_index(key);
+  if (index == -1)
+    throw std::out_of_range("const V& SwissMap<K,V,Hash>::operator[](const K& key) const. Key does not exist.");
+  return slots[index].value;
+}
+
+// Extends the collection by adding the given key-value
+// pair. Assumes the key being added is not present in the
+// collection. Insert does not check if the key is present.
+template<typename K, typename V, typename Hash>
+void SwissMap<K,V,Hash>::insert(const K& key, const V& value)
+{
+  // keep at least 1/8 of the slots empty so every probe terminates
+  if ((count + deleted + 1) * 8 > capacity * 7)
+  {
+    if (count * 2 < capacity)
+      resize_and_rehash(capacity);
+    else
+      resize_and_rehash(capacity * 2);
+  }
+  place(key, value);
+  count++;
+}
+
+// Shrinks the collection by removing the key-value pair with the
+// given key. Does not modify the collection if the collection does
+// not contain the key. Throws out_of_range if the given key is not
+// in the collection.
+template<typename K, typename V, typename Hash>
+void SwissMap<K,V,Hash>::erase(const K& key)
+{
+  int index = find_index(key);
+  if (index == -1)
+    throw std::out_of_range("void SwissMap<K,V,Hash>::erase(const K& key). Key does not exist.");
+
+  // a group with an empty slot already ends every probe that reaches
+  // it, so the slot can go back to empty. Otherwise later probes must
+  // continue past it, which needs a tombstone.
+  int group = index & ~(GROUP_WIDTH - 1);
+  if (match_empty(group) != 0)
+    ctrl[index] = EMPTY;
+  else
+  {
+    ctrl[index] = DELETED;
+    deleted++;
+  }
+  slots[index].key = K();
+  slots[index].value = V();
+  count--;
+}
+
+// Returns true if the key is in the collection, and false otherwise.
+template<typename K, typename V, typename Hash>
+bool SwissMap<K,V,Hash>::contains(const K& key) const
+{
+  return find_index(key) != -1;
+}
+
+// Returns a pointer to the value for the given key, or nullptr if
+// the key is not in the collection.
+template<typename K, typename V, typename Hash>
+V* SwissMap<K,V,Hash>::find(const K& key)
+{
+  int index = find_index(key);
+  if (index == -1)
+    return nullptr;
+  return &slots[index].value;
+}
+
+// Returns a pointer to the value for the given key, or nullptr if
+// the key is not in the collection.
+template<typename K, typename V, typename Hash>
+const V* SwissMap<K,V,Hash>::find(const K& key) const
+{
+  int index = find_index(key);
+  if (index == -1)
+    return nullptr;
+  return &slots[index].value;
+}
+
+// Sets the value for the given key, adding the key-value pair if
+// the key is not in the collection. Returns true if the pair was
+// added and false if an existing value was replaced.
+template<typename K, typename V, typename Hash>
+bool SwissMap<K,V,Hash>::insert_or_assign(const K& key, const V& value)
+{
+  return insert_unique(key, value, true);
+}
+
+// Adds the key-value pair if the key is not in the collection and
+// otherwise leaves the existing value alone. Returns true if the
+// pair was added.
+template<typename K, typename V, typename Hash>
+bool SwissMap<K,V,Hash>::try_emplace(const K& key, const V& value)
+{
+  return insert_unique(key, value, false);
+}
+
+// Returns the keys k in the collection such that k1 <= k <= k2
+template<typename K, typename V, typename Hash>
+ArraySeq<K> SwissMap<K,V,Hash>::find_keys(const K& k1, const K& k2) const
+{
+  ArraySeq<K> keys;
+  for (int i = 0; i < capacity; ++i)
+  {
+    if (ctrl[i] >= 0 and slots[i].key >= k1 and slots[i].key <= k2)
+      keys.insert(slots[i].key, keys.size());
+  }
+  return keys;
+}
+
+// Returns the keys in the collection in ascending sorted order
+template<typename K, typename V, typename Hash>
+ArraySeq<K> SwissMap<K,V,Hash>::sorted_keys() const
+{
+  ArraySeq<K> keys;
+  for (int i = 0; i < capacity; ++i)
+  {
+    if (ctrl[i] >= 0)
+      keys.insert(slots[i].key, keys.size());
+  }
+  keys.sort();
+  return keys;
+}
+//}}}
+
+//{{{ statistics functions for the hash table implementation
+template<typename K, typename V, typename Hash>
+int SwissMap<K,V,Hash>::min_chain_length() const
+{
+  if (count == 0)
+    return 0;
+
+  int minChain = capacity;
+  for (int i = 0; i < capacity; ++i)
+  {
+    if (ctrl[i] >= 0)
+    {
+      int len = probe_length(i);
+      if (len < minChain)
+        minChain = len;
+    }
+  }
+  return minChain;
+}
+
+template<typename K, typename V, typename Hash>
+int SwissMap<K,V,Hash>::max_chain_length() const
+{
+  int maxChain = 0;
+  for (int i = 0; i < capacity; ++i)
+  {
+    if (ctrl[i] >= 0)
+    {
+      int len = probe_length(i);
+      if (len > maxChain)
+        maxChain = len;
+    }
+  }
+  return maxChain;
+}
+
+template<typename K, typename V, typename Hash>
+double SwissMap<K,V,Hash>::avg_chain_length() const
+{
+  if (count == 0)
+    return 0.0;
+
+  long total = 0;
+  for (int i = 0; i < capacity; ++i)
+  {
+    if (ctrl[i] >= 0)
+      total += probe_length(i);
+  }
+  return (total * 1.0) / (count * 1.0);
+}
+//}}}
+
+//{{{ private functions
+// the hash function
+template<typename K, typename V, typename Hash>
+std::uint64_t SwissMap<K,V,Hash>::hash(const K& key) const
+{
+  return mix_hash(hasher(key));
+}
+
+// bitmask of slots in the group starting at index whose control
+// byte equals tag
+template<typename K, typename V, typename Hash>
+int SwissMap<K,V,Hash>::match(int index, signed char tag) const
+{
+#ifdef __SSE2__
+  __m128i group = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ctrl + index));
+  return _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8(tag), group));
+#else
+  int mask = 0;
+  for (int i = 0; i < GROUP_WIDTH; ++i)
+  {
+    if (ctrl[index + i] == tag)
+      mask |= 1 << i;
+  }
+  return mask;
+#endif
+}
+
+// bitmask of empty slots in the group starting at index
+template<typename K, typename V, typename Hash>
+int SwissMap<K,V,Hash>::match_empty(int index) const
+{
+  return match(index, EMPTY);
+}
+
+// bitmask of empty or deleted slots in the group starting at index
+template<typename K, typename V, typename Hash>
+int SwissMap<K,V,Hash>::match_free(int index) const
+{
+#ifdef __SSE2__
+  // empty and deleted are the only states with the sign bit set
+  __m128i group = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ctrl + index));
+  return _mm_movemask_epi8(group);
+#else
+  int mask = 0;
+  for (int i = 0; i < GROUP_WIDTH; ++i)
+  {
+    if (ctrl[index + i] < 0)
+      mask |= 1 << i;
+  }
+  return mask;
+#endif
+}
+
+// returns the slot index holding key, or -1 if not found
+template<typename K, typename V, typename Hash>
+int SwissMap<K,V,Hash>::find_index(const K& key) const
+{
+  std::uint64_t h = hash(key);
+  signed char tag = h & 0x7F;
+  int group_mask = capacity / GROUP_WIDTH - 1;
+  int group = (h >> 7) & group_mask;
+  // triangular probing over groups visits every group once
+  for (int step = 1; step <= group_mask + 1; ++step)
+  {
+    int index = group * GROUP_WIDTH;
+    int hits = match(index, tag);
+    while (hits != 0)
+    {
+      int i = __builtin_ctz(hits);
+      if (slots[index + i].key == key)
+        return index + i;
+      hits &= hits - 1;
+    }
+    if (match_empty(index) != 0)
+      return -1;
+    group = (group + step) & group_mask;
+  }
+  return -1;
+}
+
+// insert_or_assign and try_emplace helper
+template<typename K, typename V, typename Hash>
+bool SwissMap<K,V,Hash>::insert_unique(const K& key, const V& value, bool assign)
+{
+  if ((count + deleted + 1) * 8 > capacity * 7)
+  {
+    if (count * 2 < capacity)
+      resize_and_rehash(capacity);
+    else
+      resize_and_rehash(capacity * 2);
+  }
+
+  std::uint64_t h = hash(key);
+  signed char tag = h & 0x7F;
+  int group_mask = capacity / GROUP_WIDTH - 1;
+  int group = (h >> 7) & group_mask;
+  // remember the first free slot on the probe sequence so a miss
+  // can insert without probing a second time
+  int target = -1;
+  for (int step = 1; step <= group_mask + 1; ++step)
+  {
+    int index = group * GROUP_WIDTH;
+    int hits = match(index, tag);
+    while (hits != 0)
+    {
+      int i = __builtin_ctz(hits);
+      if (slots[index + i].key == key)
+      {
+        if (assign)
+          slots[index + i].value = value;
+        return false;
+      }
+      hits &= hits - 1;
+    }
+    int free = match_free(index);
+    if (target == -1 and free != 0)
+      target = index + __builtin_ctz(free);
+    if (match_empty(index) != 0)
+      break;
+    group = (group + step) & group_mask;
+  }
+
+  if (ctrl[target] == DELETED)
+    deleted--;
+  ctrl[target] = tag;
+  slots[target].key = key;
+  slots[target].value = value;
+  count++;
+  return true;
+}
+
+// returns the number of groups probed to reach the slot at index
+template<typename K, typename V, typename Hash>
+int SwissMap<K,V,Hash>::probe_length(int index) const
+{
+  std::uint64_t h = hash(slots[index].key);
+  int group_mask = capacity / GROUP_WIDTH - 1;
+  int group = (h >> 7) & group_mask;
+  int target = index / GROUP_WIDTH;
+  int len = 1;
+  for (int step = 1; group != target; ++step)
+  {
+    group = (group + step) & group_mask;
+    len++;
+  }
+  return len;
+}
+
+// places the pair in the first free slot along its probe sequence
+template<typename K, typename V, typename Hash>
+void SwissMap<K,V,Hash>::place(const K& key, const V& value)
+{
+  std::uint64_t h = hash(key);
+  int group_mask = capacity / GROUP_WIDTH - 1;
+  int group = (h >> 7) & group_mask;
+  int step = 1;
+  int free = match_free(group * GROUP_WIDTH);
+  while (free == 0)
+  {
+    group = (group + step) & group_mask;
+    step++;
+    free = match_free(group * GROUP_WIDTH);
+  }
+  int index = group * GROUP_WIDTH + __builtin_ctz(free);
+  if (ctrl[index] == DELETED)
+    deleted--;
+  ctrl[index] = h & 0x7F;
+  slots[index].key = key;
+  slots[index].value = value;
+}
+
+// resize and rehash the table (also clears tombstones)
+template<typename K, typename V, typename Hash>
+void SwissMap<K,V,Hash>::resize_and_rehash(int new_capacity)
+{
+  signed char* old_ctrl = ctrl;
+  Slot* old_slots = slots;
+  int old_capacity = capacity;
+  capacity = new_capacity;
+  deleted = 0;
+  init_table();
+  for (int i = 0; i < old_capacity; ++i)
+  {
+    if (old_ctrl[i] >= 0)
+      place(old_slots[i].key, old_slots[i].value);
+  }
+  delete[] old_ctrl;
+  delete[] old_slots;
+}
+
+// allocate ctrl and slots for the current capacity
+template<typename K, typename V, typename Hash>
+void SwissMap<K,V,Hash>::init_table()
+{
+  ctrl = new signed char[capacity];
+  slots = new Slot[capacity];
+  for (int i = 0; i < capacity; ++i)
+    ctrl[i] = EMPTY;
+}
+
+// clean up the table and reset member variables
+template<typename K, typename V, typename Hash>
+void SwissMap<K,V,Hash>::make_empty()
+{
+  delete[] ctrl;
+  delete[] slots;
+  ctrl = nullptr;
+  slots = nullptr;
+  count = 0;
+  deleted = 0;
+}
+//}}}
+
+#endif
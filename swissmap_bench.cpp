@@ -0,0 +1,82 @@
+//---------------------------------------------------------------------------
+// NAME: Adam Huonder
+// FILE: swissmap_bench.cpp
+// DATE: Fall 2021
+// DESC: compares SwissMap's group probing against the chained HashMap
+//       (and RobinHoodMap) on hit-heavy and miss-heavy lookups
+//
+//       g++ -std=c++17 -O2 swissmap_bench.cpp -o swissmap_bench
+//       ./swissmap_bench [keys]
+//---------------------------------------------------------------------------
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+#include "hashmap.h"
+#include "robinhoodmap.h"
+#include "swissmap.h"
+
+using namespace std;
+
+
+// milliseconds since start
+double elapsed_ms(chrono::steady_clock::time_point start)
+{
+  chrono::duration<double, milli> d = chrono::steady_clock::now() - start;
+  return d.count();
+}
+
+// inserts keys, then runs the probes once with every probe a hit and
+// once with every probe a miss
+template<typename M>
+void run(const string& name, const ArraySeq<long>& keys, const ArraySeq<long>& hits,
+         const ArraySeq<long>& misses)
+{
+  M map;
+  auto start = chrono::steady_clock::now();
+  for (int i = 0; i < keys.size(); ++i)
+    map.insert(keys[i], i);
+  double insert_ms = elapsed_ms(start);
+
+  long found = 0;
+  start = chrono::steady_clock::now();
+  for (int i = 0; i < hits.size(); ++i)
+    found += map.contains(hits[i]);
+  double hit_ms = elapsed_ms(start);
+
+  start = chrono::steady_clock::now();
+  for (int i = 0; i < misses.size(); ++i)
+    found += map.contains(misses[i]);
+  double miss_ms = elapsed_ms(start);
+
+  cout << name << ": insert " << insert_ms << " ms, hits " << hit_ms
+       << " ms, misses " << miss_ms << " ms (" << found << " found)" << endl;
+}
+
+int main(int argc, char* argv[])
+{
+  int n = 1000000;
+  if (argc > 1)
+    n = atoi(argv[1]);
+
+  // even keys are present, odd keys are misses
+  mt19937_64 gen(42);
+  ArraySeq<long> keys;
+  for (int i = 0; i < n; ++i)
+    keys.insert(2L * i, i);
+  ArraySeq<long> hits;
+  ArraySeq<long> misses;
+  for (int i = 0; i < n; ++i)
+  {
+    long k = gen() % n;
+    hits.insert(2 * k, i);
+    misses.insert(2 * k + 1, i);
+  }
+
+  cout << n << " keys, " << n << " hit and " << n << " miss probes" << endl;
+  run<HashMap<long,int>>("HashMap     ", keys, hits, misses);
+  run<RobinHoodMap<long,int>>("RobinHoodMap", keys, hits, misses);
+  run<SwissMap<long,int>>("SwissMap    ", keys, hits, misses);
+}
@@ -0,0 +1,116 @@
+//---------------------------------------------------------------------------
+// NAME: Adam Huonder
+// FILE: tree_bench.cpp
+// DATE: Fall 2021
+// DESC: times narrow find_keys range queries on AVLMap and BSTMap,
+//       which should cost O(height + keys found) rather than O(n),
+//       and random inserts and erases on AVLMap (built beside an
+//       older avlmap.h, it compares the two insert/erase versions)
+//
+//       g++ -std=c++17 -O2 -pthread tree_bench.cpp -o tree_bench
+//       ./tree_bench [queries] [avl keys] [bst keys] [update keys]
+//---------------------------------------------------------------------------
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+#include "avlmap.h"
+#include "bstmap.h"
+
+using namespace std;
+
+
+// milliseconds since start
+double elapsed_ms(chrono::steady_clock::time_point start)
+{
+  chrono::duration<double, milli> d = chrono::steady_clock::now() - start;
+  return d.count();
+}
+
+// runs queries ranges [k, k + width] with k uniform in [0, key_range)
+template<typename M>
+void run(const string& name, const M& map, int key_range, int queries, int width)
+{
+  mt19937 gen(3);
+  long found = 0;
+  auto start = chrono::steady_clock::now();
+  for (int i = 0; i < queries; ++i)
+  {
+    int k1 = gen() % key_range;
+    found += map.find_keys(k1, k1 + width).size();
+  }
+  double ms = elapsed_ms(start);
+  cout << name << ": " << queries << " ranges of width " << width << " in "
+       << ms << " ms (" << found << " keys found)" << endl;
+}
+
+// inserts the keys 0..n-1 in a random order, then erases them in
+// another random order
+void run_updates(int n)
+{
+  mt19937 gen(7);
+  ArraySeq<int> keys;
+  for (int i = 0; i < n; ++i)
+    keys.insert(i, i);
+  for (int i = n - 1; i > 0; --i)
+    swap(keys[i], keys[gen() % (i + 1)]);
+
+  AVLMap<int,int> map;
+  auto start = chrono::steady_clock::now();
+  for (int i = 0; i < n; ++i)
+    map.insert(keys[i], i);
+  double insert_ms = elapsed_ms(start);
+
+  for (int i = n - 1; i > 0; --i)
+    swap(keys[i], keys[gen() % (i + 1)]);
+  start = chrono::steady_clock::now();
+  for (int i = 0; i < n; ++i)
+    map.erase(keys[i]);
+  double erase_ms = elapsed_ms(start);
+  cout << "AVLMap, " << n << " random keys: insert " << insert_ms
+       << " ms, erase " << erase_ms << " ms (" << map.size() << " left)"
+       << endl;
+}
+
+int main(int argc, char* argv[])
+{
+  int queries = 100000;
+  int avl_keys = 10000000;
+  int bst_keys = 1000000;
+  int update_keys = 1000000;
+  if (argc > 1)
+    queries = atoi(argv[1]);
+  if (argc > 2)
+    avl_keys = atoi(argv[2]);
+  if (argc > 3)
+    bst_keys = atoi(argv[3]);
+  if (argc > 4)
+    update_keys = atoi(argv[4]);
+
+  // the AVL tree is bulk loaded from sorted pairs
+  {
+    ArraySeq<pair<int,int>> pairs;
+    for (int i = 0; i < avl_keys; ++i)
+      pairs.insert({i, i}, i);
+    AVLMap<int,int> map(pairs);
+    run("AVLMap, sorted keys", map, avl_keys, queries, 20);
+  }
+
+  // the BST is unbalanced, so it is built from random keys (every
+  // other key of the range on average)
+  {
+    mt19937 gen(1);
+    BSTMap<int,int> map;
+    for (int i = 0; i < bst_keys; ++i)
+    {
+      int key = gen() % (2 * bst_keys);
+      if (!map.contains(key))
+        map.insert(key, i);
+    }
+    run("BSTMap, random keys", map, 2 * bst_keys, queries, 20);
+  }
+
+  run_updates(update_keys);
+}